@@ -19,7 +19,7 @@ void SuggestionEngine::generateEQSuggestions(const juce::Array<float>& userEQDat
         return;
     
     // Analyze EQ differences at key frequency bands
-    for (int i = 0; i < juce::jmin(userEQData.size(), frequencyBands.size()); ++i)
+    for (int i = 0; i < juce::jmin(userEQData.size(), static_cast<int>(frequencyBands.size())); ++i)
     {
         float difference = userEQData[i] - referenceEQData[i];
         
@@ -30,7 +30,7 @@ void SuggestionEngine::generateEQSuggestions(const juce::Array<float>& userEQDat
             MixSuggestion suggestion(
                 stemName,
                 SuggestionType::EQBalance,
-                generateEQDescription(frequencyBands[i], difference),
+                generateEQDescription(frequencyBands[static_cast<size_t>(i)], difference),
                 getPriorityFromDifference(std::abs(difference), eqThreshold)
             );
             
@@ -93,7 +93,7 @@ juce::String SuggestionEngine::generateEQDescription(float frequency, float diff
     
     if (frequency < 1000)
     {
-        freqStr = juce::String(static_cast<int>(frequency)) + "Hz";
+        freqStr = juce::String(juce::roundToInt(frequency)) + "Hz";
     }
     else
     {
@@ -3,6 +3,7 @@
 #include <JuceHeader.h>
 #include "MixSuggestion.h"
 #include "SuggestionManager.h"
+#include "SpectralBandMap.h"
 
 namespace ForensEQ {
 
@@ -14,7 +15,8 @@ public:
     SuggestionEngine();
     ~SuggestionEngine();
     
-    // Generate suggestions based on EQ data
+    // Generate suggestions based on EQ data, one level (dB) per band of the shared
+    // third-octave layout (SpectralBandMap::thirdOctave())
     void generateEQSuggestions(const juce::Array<float>& userEQData, 
                               const juce::Array<float>& referenceEQData,
                               const juce::String& stemName);
@@ -56,12 +58,7 @@ private:
     SuggestionPriority getPriorityFromDifference(float difference, float threshold);
     
     // Frequency bands for EQ analysis (in Hz)
-    const juce::Array<float> frequencyBands = {
-        20, 30, 40, 50, 60, 80, 100, 120, 150, 180, 
-        200, 250, 300, 350, 400, 500, 600, 700, 800, 
-        1000, 1200, 1500, 1800, 2000, 2500, 3000, 3500, 
-        4000, 5000, 6000, 8000, 10000, 12000, 16000, 20000
-    };
+    const std::vector<float> frequencyBands = SpectralBandMap::getCentreFrequencies(SpectralBandMap::thirdOctave());
 };
 
 } // namespace ForensEQ
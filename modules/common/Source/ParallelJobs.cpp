@@ -0,0 +1,52 @@
+#include "ParallelJobs.h"
+
+namespace ForensEQ {
+
+class ParallelJobs::HelperJob : public juce::ThreadPoolJob
+{
+public:
+    HelperJob(const juce::String& jobName, const std::function<void()>& workToRun)
+        : juce::ThreadPoolJob(jobName),
+          work(workToRun)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        work();
+        return jobHasFinished;
+    }
+
+private:
+    const std::function<void()>& work;
+};
+
+void ParallelJobs::run(juce::ThreadPool& pool, const juce::String& jobName, int maxHelpers,
+                       const std::function<void()>& work)
+{
+    if (maxHelpers <= 0 || juce::ThreadPoolJob::getCurrentThreadPoolJob() != nullptr)
+    {
+        work();
+        return;
+    }
+
+    const int numHelpers = juce::jmin(maxHelpers, pool.getNumThreads());
+
+    std::vector<std::unique_ptr<HelperJob>> helpers;
+    helpers.reserve(static_cast<size_t>(numHelpers));
+
+    for (int i = 0; i < numHelpers; ++i)
+    {
+        helpers.push_back(std::make_unique<HelperJob>(jobName, work));
+        pool.addJob(helpers.back().get(), false);
+    }
+
+    // The calling thread works through the queue as well
+    work();
+
+    // Join: helpers that never started are dequeued, running ones are waited for
+    for (auto& helper : helpers)
+        pool.removeJob(helper.get(), false, -1);
+}
+
+} // namespace ForensEQ
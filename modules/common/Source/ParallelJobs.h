@@ -0,0 +1,32 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for spreading work over the shared thread pool
+ *
+ * The work function is run on the calling thread and, at the same time, on helper jobs in
+ * a ThreadPool. It should keep claiming items from shared state (e.g. an atomic index) until
+ * none are left, so it gives the same results however many copies run. run() returns once
+ * every copy has finished.
+ *
+ * The pool is passed in rather than created here, so its threads outlive each call. Callers
+ * hold a juce::SharedResourcePointer<juce::ThreadPool> for as long as they may call run(),
+ * which keeps one process-wide pool alive between analyses.
+ */
+class ParallelJobs {
+public:
+    // Run work on the calling thread and on up to maxHelpers jobs named jobName in pool.
+    // Called from a pool thread, work runs once on that thread only, since blocking a pool
+    // thread on more pool jobs could deadlock
+    static void run(juce::ThreadPool& pool, const juce::String& jobName, int maxHelpers,
+                    const std::function<void()>& work);
+
+private:
+    // Pool job that runs the work function once
+    class HelperJob;
+};
+
+} // namespace ForensEQ
@@ -0,0 +1,161 @@
+#include "SpectralBandMap.h"
+
+namespace ForensEQ {
+
+bool SpectralBandMap::Layout::operator==(const Layout& other) const
+{
+    return bandsPerOctave == other.bandsPerOctave
+        && minFrequency == other.minFrequency
+        && maxFrequency == other.maxFrequency;
+}
+
+juce::String SpectralBandMap::Layout::toString() const
+{
+    return "1/" + juce::String(bandsPerOctave) + " octave, "
+         + juce::String(minFrequency) + "-" + juce::String(maxFrequency) + " Hz";
+}
+
+SpectralBandMap::SpectralBandMap(double sampleRate, int fftSize, const Layout& layout)
+    : sampleRate(sampleRate > 0.0 ? sampleRate : 44100.0),
+      fftSize(juce::jmax(2, fftSize)),
+      numBins(this->fftSize / 2 + 1),
+      layout(layout),
+      centreFrequencies(getCentreFrequencies(layout))
+{
+    buildWeights();
+}
+
+SpectralBandMap::~SpectralBandMap()
+{
+}
+
+std::shared_ptr<const SpectralBandMap> SpectralBandMap::getShared(double sampleRate, int fftSize, const Layout& layout)
+{
+    static juce::CriticalSection mapLock;
+    static std::map<juce::String, std::shared_ptr<const SpectralBandMap>> maps;
+
+    const juce::String key = juce::String(sampleRate) + "|" + juce::String(fftSize) + "|" + layout.toString();
+
+    const juce::ScopedLock sl(mapLock);
+
+    auto& map = maps[key];
+    if (map == nullptr)
+        map = std::make_shared<const SpectralBandMap>(sampleRate, fftSize, layout);
+
+    return map;
+}
+
+std::vector<float> SpectralBandMap::getCentreFrequencies(const Layout& layout)
+{
+    int firstIndex, lastIndex;
+    getBandIndexRange(layout, firstIndex, lastIndex);
+
+    const double bandsPerOctave = static_cast<double>(juce::jmax(1, layout.bandsPerOctave));
+
+    std::vector<float> frequencies;
+    frequencies.reserve(static_cast<size_t>(juce::jmax(0, lastIndex - firstIndex + 1)));
+
+    for (int index = firstIndex; index <= lastIndex; ++index)
+        frequencies.push_back(static_cast<float>(1000.0 * std::pow(2.0, index / bandsPerOctave)));
+
+    return frequencies;
+}
+
+void SpectralBandMap::mapBins(const float* binValues, float* bandValues) const
+{
+    const int numBands = getNumBands();
+
+    for (int band = 0; band < numBands; ++band)
+    {
+        float sum = 0.0f;
+
+        for (int entry = bandStarts[static_cast<size_t>(band)]; entry < bandStarts[static_cast<size_t>(band + 1)]; ++entry)
+            sum += binWeights[static_cast<size_t>(entry)] * binValues[binIndices[static_cast<size_t>(entry)]];
+
+        bandValues[band] = sum;
+    }
+}
+
+void SpectralBandMap::mapBins(const std::vector<float>& binValues, std::vector<float>& bandValues) const
+{
+    jassert(static_cast<int>(binValues.size()) >= numBins);
+
+    bandValues.resize(centreFrequencies.size());
+    mapBins(binValues.data(), bandValues.data());
+}
+
+void SpectralBandMap::getBandIndexRange(const Layout& layout, int& firstIndex, int& lastIndex)
+{
+    const double bandsPerOctave = static_cast<double>(juce::jmax(1, layout.bandsPerOctave));
+    const double minFrequency = juce::jmax(1.0, static_cast<double>(layout.minFrequency));
+    const double maxFrequency = juce::jmax(minFrequency, static_cast<double>(layout.maxFrequency));
+
+    // A band belongs to the layout if the range covers at least half of it. The small
+    // tolerance keeps exact band edges from flipping with rounding
+    firstIndex = static_cast<int>(std::ceil(bandsPerOctave * std::log2(minFrequency / 1000.0) - 0.5 - 1.0e-9));
+    lastIndex = static_cast<int>(std::floor(bandsPerOctave * std::log2(maxFrequency / 1000.0) + 0.5 + 1.0e-9));
+}
+
+void SpectralBandMap::buildWeights()
+{
+    const double bandsPerOctave = static_cast<double>(juce::jmax(1, layout.bandsPerOctave));
+    const double edgeRatio = std::pow(2.0, 0.5 / bandsPerOctave);
+    const double binWidth = sampleRate / fftSize;
+    const double nyquist = sampleRate * 0.5;
+
+    bandStarts.clear();
+    binIndices.clear();
+    binWeights.clear();
+    bandStarts.reserve(centreFrequencies.size() + 1);
+
+    for (float centre : centreFrequencies)
+    {
+        bandStarts.push_back(static_cast<int>(binIndices.size()));
+
+        const double lowEdge = centre / edgeRatio;
+        const double highEdge = juce::jmin(centre * edgeRatio, nyquist);
+
+        // Bin k covers [k - 0.5, k + 0.5] bin widths; weight each bin by its overlap with the band
+        std::vector<std::pair<int, double>> overlaps;
+        double totalOverlap = 0.0;
+
+        if (lowEdge < highEdge)
+        {
+            const int firstBin = juce::jlimit(0, numBins - 1, static_cast<int>(std::floor(lowEdge / binWidth + 0.5)));
+            const int lastBin = juce::jlimit(0, numBins - 1, static_cast<int>(std::floor(highEdge / binWidth + 0.5)));
+
+            for (int bin = firstBin; bin <= lastBin; ++bin)
+            {
+                const double overlap = juce::jmin(highEdge, (bin + 0.5) * binWidth)
+                                     - juce::jmax(lowEdge, (bin - 0.5) * binWidth);
+
+                if (overlap > 0.0)
+                {
+                    overlaps.emplace_back(bin, overlap);
+                    totalOverlap += overlap;
+                }
+            }
+        }
+
+        if (totalOverlap > 0.0)
+        {
+            // Normalise so each band is a weighted average of its bins
+            for (const auto& overlap : overlaps)
+            {
+                binIndices.push_back(overlap.first);
+                binWeights.push_back(static_cast<float>(overlap.second / totalOverlap));
+            }
+        }
+        else
+        {
+            // Bands above Nyquist (low sample rates) repeat the top bin, so the number of
+            // bands never depends on the sample rate
+            binIndices.push_back(numBins - 1);
+            binWeights.push_back(1.0f);
+        }
+    }
+
+    bandStarts.push_back(static_cast<int>(binIndices.size()));
+}
+
+} // namespace ForensEQ
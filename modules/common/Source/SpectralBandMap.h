@@ -0,0 +1,89 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for converting FFT bins to fractional-octave bands
+ *
+ * Band centres follow the base-2 series fc = 1000 * 2^(k / bandsPerOctave), so the band
+ * frequencies depend only on the layout and every module using the same layout gets the
+ * same bands. The mapping from bins to bands is built once per sample rate, FFT size and
+ * layout and stored sparsely: each band keeps only the bins that overlap it, weighted by
+ * how much of the bin lies inside the band. Converting a spectrum is one pass over those
+ * weights, whatever the number of bins.
+ *
+ * Maps are immutable after construction and can be shared between threads.
+ */
+class SpectralBandMap {
+public:
+    // Resolution and frequency range of a band layout
+    struct Layout {
+        int bandsPerOctave = 3;
+        float minFrequency = 20.0f;
+        float maxFrequency = 20000.0f;
+
+        bool operator==(const Layout& other) const;
+        bool operator!=(const Layout& other) const { return !operator==(other); }
+
+        // Describe the layout, e.g. for cache keys
+        juce::String toString() const;
+    };
+
+    // Common layouts, all covering 20 Hz to 20 kHz: 31 bands as on a graphic EQ, ~100 bands
+    // for curve display and ~240 bands for detailed spectra
+    static Layout thirdOctave() { return { 3 }; }
+    static Layout displayResolution() { return { 10 }; }
+    static Layout analysisResolution() { return { 24 }; }
+
+    SpectralBandMap(double sampleRate, int fftSize, const Layout& layout);
+    ~SpectralBandMap();
+
+    // Get a map, building it on first use. Maps are kept for reuse (thread-safe)
+    static std::shared_ptr<const SpectralBandMap> getShared(double sampleRate, int fftSize, const Layout& layout);
+
+    // Get the centre frequencies of a layout's bands without building a map
+    static std::vector<float> getCentreFrequencies(const Layout& layout);
+
+    // Get the number of bands, which depends only on the layout
+    int getNumBands() const { return static_cast<int>(centreFrequencies.size()); }
+
+    // Get the number of bins expected by mapBins() (fftSize / 2 + 1, DC to Nyquist)
+    int getNumBins() const { return numBins; }
+
+    // Get the centre frequency of every band
+    const std::vector<float>& getBandFrequencies() const { return centreFrequencies; }
+
+    double getSampleRate() const { return sampleRate; }
+    int getFFTSize() const { return fftSize; }
+    const Layout& getLayout() const { return layout; }
+
+    // Convert per-bin values (getNumBins() of them) to per-band weighted averages
+    // (getNumBands() of them). Pass power for level-correct bands; other per-bin values
+    // such as averaged dB are mapped the same way
+    void mapBins(const float* binValues, float* bandValues) const;
+
+    // Same as above, resizing bandValues to the number of bands
+    void mapBins(const std::vector<float>& binValues, std::vector<float>& bandValues) const;
+
+private:
+    double sampleRate;
+    int fftSize;
+    int numBins;
+    Layout layout;
+    std::vector<float> centreFrequencies;
+
+    // Sparse weights: entries [bandStarts[b], bandStarts[b + 1]) belong to band b
+    std::vector<int> bandStarts;
+    std::vector<int> binIndices;
+    std::vector<float> binWeights;
+
+    // Helper methods
+    static void getBandIndexRange(const Layout& layout, int& firstIndex, int& lastIndex);
+    void buildWeights();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectralBandMap)
+};
+
+} // namespace ForensEQ
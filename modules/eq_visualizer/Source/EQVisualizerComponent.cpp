@@ -3,94 +3,103 @@
 namespace ForensEQ {
 
 EQVisualizerComponent::EQVisualizerComponent()
+    : juce::Thread("ForensEQ Curve Preparation")
 {
-    // Initialize with some default frequencies (20Hz to 20kHz)
-    const int numPoints = 100;
-    userFrequencies.resize(numPoints);
-    userMagnitudes.resize(numPoints, 0.0f);
-    referenceFrequencies.resize(numPoints);
-    referenceMagnitudes.resize(numPoints, 0.0f);
-    
-    // Generate logarithmic frequency scale
-    for (int i = 0; i < numPoints; ++i)
-    {
-        float t = static_cast<float>(i) / static_cast<float>(numPoints - 1);
-        userFrequencies[i] = 20.0f * std::pow(1000.0f, t);
-        referenceFrequencies[i] = userFrequencies[i];
-    }
+    // Initialize with the shared 1/10-octave display bands (20Hz to 20kHz), from the same
+    // fractional-octave series the analysis modules report in
+    userFrequencies = SpectralBandMap::getCentreFrequencies(SpectralBandMap::displayResolution());
+    userMagnitudes.assign(userFrequencies.size(), 0.0f);
+    referenceFrequencies = userFrequencies;
+    referenceMagnitudes.assign(referenceFrequencies.size(), 0.0f);
+    
+    // Overlaps are found on the finer analysis bands, whatever grids the curves arrive on
+    overlapFrequencies = SpectralBandMap::getCentreFrequencies(SpectralBandMap::analysisResolution());
+    resampleToGrid(userFrequencies, userMagnitudes, overlapFrequencies, userOverlapMagnitudes);
+    resampleToGrid(referenceFrequencies, referenceMagnitudes, overlapFrequencies, referenceOverlapMagnitudes);
+    updateOverlapSegments();
+    
+    // Screen mapping; the curves are prepared again once the component has a size
+    updateTransforms();
+    
+    // Allocate the particle pool once
+    particleX.allocate(maxParticles, false);
+    particleY.allocate(maxParticles, false);
+    particleVX.allocate(maxParticles, false);
+    particleVY.allocate(maxParticles, false);
+    particleLife.allocate(maxParticles, false);
+    particleCurve.allocate(maxParticles, false);
     
     // Start the timer for animations
     startTimerHz(60); // 60 fps for smooth animations
     
-    // Set component properties
+    // Set component properties. The static parts are cached in layers of our own, so the
+    // component isn't buffered to an image, which every animation frame would invalidate
     setOpaque(true);
-    setBufferedToImage(true);
 }
 
 EQVisualizerComponent::~EQVisualizerComponent()
 {
     stopTimer();
+    
+    signalThreadShouldExit();
+    notify();
+    stopThread(2000);
+    cancelPendingUpdate();
 }
 
 void EQVisualizerComponent::paint(juce::Graphics& g)
 {
-    // Draw the background
-    drawBackground(g);
-    
-    // Draw frequency labels
-    drawFrequencyLabels(g);
-    
-    // Draw EQ curves in the correct order
-    if (userCurveOnTop)
-    {
-        drawEQCurve(g, referenceFrequencies, referenceMagnitudes, referenceCurveColor);
-        drawOverlapHighlights(g);
-        drawEQCurve(g, userFrequencies, userMagnitudes, userCurveColor);
-    }
-    else
-    {
-        drawEQCurve(g, userFrequencies, userMagnitudes, userCurveColor);
-        drawOverlapHighlights(g);
-        drawEQCurve(g, referenceFrequencies, referenceMagnitudes, referenceCurveColor);
-    }
+    // Background, labels and curves come from the cached layers; only the particles are
+    // drawn each frame
+    updateLayers(g.getInternalContext().getPhysicalPixelScaleFactor());
+    g.drawImage(curveLayer, getLocalBounds().toFloat());
     
     // Draw particles
-    for (const auto& particle : particles)
-    {
-        g.setColour(particle.color.withAlpha(particle.life / particle.maxLife));
-        g.fillEllipse(particle.x - 2.0f, particle.y - 2.0f, 4.0f, 4.0f);
-    }
+    drawParticles(g);
 }
 
 void EQVisualizerComponent::resized()
 {
     // Clear particles when resizing
-    particles.clear();
+    numParticles = 0;
+    
+    // Layers and paths of the old size are no use any more
+    backgroundLayer = juce::Image();
+    curveLayer = juce::Image();
+    updateTransforms();
 }
 
 void EQVisualizerComponent::timerCallback()
 {
+    // Pick up the newest live spectrum, if one has been published since the last frame
+    if (liveSpectrumSource != nullptr && liveSpectrumSource->getLatestSpectrum(liveFrequencies, liveMagnitudes))
+        setUserEQData(liveFrequencies, liveMagnitudes);
+    
+    const bool hadParticles = numParticles > 0;
+    
     // Update particles
     updateParticles();
     
     // Add new particles along the curves
     if (random.nextFloat() < particleGenerationRate) // Use the configurable rate
     {
-        addParticlesAlongCurve(userFrequencies, userMagnitudes, userCurveColor);
-        addParticlesAlongCurve(referenceFrequencies, referenceMagnitudes, referenceCurveColor);
+        addParticlesAlongCurve(userPoints, userCurve);
+        addParticlesAlongCurve(referencePoints, referenceCurve);
     }
     
-    // Trigger repaint
-    repaint();
+    // Nothing on screen moves without particles, so there's nothing to repaint
+    if (hadParticles || numParticles > 0)
+        repaint();
 }
 
 void EQVisualizerComponent::setUserEQData(const std::vector<float>& frequencies, const std::vector<float>& magnitudes)
 {
     if (frequencies.size() == magnitudes.size() && !frequencies.empty())
     {
+        // The curve is redrawn once the worker thread has prepared it
         userFrequencies = frequencies;
         userMagnitudes = magnitudes;
-        repaint();
+        requestCurvePreparation(userCurve);
     }
 }
 
@@ -100,16 +109,110 @@ void EQVisualizerComponent::setReferenceEQData(const std::vector<float>& frequen
     {
         referenceFrequencies = frequencies;
         referenceMagnitudes = magnitudes;
-        repaint();
+        requestCurvePreparation(referenceCurve);
     }
 }
 
 void EQVisualizerComponent::toggleCurveOrder()
 {
     userCurveOnTop = !userCurveOnTop;
+    curvesNeedRedraw();
+}
+
+void EQVisualizerComponent::updateLayers(float scale)
+{
+    const int width = juce::jmax(1, juce::roundToInt(getWidth() * scale));
+    const int height = juce::jmax(1, juce::roundToInt(getHeight() * scale));
+    
+    // The background only changes with the size or the display's scale
+    if (backgroundLayer.isNull() || scale != layerScale
+        || backgroundLayer.getWidth() != width || backgroundLayer.getHeight() != height)
+    {
+        backgroundLayer = juce::Image(juce::Image::RGB, width, height, false);
+        layerScale = scale;
+    
+        juce::Graphics layerGraphics(backgroundLayer);
+        layerGraphics.addTransform(juce::AffineTransform::scale(scale));
+        drawBackground(layerGraphics);
+        drawFrequencyLabels(layerGraphics);
+    
+        curvesChanged = true;
+    }
+    
+    // The curves are drawn over a copy of the background, so a frame is a single image
+    if (curvesChanged || curveLayer.isNull())
+    {
+        if (curveLayer.getWidth() != width || curveLayer.getHeight() != height)
+            curveLayer = juce::Image(juce::Image::RGB, width, height, false);
+    
+        juce::Graphics layerGraphics(curveLayer);
+        layerGraphics.drawImageAt(backgroundLayer, 0, 0);
+        layerGraphics.addTransform(juce::AffineTransform::scale(scale));
+        drawCurves(layerGraphics);
+    
+        curvesChanged = false;
+    }
+}
+
+void EQVisualizerComponent::curvesNeedRedraw()
+{
+    curvesChanged = true;
     repaint();
 }
 
+void EQVisualizerComponent::drawCurves(juce::Graphics& g)
+{
+    // Draw EQ curves in the correct order
+    if (userCurveOnTop)
+    {
+        drawEQCurve(g, referencePoints, referenceCurveColor);
+        drawOverlapHighlights(g);
+        drawEQCurve(g, userPoints, userCurveColor);
+    }
+    else
+    {
+        drawEQCurve(g, userPoints, userCurveColor);
+        drawOverlapHighlights(g);
+        drawEQCurve(g, referencePoints, referenceCurveColor);
+    }
+}
+
+void EQVisualizerComponent::drawParticles(juce::Graphics& g)
+{
+    if (numParticles == 0)
+        return;
+    
+    // Sort the particles into one path per curve and alpha level (fading in steps of
+    // 1 / particleAlphaLevels), then fill each path once
+    for (auto& path : particlePaths)
+        path.clear();
+    
+    for (int i = 0; i < numParticles; ++i)
+    {
+        const int alphaLevel = juce::jlimit(0, particleAlphaLevels - 1,
+                                            static_cast<int>(particleLife[i] * particleAlphaLevels));
+        particlePaths[static_cast<size_t>(particleCurve[i] * particleAlphaLevels + alphaLevel)]
+            .addEllipse(particleX[i] - 2.0f, particleY[i] - 2.0f, 4.0f, 4.0f);
+    }
+    
+    const juce::Colour curveColours[numCurves] = { userCurveColor.brighter(0.5f),
+                                                   referenceCurveColor.brighter(0.5f) };
+    
+    for (int curve = 0; curve < numCurves; ++curve)
+    {
+        for (int alphaLevel = 0; alphaLevel < particleAlphaLevels; ++alphaLevel)
+        {
+            const auto& path = particlePaths[static_cast<size_t>(curve * particleAlphaLevels + alphaLevel)];
+    
+            if (path.isEmpty())
+                continue;
+    
+            g.setColour(curveColours[curve].withAlpha((alphaLevel + 0.5f) / particleAlphaLevels));
+            g.fillPath(path);
+        }
+    }
+}
+
 void EQVisualizerComponent::drawBackground(juce::Graphics& g)
 {
     const auto bounds = getLocalBounds().toFloat();
@@ -175,31 +278,20 @@ void EQVisualizerComponent::drawFrequencyLabels(juce::Graphics& g)
     }
 }
 
-void EQVisualizerComponent::drawEQCurve(juce::Graphics& g, const std::vector<float>& frequencies, 
-                                      const std::vector<float>& magnitudes, juce::Colour color)
+void EQVisualizerComponent::drawEQCurve(juce::Graphics& g, const CurvePoints& points, juce::Colour color)
 {
-    if (frequencies.empty() || magnitudes.empty() || frequencies.size() != magnitudes.size())
+    const size_t numPoints = points.x.size();
+    
+    if (numPoints == 0 || points.y.size() != numPoints)
         return;
     
-    // Create path for the curve
+    // Create path for the curve from the precomputed screen coordinates
     juce::Path curvePath;
-    bool pathStarted = false;
+    curvePath.preallocateSpace(static_cast<int>(numPoints) * 3);
+    curvePath.startNewSubPath(points.x[0], points.y[0]);
     
-    for (size_t i = 0; i < frequencies.size(); ++i)
-    {
-        float x = freqToX(frequencies[i]);
-        float y = dbToY(magnitudes[i]);
-        
-        if (!pathStarted)
-        {
-            curvePath.startNewSubPath(x, y);
-            pathStarted = true;
-        }
-        else
-        {
-            curvePath.lineTo(x, y);
-        }
-    }
+    for (size_t i = 1; i < numPoints; ++i)
+        curvePath.lineTo(points.x[i], points.y[i]);
     
     // Draw the curve
     g.setColour(color);
@@ -208,52 +300,9 @@ void EQVisualizerComponent::drawEQCurve(juce::Graphics& g, const std::vector<flo
 
 void EQVisualizerComponent::drawOverlapHighlights(juce::Graphics& g)
 {
-    if (userFrequencies.empty() || referenceFrequencies.empty())
-        return;
-    
-    // Create a path for the overlap highlights
-    juce::Path overlapPath;
-    bool pathStarted = false;
-    
-    // We'll need to interpolate between the two frequency sets
-    // For simplicity, we'll use the user frequencies as the base
-    for (size_t i = 0; i < userFrequencies.size(); ++i)
-    {
-        float freq = userFrequencies[i];
-        float userMag = userMagnitudes[i];
-        
-        // Find the closest reference magnitude for this frequency
-        float refMag = 0.0f;
-        for (size_t j = 0; j < referenceFrequencies.size(); ++j)
-        {
-            if (std::abs(referenceFrequencies[j] - freq) < 0.01f * freq)
-            {
-                refMag = referenceMagnitudes[j];
-                break;
-            }
-        }
-        
-        // Check if the magnitudes are close enough to be considered "overlapping"
-        if (std::abs(userMag - refMag) <= overlapThreshold)
-        {
-            float x = freqToX(freq);
-            float y = dbToY(userMag);
-            
-            if (!pathStarted)
-            {
-                overlapPath.startNewSubPath(x, y);
-                pathStarted = true;
-            }
-            else
-            {
-                overlapPath.lineTo(x, y);
-            }
-        }
-        else if (pathStarted)
-        {
-            pathStarted = false;
-        }
-    }
+    // The path is only rebuilt after the data or the size has changed
+    if (!overlapPathValid)
+        buildOverlapPath();
     
     // Draw the overlap highlights with a glow effect
     if (!overlapPath.isEmpty())
@@ -273,75 +322,394 @@ void EQVisualizerComponent::drawOverlapHighlights(juce::Graphics& g)
     }
 }
 
-void EQVisualizerComponent::updateParticles()
+void EQVisualizerComponent::updateOverlapSegments()
 {
-    // Update existing particles
-    for (auto it = particles.begin(); it != particles.end(); )
+    overlapSegments.clear();
+    
+    // Bands outside either curve are NaN and never overlap
+    const int numBands = static_cast<int>(overlapFrequencies.size());
+    int segmentStart = -1;
+    
+    for (int band = 0; band <= numBands; ++band)
     {
-        it->x += it->vx;
-        it->y += it->vy;
-        it->life -= 0.01f;
-        
-        if (it->life <= 0.0f)
+        const bool overlapping = band < numBands
+            && std::abs(userOverlapMagnitudes[static_cast<size_t>(band)]
+                        - referenceOverlapMagnitudes[static_cast<size_t>(band)]) <= overlapThreshold;
+    
+        if (overlapping && segmentStart < 0)
         {
-            it = particles.erase(it);
+            segmentStart = band;
         }
-        else
+        else if (!overlapping && segmentStart >= 0)
         {
-            ++it;
+            overlapSegments.emplace_back(segmentStart, band);
+            segmentStart = -1;
         }
     }
+    
+    overlapPathValid = false;
 }
 
-void EQVisualizerComponent::addParticlesAlongCurve(const std::vector<float>& frequencies, 
-                                                 const std::vector<float>& magnitudes, 
-                                                 juce::Colour color)
+void EQVisualizerComponent::buildOverlapPath()
 {
-    if (frequencies.empty() || magnitudes.empty())
+    overlapPath.clear();
+    
+    for (const auto& segment : overlapSegments)
+    {
+        // A single band still gets a short mark, half a band either side
+        const size_t first = static_cast<size_t>(segment.first);
+        const size_t last = static_cast<size_t>(segment.second - 1);
+    
+        if (first == last)
+        {
+            const float halfBand = std::pow(2.0f, 0.5f / SpectralBandMap::analysisResolution().bandsPerOctave);
+            const float y = dbToY(userOverlapMagnitudes[first]);
+            overlapPath.startNewSubPath(freqToX(overlapFrequencies[first] / halfBand), y);
+            overlapPath.lineTo(freqToX(overlapFrequencies[first] * halfBand), y);
+            continue;
+        }
+    
+        overlapPath.startNewSubPath(overlapX[first], dbToY(userOverlapMagnitudes[first]));
+    
+        for (size_t band = first + 1; band <= last; ++band)
+            overlapPath.lineTo(overlapX[band], dbToY(userOverlapMagnitudes[band]));
+    }
+    
+    overlapPathValid = true;
+}
+
+void EQVisualizerComponent::resampleToGrid(const std::vector<float>& frequencies, const std::vector<float>& magnitudes,
+                                           const std::vector<float>& grid, std::vector<float>& resampled)
+{
+    resampled.assign(grid.size(), std::numeric_limits<float>::quiet_NaN());
+    
+    if (frequencies.empty() || frequencies.size() != magnitudes.size())
+        return;
+    
+    // Both are sorted by frequency, so one merge-like pass interpolates every grid band,
+    // linearly in log frequency between the curve's neighbouring points
+    size_t point = 0;
+    
+    for (size_t band = 0; band < grid.size(); ++band)
+    {
+        const float freq = grid[band];
+    
+        if (freq < frequencies.front() || freq > frequencies.back())
+            continue;
+    
+        while (point + 1 < frequencies.size() && frequencies[point + 1] < freq)
+            ++point;
+    
+        if (point + 1 == frequencies.size() || frequencies[point] >= freq)
+        {
+            resampled[band] = magnitudes[point];
+            continue;
+        }
+    
+        const float lowFreq = frequencies[point];
+        const float highFreq = frequencies[point + 1];
+        const float proportion = std::log(freq / lowFreq) / std::log(highFreq / lowFreq);
+        resampled[band] = magnitudes[point] + proportion * (magnitudes[point + 1] - magnitudes[point]);
+    }
+}
+
+void EQVisualizerComponent::updateParticles()
+{
+    // Move and age every particle at once
+    juce::FloatVectorOperations::add(particleX, particleVX, numParticles);
+    juce::FloatVectorOperations::add(particleY, particleVY, numParticles);
+    juce::FloatVectorOperations::add(particleLife, -0.01f, numParticles);
+    
+    // Remove dead particles by moving the last live one into their place
+    for (int i = 0; i < numParticles; )
+    {
+        if (particleLife[i] > 0.0f)
+        {
+            ++i;
+            continue;
+        }
+        
+        const int last = --numParticles;
+        particleX[i] = particleX[last];
+        particleY[i] = particleY[last];
+        particleVX[i] = particleVX[last];
+        particleVY[i] = particleVY[last];
+        particleLife[i] = particleLife[last];
+        particleCurve[i] = particleCurve[last];
+    }
+}
+
+void EQVisualizerComponent::addParticlesAlongCurve(const CurvePoints& points, Curve curve)
+{
+    // The pool has a fixed capacity for performance
+    if (points.x.empty() || points.y.size() != points.x.size() || numParticles >= maxParticles)
         return;
     
     // Add particles at random points along the curve
-    int index = random.nextInt(static_cast<int>(frequencies.size()));
-    float x = freqToX(frequencies[index]);
-    float y = dbToY(magnitudes[index]);
+    const size_t index = static_cast<size_t>(random.nextInt(static_cast<int>(points.x.size())));
     
     // Create a new particle
-    Particle p;
-    p.x = x;
-    p.y = y;
-    p.vx = random.nextFloat() * 0.6f - 0.3f;
-    p.vy = random.nextFloat() * 0.6f - 0.3f;
-    p.life = 1.0f;
-    p.maxLife = 1.0f;
-    p.color = color.brighter(0.5f);
-    
-    // Add to the particle list (limit total particles for performance)
-    if (particles.size() < 200)
+    const int p = numParticles++;
+    particleX[p] = points.x[index];
+    particleY[p] = points.y[index];
+    particleVX[p] = random.nextFloat() * 0.6f - 0.3f;
+    particleVY[p] = random.nextFloat() * 0.6f - 0.3f;
+    particleLife[p] = 1.0f;
+    particleCurve[p] = static_cast<juce::uint8>(curve);
+}
+
+void EQVisualizerComponent::updateTransforms()
+{
+    const auto bounds = getLocalBounds().toFloat();
+    const ScreenMapping oldMapping = screenMapping;
+    
+    // Logarithmic frequency scale across the full width
+    screenMapping.freqXScale = bounds.getWidth() / std::log(maxFrequency / minFrequency);
+    screenMapping.freqXOffset = bounds.getX() - screenMapping.freqXScale * std::log(minFrequency);
+    
+    // The dB range fills the middle 80% of the height
+    screenMapping.dbYScale = -0.8f * bounds.getHeight() / (maxDb - minDb);
+    screenMapping.dbYOffset = bounds.getY() + 0.1f * bounds.getHeight() - screenMapping.dbYScale * maxDb;
+    
+    // Everything in screen coordinates follows the new mapping. The curves shown are moved
+    // there straight away, until the worker delivers them prepared for the new size
+    frequenciesToX(screenMapping, overlapFrequencies, overlapX);
+    overlapPathValid = false;
+    
+    rescalePoints(oldMapping, screenMapping, userPoints);
+    rescalePoints(oldMapping, screenMapping, referencePoints);
+    
+    requestCurvePreparation(userCurve);
+    requestCurvePreparation(referenceCurve);
+}
+
+void EQVisualizerComponent::rescalePoints(const ScreenMapping& from, const ScreenMapping& to, CurvePoints& points)
+{
+    // Both mappings are linear in ln(freq) and dB, so moving between them is linear in x and y
+    if (from == to || from.freqXScale == 0.0f || from.dbYScale == 0.0f)
+        return;
+    
+    const float xScale = to.freqXScale / from.freqXScale;
+    const float yScale = to.dbYScale / from.dbYScale;
+    const int numPoints = static_cast<int>(juce::jmin(points.x.size(), points.y.size()));
+    
+    juce::FloatVectorOperations::add(points.x.data(), -from.freqXOffset, numPoints);
+    juce::FloatVectorOperations::multiply(points.x.data(), xScale, numPoints);
+    juce::FloatVectorOperations::add(points.x.data(), to.freqXOffset, numPoints);
+    
+    juce::FloatVectorOperations::add(points.y.data(), -from.dbYOffset, numPoints);
+    juce::FloatVectorOperations::multiply(points.y.data(), yScale, numPoints);
+    juce::FloatVectorOperations::add(points.y.data(), to.dbYOffset, numPoints);
+}
+
+void EQVisualizerComponent::frequenciesToX(const ScreenMapping& mapping, const std::vector<float>& frequencies,
+                                           std::vector<float>& x)
+{
+    x.resize(frequencies.size());
+    
+    for (size_t i = 0; i < frequencies.size(); ++i)
+        x[i] = mapping.freqXOffset + mapping.freqXScale * std::log(frequencies[i]);
+}
+
+void EQVisualizerComponent::magnitudesToY(const ScreenMapping& mapping, const std::vector<float>& magnitudes,
+                                          std::vector<float>& y)
+{
+    y.resize(magnitudes.size());
+    
+    const int numValues = static_cast<int>(magnitudes.size());
+    juce::FloatVectorOperations::copyWithMultiply(y.data(), magnitudes.data(), mapping.dbYScale, numValues);
+    juce::FloatVectorOperations::add(y.data(), mapping.dbYOffset, numValues);
+}
+
+void EQVisualizerComponent::requestCurvePreparation(Curve curve)
+{
+    CurveRequest request;
+    request.curve = curve;
+    request.generation = ++requestedGenerations[static_cast<size_t>(curve)];
+    request.frequencies = curve == userCurve ? userFrequencies : referenceFrequencies;
+    request.magnitudes = curve == userCurve ? userMagnitudes : referenceMagnitudes;
+    request.mapping = screenMapping;
+    
     {
-        particles.push_back(p);
+        const juce::ScopedLock sl(requestLock);
+    
+        // Newer data replaces a request for the same curve that hasn't started yet
+        pendingRequests.erase(std::remove_if(pendingRequests.begin(), pendingRequests.end(),
+                                             [curve](const CurveRequest& pending) { return pending.curve == curve; }),
+                              pendingRequests.end());
+    
+        pendingRequests.push_back(std::move(request));
     }
+    
+    if (!isThreadRunning())
+        startThread();
+    
+    notify();
 }
 
-float EQVisualizerComponent::freqToX(float freq) const
+EQVisualizerComponent::PreparedCurve EQVisualizerComponent::prepareCurve(const CurveRequest& request)
 {
-    // Convert frequency to x position using logarithmic scale
-    const auto bounds = getLocalBounds().toFloat();
-    const float minFreq = 20.0f;
-    const float maxFreq = 20000.0f;
+    PreparedCurve prepared;
+    prepared.curve = request.curve;
+    prepared.generation = request.generation;
+    prepared.mapping = request.mapping;
     
-    float normX = std::log10(freq / minFreq) / std::log10(maxFreq / minFreq);
-    return bounds.getX() + normX * bounds.getWidth();
+    // The x positions only change with the frequencies or the size
+    auto& cache = curveCaches[static_cast<size_t>(request.curve)];
+    
+    if (cache.frequencies != request.frequencies || cache.mapping != request.mapping)
+    {
+        cache.frequencies = request.frequencies;
+        cache.mapping = request.mapping;
+        frequenciesToX(request.mapping, request.frequencies, cache.x);
+    }
+    
+    magnitudesToY(request.mapping, request.magnitudes, cache.y);
+    decimateCurve(cache.x, cache.y, prepared.points);
+    
+    // overlapFrequencies is set before the thread starts and never changes
+    resampleToGrid(request.frequencies, request.magnitudes, overlapFrequencies, prepared.overlapMagnitudes);
+    
+    return prepared;
 }
 
-float EQVisualizerComponent::dbToY(float db) const
+void EQVisualizerComponent::decimateCurve(const std::vector<float>& x, const std::vector<float>& y, CurvePoints& points)
 {
-    // Convert dB to y position
-    const auto bounds = getLocalBounds().toFloat();
-    const float minDb = -24.0f;
-    const float maxDb = 24.0f;
+    points.x.clear();
+    points.y.clear();
+    
+    const size_t numPoints = juce::jmin(x.size(), y.size());
+    points.x.reserve(numPoints);
+    points.y.reserve(numPoints);
+    
+    size_t first = 0;
     
-    float normY = 1.0f - (db - minDb) / (maxDb - minDb);
-    return bounds.getY() + normY * bounds.getHeight() * 0.8f + bounds.getHeight() * 0.1f;
+    while (first < numPoints)
+    {
+        // The run of points in the same pixel column (x is increasing)
+        const float column = std::floor(x[first]);
+        size_t end = first + 1;
+    
+        while (end < numPoints && std::floor(x[end]) == column)
+            ++end;
+    
+        if (end - first <= 2)
+        {
+            for (size_t i = first; i < end; ++i)
+            {
+                points.x.push_back(x[i]);
+                points.y.push_back(y[i]);
+            }
+        }
+        else
+        {
+            // Keep the highest and lowest point in their original order, so the column's
+            // vertical extent, and with it every peak and notch, is drawn
+            size_t lowest = first;
+            size_t highest = first;
+    
+            for (size_t i = first + 1; i < end; ++i)
+            {
+                if (y[i] < y[highest])
+                    highest = i;
+    
+                if (y[i] > y[lowest])
+                    lowest = i;
+            }
+    
+            points.x.push_back(x[juce::jmin(lowest, highest)]);
+            points.y.push_back(y[juce::jmin(lowest, highest)]);
+    
+            if (lowest != highest)
+            {
+                points.x.push_back(x[juce::jmax(lowest, highest)]);
+                points.y.push_back(y[juce::jmax(lowest, highest)]);
+            }
+        }
+
+        first = end;
+    }
+}
+
+void EQVisualizerComponent::run()
+{
+    while (!threadShouldExit())
+    {
+        CurveRequest request;
+        bool hasRequest = false;
+    
+        {
+            const juce::ScopedLock sl(requestLock);
+    
+            if (!pendingRequests.empty())
+            {
+                request = std::move(pendingRequests.front());
+                pendingRequests.erase(pendingRequests.begin());
+                hasRequest = true;
+            }
+        }
+
+        if (!hasRequest)
+        {
+            wait(-1);
+            continue;
+        }
+    
+        auto prepared = prepareCurve(request);
+    
+        {
+            const juce::ScopedLock sl(resultLock);
+            preparedCurves.push_back(std::move(prepared));
+        }
+    
+        triggerAsyncUpdate();
+    }
+}
+
+void EQVisualizerComponent::handleAsyncUpdate()
+{
+    std::vector<PreparedCurve> results;
+    
+    {
+        const juce::ScopedLock sl(resultLock);
+        results.swap(preparedCurves);
+    }
+    
+    bool curvesUpdated = false;
+    
+    for (auto& result : results)
+    {
+        // Results older than the one shown are dropped. Newer ones are shown even if more data
+        // has arrived since, so a curve fed faster than it is prepared still moves
+        auto& shownGeneration = shownGenerations[static_cast<size_t>(result.curve)];
+    
+        if (result.generation <= shownGeneration)
+            continue;
+    
+        shownGeneration = result.generation;
+    
+        // Prepared before the last resize: moved to the current size until the newer result arrives
+        rescalePoints(result.mapping, screenMapping, result.points);
+    
+        if (result.curve == userCurve)
+        {
+            userPoints = std::move(result.points);
+            userOverlapMagnitudes = std::move(result.overlapMagnitudes);
+        }
+        else
+        {
+            referencePoints = std::move(result.points);
+            referenceOverlapMagnitudes = std::move(result.overlapMagnitudes);
+        }
+    
+        curvesUpdated = true;
+    }
+    
+    if (curvesUpdated)
+    {
+        updateOverlapSegments();
+        curvesNeedRedraw();
+    }
 }
 
 } // namespace ForensEQ
@@ -1,15 +1,27 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "LiveSpectrumAnalyzer.h"
 
 namespace ForensEQ {
 
 /**
  * EQVisualizerComponent - A dual EQ visualization component that displays
  * both the user's mix and a reference track in a single view with visual effects.
+ *
+ * Drawing is split into cached layers: the background, grid and labels are rendered once
+ * per size, the curves and overlap glow are rendered over them only when the data or a
+ * curve setting changes, and each frame just draws that image and the particles on top.
+ *
+ * New curve data is prepared on a worker thread: converted to screen coordinates, reduced
+ * to at most two points per pixel column (keeping each column's highest and lowest point,
+ * so peaks and notches survive) and resampled for the overlap highlight. Drawing a curve
+ * therefore costs the same for a 4096-bin spectrum as for a 31-band one.
  */
 class EQVisualizerComponent : public juce::Component,
-                             public juce::Timer
+                             public juce::Timer,
+                             private juce::Thread,
+                             private juce::AsyncUpdater
 {
 public:
     EQVisualizerComponent();
@@ -22,6 +34,9 @@ public:
     // Set the EQ data for the user's mix
     void setUserEQData(const std::vector<float>& frequencies, const std::vector<float>& magnitudes);
     
+    // Drive the user curve from a live spectrum (polled on the timer); nullptr to detach
+    void setLiveSpectrumSource(LiveSpectrumAnalyzer* source) { liveSpectrumSource = source; }
+    
     // Set the EQ data for the reference track
     void setReferenceEQData(const std::vector<float>& frequencies, const std::vector<float>& magnitudes);
     
@@ -38,6 +53,34 @@ private:
     std::vector<float> referenceFrequencies;
     std::vector<float> referenceMagnitudes;
     
+    // Curves, also used to index per-curve state
+    enum Curve { userCurve, referenceCurve, numCurves };
+    
+    // Screen coordinates of each curve's decimated points for the current size, delivered by
+    // the worker thread when the data or the size changes
+    struct CurvePoints {
+        std::vector<float> x;
+        std::vector<float> y;
+    };
+    
+    CurvePoints userPoints;
+    CurvePoints referencePoints;
+    
+    // Both curves resampled onto a shared band grid, the ranges of grid bands where they
+    // overlap ([first, last) pairs), and the highlight path built from them for the current size
+    std::vector<float> overlapFrequencies;
+    std::vector<float> userOverlapMagnitudes;
+    std::vector<float> referenceOverlapMagnitudes;
+    std::vector<std::pair<int, int>> overlapSegments;
+    std::vector<float> overlapX;
+    juce::Path overlapPath;
+    bool overlapPathValid = false;
+    
+    // Live user spectrum source and scratch vectors reused on every poll
+    LiveSpectrumAnalyzer* liveSpectrumSource = nullptr;
+    std::vector<float> liveFrequencies;
+    std::vector<float> liveMagnitudes;
+    
     // Colors
     juce::Colour userCurveColor = juce::Colour(0, 120, 255);      // Blue
     juce::Colour referenceCurveColor = juce::Colour(255, 120, 0); // Orange
@@ -50,16 +93,82 @@ private:
     float curveThickness = 2.0f;
     float overlapThreshold = 3.0f; // dB threshold to consider curves as "overlapping"
     
-    // Animation properties
-    struct Particle {
-        float x, y;
-        float vx, vy;
-        float life;
-        float maxLife;
-        juce::Colour color;
+    // Displayed ranges
+    static constexpr float minFrequency = 20.0f;
+    static constexpr float maxFrequency = 20000.0f;
+    static constexpr float minDb = -24.0f;
+    static constexpr float maxDb = 24.0f;
+    
+    // Screen mapping for the current size, set by updateTransforms():
+    // x = freqXOffset + freqXScale * ln(freq) and y = dbYOffset + dbYScale * dB
+    struct ScreenMapping {
+        float freqXOffset = 0.0f;
+        float freqXScale = 0.0f;
+        float dbYOffset = 0.0f;
+        float dbYScale = 0.0f;
+    
+        bool operator==(const ScreenMapping& other) const
+        {
+            return freqXOffset == other.freqXOffset && freqXScale == other.freqXScale
+                && dbYOffset == other.dbYOffset && dbYScale == other.dbYScale;
+        }
+    
+        bool operator!=(const ScreenMapping& other) const { return !operator==(other); }
     };
     
-    std::vector<Particle> particles;
+    ScreenMapping screenMapping;
+    
+    // Curve preparation jobs and results, passed between the message thread and the worker
+    struct CurveRequest {
+        int curve = userCurve;
+        int generation = 0;
+        std::vector<float> frequencies;
+        std::vector<float> magnitudes;
+        ScreenMapping mapping;
+    };
+    
+    struct PreparedCurve {
+        int curve = userCurve;
+        int generation = 0;
+        CurvePoints points;
+        std::vector<float> overlapMagnitudes;
+        ScreenMapping mapping;
+    };
+    
+    juce::CriticalSection requestLock;
+    std::vector<CurveRequest> pendingRequests;
+    juce::CriticalSection resultLock;
+    std::vector<PreparedCurve> preparedCurves;
+    
+    // Generation of the last request and of the last result shown, per curve
+    std::array<int, numCurves> requestedGenerations {};
+    std::array<int, numCurves> shownGenerations {};
+    
+    // Worker thread only: the screen x of the frequencies each curve was last prepared with,
+    // so a live spectrum on fixed bins only converts its magnitudes, and scratch for y
+    struct CurveCache {
+        std::vector<float> frequencies;
+        ScreenMapping mapping;
+        std::vector<float> x;
+        std::vector<float> y;
+    };
+    
+    std::array<CurveCache, numCurves> curveCaches;
+    
+    // Animation properties. Particles live in a fixed-capacity pool with one array per
+    // field, so updating them is a few vector operations and nothing is allocated per frame.
+    // Live particles are packed at the front; a dead one is replaced by the last live one
+    static constexpr int maxParticles = 4096;
+    juce::HeapBlock<float> particleX, particleY;
+    juce::HeapBlock<float> particleVX, particleVY;
+    juce::HeapBlock<float> particleLife;
+    juce::HeapBlock<juce::uint8> particleCurve;
+    int numParticles = 0;
+    
+    // Particles are drawn in one fill per curve colour and alpha level
+    static constexpr int particleAlphaLevels = 8;
+    std::array<juce::Path, numCurves * particleAlphaLevels> particlePaths;
+    
     juce::Random random;
     float particleGenerationRate = 0.3f;
     float glowIntensity = 0.7f;
@@ -68,21 +177,51 @@ private:
     void setParticleRate(float rate);
     void setGlowIntensity(float intensity);
     
+    // Cached layers, rendered at the display's physical resolution: the background, grid
+    // and labels, and the same with the curves drawn over them
+    juce::Image backgroundLayer;
+    juce::Image curveLayer;
+    float layerScale = 0.0f;
+    bool curvesChanged = true;
+    
     // Helper methods
+    void updateLayers(float scale);
+    void curvesNeedRedraw();
+    void drawCurves(juce::Graphics& g);
+    void drawParticles(juce::Graphics& g);
     void drawBackground(juce::Graphics& g);
     void drawFrequencyLabels(juce::Graphics& g);
-    void drawEQCurve(juce::Graphics& g, const std::vector<float>& frequencies, 
-                    const std::vector<float>& magnitudes, juce::Colour color);
+    void drawEQCurve(juce::Graphics& g, const CurvePoints& points, juce::Colour color);
     void drawOverlapHighlights(juce::Graphics& g);
+    void updateOverlapSegments();
+    void buildOverlapPath();
+    static void resampleToGrid(const std::vector<float>& frequencies, const std::vector<float>& magnitudes,
+                               const std::vector<float>& grid, std::vector<float>& resampled);
     void updateParticles();
-    void addParticlesAlongCurve(const std::vector<float>& frequencies, 
-                               const std::vector<float>& magnitudes, juce::Colour color);
+    void addParticlesAlongCurve(const CurvePoints& points, Curve curve);
+    
+    // Recompute the screen mapping and everything derived from it, after a resize
+    void updateTransforms();
     
     // Convert frequency to x position
-    float freqToX(float freq) const;
+    float freqToX(float freq) const { return screenMapping.freqXOffset + screenMapping.freqXScale * std::log(freq); }
     
     // Convert magnitude (dB) to y position
-    float dbToY(float db) const;
+    float dbToY(float db) const { return screenMapping.dbYOffset + screenMapping.dbYScale * db; }
+    
+    // Convert whole arrays in one pass each
+    static void frequenciesToX(const ScreenMapping& mapping, const std::vector<float>& frequencies, std::vector<float>& x);
+    static void magnitudesToY(const ScreenMapping& mapping, const std::vector<float>& magnitudes, std::vector<float>& y);
+    
+    // Move points in screen coordinates from one mapping to another
+    static void rescalePoints(const ScreenMapping& from, const ScreenMapping& to, CurvePoints& points);
+    
+    // Curve preparation
+    void requestCurvePreparation(Curve curve);
+    PreparedCurve prepareCurve(const CurveRequest& request);
+    static void decimateCurve(const std::vector<float>& x, const std::vector<float>& y, CurvePoints& points);
+    void run() override;
+    void handleAsyncUpdate() override;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EQVisualizerComponent)
 };
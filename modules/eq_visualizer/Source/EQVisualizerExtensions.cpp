@@ -19,8 +19,13 @@ void EQVisualizerComponent::setGlowIntensity(float intensity)
     // Clamp intensity between 0.0 and 1.0
     float clampedIntensity = juce::jlimit(0.0f, 1.0f, intensity);
     
-    // This will affect the glow effect in drawOverlapHighlights
-    glowIntensity = clampedIntensity;
+    // This will affect the glow effect in drawOverlapHighlights, which is part of the
+    // cached curve layer
+    if (glowIntensity != clampedIntensity)
+    {
+        glowIntensity = clampedIntensity;
+        curvesNeedRedraw();
+    }
 }
 
 } // namespace ForensEQ
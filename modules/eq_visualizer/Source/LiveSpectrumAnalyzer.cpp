@@ -0,0 +1,193 @@
+#include "LiveSpectrumAnalyzer.h"
+
+namespace ForensEQ {
+
+LiveSpectrumAnalyzer::LiveSpectrumAnalyzer(int fftOrder, int bandsPerOctave)
+    : fftSize(1 << fftOrder),
+      bandLayout { bandsPerOctave },
+      numBands(static_cast<int>(SpectralBandMap::getCentreFrequencies(bandLayout).size())),
+      fft(fftOrder),
+      hopSize(fftSize / 4),
+      samplesUntilNextFrame(fftSize)
+{
+    // Periodic Hann window, computed once instead of per sample per frame
+    window.resize(static_cast<size_t>(fftSize));
+    float windowSum = 0.0f;
+
+    for (int i = 0; i < fftSize; ++i)
+    {
+        window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * static_cast<float>(i) / static_cast<float>(fftSize));
+        windowSum += window[static_cast<size_t>(i)];
+    }
+
+    // Scale so a full-scale sine reads 0 dBFS in its bin
+    const float amplitudeScale = 2.0f / windowSum;
+    powerNormalisation = amplitudeScale * amplitudeScale;
+
+    // Allocate all working storage up front; nothing below resizes again
+    inputHistory.assign(static_cast<size_t>(fftSize), 0.0f);
+    fftBuffer.assign(static_cast<size_t>(fftSize * 2), 0.0f);
+    binPowers.assign(static_cast<size_t>(fftSize / 2 + 1), 0.0f);
+    bandPowers.assign(static_cast<size_t>(numBands), 0.0f);
+    smoothedLevels.assign(static_cast<size_t>(numBands), silenceDb);
+
+    // The band count and frequencies depend only on the layout, so they are fixed here
+    const auto centreFrequencies = SpectralBandMap::getCentreFrequencies(bandLayout);
+
+    for (auto& snapshot : snapshots)
+    {
+        snapshot.frequencies = centreFrequencies;
+        snapshot.magnitudes.assign(static_cast<size_t>(numBands), 0.0f);
+    }
+
+    prepare(sampleRate);
+}
+
+LiveSpectrumAnalyzer::~LiveSpectrumAnalyzer()
+{
+}
+
+void LiveSpectrumAnalyzer::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+
+    // Overlap between 50% and 75%, but no more than ~120 frames per second so
+    // high sample rates do not run far more transforms than the display can show
+    hopSize = juce::jlimit(fftSize / 4, fftSize / 2, static_cast<int>(sampleRate / 120.0));
+
+    bandMap = SpectralBandMap::getShared(sampleRate, fftSize, bandLayout);
+    updateSmoothingCoefficients();
+    reset();
+}
+
+void LiveSpectrumAnalyzer::reset()
+{
+    std::fill(inputHistory.begin(), inputHistory.end(), 0.0f);
+    std::fill(smoothedLevels.begin(), smoothedLevels.end(), silenceDb);
+    historyWritePosition = 0;
+    samplesUntilNextFrame = fftSize;
+    hasSmoothedLevels = false;
+}
+
+void LiveSpectrumAnalyzer::pushSamples(const juce::AudioBuffer<float>& block)
+{
+    const int numChannels = block.getNumChannels();
+    const int numSamples = block.getNumSamples();
+
+    if (numChannels == 0 || numSamples == 0)
+        return;
+
+    const float* const* channelData = block.getArrayOfReadPointers();
+    const float channelScale = 1.0f / static_cast<float>(numChannels);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // Mix down to mono
+        float sample = 0.0f;
+        for (int channel = 0; channel < numChannels; ++channel)
+            sample += channelData[channel][i];
+
+        inputHistory[static_cast<size_t>(historyWritePosition)] = sample * channelScale;
+
+        if (++historyWritePosition == fftSize)
+            historyWritePosition = 0;
+
+        if (--samplesUntilNextFrame == 0)
+        {
+            processFrame();
+            samplesUntilNextFrame = hopSize;
+        }
+    }
+}
+
+bool LiveSpectrumAnalyzer::getLatestSpectrum(std::vector<float>& frequencies, std::vector<float>& magnitudes)
+{
+    if ((sharedSlot.load(std::memory_order_relaxed) & newDataFlag) == 0)
+        return false;
+
+    // Hand our slot back and take the freshly published one
+    readerSlot = sharedSlot.exchange(readerSlot, std::memory_order_acq_rel) & ~newDataFlag;
+
+    const auto& snapshot = snapshots[static_cast<size_t>(readerSlot)];
+    frequencies.assign(snapshot.frequencies.begin(), snapshot.frequencies.end());
+    magnitudes.assign(snapshot.magnitudes.begin(), snapshot.magnitudes.end());
+
+    return true;
+}
+
+void LiveSpectrumAnalyzer::setSmoothingTimes(float attackMs, float releaseMs)
+{
+    attackTimeMs = juce::jmax(0.0f, attackMs);
+    releaseTimeMs = juce::jmax(0.0f, releaseMs);
+    updateSmoothingCoefficients();
+}
+
+void LiveSpectrumAnalyzer::updateSmoothingCoefficients()
+{
+    // One-pole coefficients per analysis frame
+    const float hopSeconds = static_cast<float>(hopSize / sampleRate);
+
+    attackCoefficient = attackTimeMs > 0.0f ? std::exp(-hopSeconds / (attackTimeMs * 0.001f)) : 0.0f;
+    releaseCoefficient = releaseTimeMs > 0.0f ? std::exp(-hopSeconds / (releaseTimeMs * 0.001f)) : 0.0f;
+}
+
+void LiveSpectrumAnalyzer::processFrame()
+{
+    // Unroll the circular history (oldest sample first) and apply the window
+    const int tailLength = fftSize - historyWritePosition;
+
+    juce::FloatVectorOperations::multiply(fftBuffer.data(), inputHistory.data() + historyWritePosition, window.data(), tailLength);
+    juce::FloatVectorOperations::multiply(fftBuffer.data() + tailLength, inputHistory.data(), window.data() + tailLength, historyWritePosition);
+    juce::FloatVectorOperations::clear(fftBuffer.data() + fftSize, fftSize);
+
+    fft.performFrequencyOnlyForwardTransform(fftBuffer.data(), true);
+
+    // Average power across each band's bins
+    juce::FloatVectorOperations::multiply(binPowers.data(), fftBuffer.data(), fftBuffer.data(), fftSize / 2 + 1);
+    bandMap->mapBins(binPowers.data(), bandPowers.data());
+
+    for (int b = 0; b < numBands; ++b)
+    {
+        const float power = bandPowers[static_cast<size_t>(b)] * powerNormalisation;
+        const float levelDb = power > 0.0f ? juce::jmax(silenceDb, 10.0f * std::log10(power)) : silenceDb;
+
+        // Fast attack, slow release ballistics
+        float& smoothed = smoothedLevels[static_cast<size_t>(b)];
+
+        if (!hasSmoothedLevels)
+            smoothed = levelDb;
+        else
+        {
+            const float coefficient = levelDb > smoothed ? attackCoefficient : releaseCoefficient;
+            smoothed = levelDb + coefficient * (smoothed - levelDb);
+        }
+    }
+
+    hasSmoothedLevels = true;
+    publishSnapshot();
+}
+
+void LiveSpectrumAnalyzer::publishSnapshot()
+{
+    auto& snapshot = snapshots[static_cast<size_t>(writerSlot)];
+
+    // Relative levels keep the curve inside the visualizer's +/- dB range
+    float offset = 0.0f;
+    if (normaliseToMeanLevel)
+    {
+        float sum = 0.0f;
+        for (float level : smoothedLevels)
+            sum += level;
+
+        offset = sum / static_cast<float>(numBands);
+    }
+
+    // Frequencies were filled in at construction
+    for (int b = 0; b < numBands; ++b)
+        snapshot.magnitudes[static_cast<size_t>(b)] = smoothedLevels[static_cast<size_t>(b)] - offset;
+
+    // Publish our slot and take whichever one the reader is not using
+    writerSlot = sharedSlot.exchange(writerSlot | newDataFlag, std::memory_order_acq_rel) & ~newDataFlag;
+}
+
+} // namespace ForensEQ
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectralBandMap.h"
+
+namespace ForensEQ {
+
+/**
+ * LiveSpectrumAnalyzer - Streaming spectrum engine for the "user" curve of the EQ visualizer.
+ *
+ * Audio is pushed from a background analysis thread, framed with overlap, windowed and
+ * transformed with a single reused FFT plan. Bin powers are averaged into fractional-octave
+ * display bands through a precomputed SpectralBandMap, smoothed, and published through a lock-free triple buffer so the
+ * message thread can always pick up the newest complete spectrum without blocking.
+ */
+class LiveSpectrumAnalyzer {
+public:
+    LiveSpectrumAnalyzer(int fftOrder = 12, int bandsPerOctave = 24);
+    ~LiveSpectrumAnalyzer();
+
+    // Set the stream sample rate (analysis thread, before pushing samples)
+    void prepare(double sampleRate);
+
+    // Clear the input history and smoothing state (analysis thread)
+    void reset();
+
+    // Feed the next block of audio (analysis thread). All channels are mixed to mono.
+    // Never allocates; runs an FFT every time a hop's worth of samples has arrived
+    void pushSamples(const juce::AudioBuffer<float>& block);
+
+    // Copy the newest published spectrum into the given vectors (message thread).
+    // Returns false if nothing new has been published since the last call
+    bool getLatestSpectrum(std::vector<float>& frequencies, std::vector<float>& magnitudes);
+
+    // Set the smoothing times used for rising and falling band levels (before streaming starts)
+    void setSmoothingTimes(float attackMs, float releaseMs);
+
+    // Whether published levels are relative to the mean band level (default) or absolute dBFS
+    void setNormaliseToMeanLevel(bool shouldNormalise) { normaliseToMeanLevel = shouldNormalise; }
+
+    // Get the number of display bands
+    int getNumBands() const { return numBands; }
+
+private:
+    // A published spectrum
+    struct Snapshot {
+        std::vector<float> frequencies;
+        std::vector<float> magnitudes;
+    };
+
+    const int fftSize;
+    const SpectralBandMap::Layout bandLayout;
+    const int numBands;
+    juce::dsp::FFT fft;
+
+    double sampleRate = 44100.0;
+    int hopSize;
+
+    // Preallocated working storage
+    std::vector<float> window;
+    std::vector<float> inputHistory;   // circular, fftSize samples
+    std::vector<float> fftBuffer;      // 2 * fftSize, as required by the real-only transform
+    std::vector<float> binPowers;      // fftSize / 2 + 1
+    std::vector<float> bandPowers;     // per band
+    std::vector<float> smoothedLevels; // per band, dB
+    std::shared_ptr<const SpectralBandMap> bandMap; // for the current sample rate
+    int historyWritePosition = 0;
+    int samplesUntilNextFrame;
+    float powerNormalisation = 1.0f;
+
+    // Smoothing
+    float attackTimeMs = 20.0f;
+    float releaseTimeMs = 300.0f;
+    float attackCoefficient = 0.0f;
+    float releaseCoefficient = 0.0f;
+    bool hasSmoothedLevels = false;
+    std::atomic<bool> normaliseToMeanLevel { true };
+
+    // Triple buffer: the writer owns one slot, the reader owns one, and the third is
+    // exchanged atomically. The exchanged word holds the slot index plus a "new data" bit
+    std::array<Snapshot, 3> snapshots;
+    int writerSlot = 0;
+    int readerSlot = 1;
+    std::atomic<int> sharedSlot { 2 };
+    static constexpr int newDataFlag = 4;
+
+    static constexpr float silenceDb = -120.0f;
+
+    // Helper methods
+    void updateSmoothingCoefficients();
+    void processFrame();
+    void publishSnapshot();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LiveSpectrumAnalyzer)
+};
+
+} // namespace ForensEQ
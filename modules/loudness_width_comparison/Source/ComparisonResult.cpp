@@ -27,7 +27,8 @@ void ComparisonResult::setLoudnessValues(StemType stemType,
                                        float userRMS,
                                        float referenceRMS)
 {
-    LoudnessValues values;
+    // Keep any true-peak values already stored for this stem
+    LoudnessValues values = loudnessValues[stemType];
     values.userIntegratedLUFS = userIntegratedLUFS;
     values.referenceIntegratedLUFS = referenceIntegratedLUFS;
     values.userShortTermLUFS = userShortTermLUFS;
@@ -40,6 +41,13 @@ void ComparisonResult::setLoudnessValues(StemType stemType,
     loudnessValues[stemType] = values;
 }
 
+void ComparisonResult::setTruePeakValues(StemType stemType, float userTruePeak, float referenceTruePeak)
+{
+    LoudnessValues& values = loudnessValues[stemType];
+    values.userTruePeak = userTruePeak;
+    values.referenceTruePeak = referenceTruePeak;
+}
+
 void ComparisonResult::setWidthValues(StemType stemType,
                                     float userCorrelation,
                                     float referenceCorrelation,
@@ -55,6 +63,33 @@ void ComparisonResult::setWidthValues(StemType stemType,
     widthValues[stemType] = values;
 }
 
+void ComparisonResult::setTimeSeries(StemType stemType, const TimeSeries& userSeries, const TimeSeries& referenceSeries)
+{
+    timeSeries[stemType] = { userSeries, referenceSeries };
+}
+
+const ComparisonResult::TimeSeries& ComparisonResult::getUserTimeSeries(StemType stemType) const
+{
+    static const TimeSeries emptySeries;
+    
+    auto it = timeSeries.find(stemType);
+    return it != timeSeries.end() ? it->second.first : emptySeries;
+}
+
+const ComparisonResult::TimeSeries& ComparisonResult::getReferenceTimeSeries(StemType stemType) const
+{
+    static const TimeSeries emptySeries;
+    
+    auto it = timeSeries.find(stemType);
+    return it != timeSeries.end() ? it->second.second : emptySeries;
+}
+
+void ComparisonResult::setAlignment(double offsetSeconds, float confidence)
+{
+    alignmentOffset = offsetSeconds;
+    alignmentConfidence = confidence;
+}
+
 float ComparisonResult::getLoudnessDifference(StemType stemType, LoudnessAnalyzer::LoudnessType loudnessType) const
 {
     auto it = loudnessValues.find(stemType);
@@ -73,6 +108,8 @@ float ComparisonResult::getLoudnessDifference(StemType stemType, LoudnessAnalyze
             return values.userMomentaryLUFS - values.referenceMomentaryLUFS;
         case LoudnessAnalyzer::LoudnessType::RMS:
             return values.userRMS - values.referenceRMS;
+        case LoudnessAnalyzer::LoudnessType::TruePeak:
+            return values.userTruePeak - values.referenceTruePeak;
         default:
             return 0.0f;
     }
@@ -160,6 +197,8 @@ float ComparisonResult::getUserLoudness(StemType stemType, LoudnessAnalyzer::Lou
             return values.userMomentaryLUFS;
         case LoudnessAnalyzer::LoudnessType::RMS:
             return values.userRMS;
+        case LoudnessAnalyzer::LoudnessType::TruePeak:
+            return values.userTruePeak;
         default:
             return -70.0f;
     }
@@ -183,6 +222,8 @@ float ComparisonResult::getReferenceLoudness(StemType stemType, LoudnessAnalyzer
             return values.referenceMomentaryLUFS;
         case LoudnessAnalyzer::LoudnessType::RMS:
             return values.referenceRMS;
+        case LoudnessAnalyzer::LoudnessType::TruePeak:
+            return values.referenceTruePeak;
         default:
             return -70.0f;
     }
@@ -267,6 +308,7 @@ juce::String ComparisonResult::toJSON() const
         userObject->setProperty("ShortTermLUFS", pair.second.userShortTermLUFS);
         userObject->setProperty("MomentaryLUFS", pair.second.userMomentaryLUFS);
         userObject->setProperty("RMS", pair.second.userRMS);
+        userObject->setProperty("TruePeak", pair.second.userTruePeak);
         
         // Reference values
         juce::DynamicObject::Ptr referenceObject = new juce::DynamicObject();
@@ -274,6 +316,7 @@ juce::String ComparisonResult::toJSON() const
         referenceObject->setProperty("ShortTermLUFS", pair.second.referenceShortTermLUFS);
         referenceObject->setProperty("MomentaryLUFS", pair.second.referenceMomentaryLUFS);
         referenceObject->setProperty("RMS", pair.second.referenceRMS);
+        referenceObject->setProperty("TruePeak", pair.second.referenceTruePeak);
         
         stemObject->setProperty("User", juce::var(userObject.get()));
         stemObject->setProperty("Reference", juce::var(referenceObject.get()));
@@ -350,6 +393,12 @@ juce::String ComparisonResult::toJSON() const
     
     rootObject->setProperty("MatchScores", juce::var(matchScoresObject.get()));
     
+    // Alignment of the tracks
+    juce::DynamicObject::Ptr alignmentObject = new juce::DynamicObject();
+    alignmentObject->setProperty("Offset", alignmentOffset);
+    alignmentObject->setProperty("Confidence", alignmentConfidence);
+    rootObject->setProperty("Alignment", juce::var(alignmentObject.get()));
+    
     return juce::JSON::toString(juce::var(rootObject.get()));
 }
 
@@ -360,9 +409,12 @@ bool ComparisonResult::fromJSON(const juce::String& jsonString)
     if (!parsedJson.isObject())
         return false;
     
-    // Clear existing data
+    // Clear existing data (time series are not part of the JSON)
     loudnessValues.clear();
     widthValues.clear();
+    timeSeries.clear();
+    alignmentOffset = 0.0;
+    alignmentConfidence = 0.0f;
     
     // Initialize with default values
     for (int i = 0; i < 6; ++i)
@@ -413,6 +465,8 @@ bool ComparisonResult::fromJSON(const juce::String& jsonString)
                         values.userMomentaryLUFS = static_cast<float>(userVar["MomentaryLUFS"]);
                     if (userVar.hasProperty("RMS"))
                         values.userRMS = static_cast<float>(userVar["RMS"]);
+                    if (userVar.hasProperty("TruePeak"))
+                        values.userTruePeak = static_cast<float>(userVar["TruePeak"]);
                     
                     if (referenceVar.hasProperty("IntegratedLUFS"))
                         values.referenceIntegratedLUFS = static_cast<float>(referenceVar["IntegratedLUFS"]);
@@ -422,6 +476,8 @@ bool ComparisonResult::fromJSON(const juce::String& jsonString)
                         values.referenceMomentaryLUFS = static_cast<float>(referenceVar["MomentaryLUFS"]);
                     if (referenceVar.hasProperty("RMS"))
                         values.referenceRMS = static_cast<float>(referenceVar["RMS"]);
+                    if (referenceVar.hasProperty("TruePeak"))
+                        values.referenceTruePeak = static_cast<float>(referenceVar["TruePeak"]);
                     
                     loudnessValues[stemType] = values;
                 }
@@ -478,6 +534,17 @@ bool ComparisonResult::fromJSON(const juce::String& jsonString)
         }
     }
     
+    // Parse alignment, absent in results saved before it existed
+    if (parsedJson.hasProperty("Alignment") && parsedJson["Alignment"].isObject())
+    {
+        juce::var alignmentVar = parsedJson["Alignment"];
+        
+        if (alignmentVar.hasProperty("Offset"))
+            alignmentOffset = static_cast<double>(alignmentVar["Offset"]);
+        if (alignmentVar.hasProperty("Confidence"))
+            alignmentConfidence = static_cast<float>(alignmentVar["Confidence"]);
+    }
+    
     return true;
 }
 
@@ -35,6 +35,9 @@ public:
                           float userRMS,
                           float referenceRMS);
     
+    // Set true-peak values (dBTP) for a specific stem
+    void setTruePeakValues(StemType stemType, float userTruePeak, float referenceTruePeak);
+    
     // Set width values for a specific stem
     void setWidthValues(StemType stemType,
                        float userCorrelation,
@@ -42,6 +45,24 @@ public:
                        float userMidSideRatio,
                        float referenceMidSideRatio);
     
+    // Loudness and width of one track over time, one value per interval
+    struct TimeSeries {
+        float interval = 1.0f;       // Seconds per value
+        std::vector<float> loudness; // Short-term loudness (LUFS) at the end of each interval
+        std::vector<float> width;    // Width percentage over each interval
+    };
+    
+    // Set/get the time series of a specific stem
+    void setTimeSeries(StemType stemType, const TimeSeries& userSeries, const TimeSeries& referenceSeries);
+    const TimeSeries& getUserTimeSeries(StemType stemType) const;
+    const TimeSeries& getReferenceTimeSeries(StemType stemType) const;
+    
+    // Set/get the time offset between the tracks: material at time t in the user mix is at
+    // t + offset in the reference. The confidence (0 to 1) says how well the tracks matched
+    void setAlignment(double offsetSeconds, float confidence);
+    double getAlignmentOffset() const { return alignmentOffset; }
+    float getAlignmentConfidence() const { return alignmentConfidence; }
+    
     // Get loudness difference for a specific stem and loudness type
     float getLoudnessDifference(StemType stemType, LoudnessAnalyzer::LoudnessType loudnessType) const;
     
@@ -86,6 +107,8 @@ private:
         float referenceMomentaryLUFS = -70.0f;
         float userRMS = -70.0f;
         float referenceRMS = -70.0f;
+        float userTruePeak = -70.0f;
+        float referenceTruePeak = -70.0f;
     };
     
     // Structure to hold width values for a stem
@@ -99,6 +122,9 @@ private:
     // Maps to store values for each stem type
     std::map<StemType, LoudnessValues> loudnessValues;
     std::map<StemType, WidthValues> widthValues;
+    std::map<StemType, std::pair<TimeSeries, TimeSeries>> timeSeries; // user, reference
+    double alignmentOffset = 0.0;
+    float alignmentConfidence = 0.0f;
     
     // Helper methods to calculate match scores
     float calculateLoudnessMatchScore(float difference, LoudnessAnalyzer::LoudnessType type) const;
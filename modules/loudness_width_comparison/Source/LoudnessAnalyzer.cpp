@@ -24,6 +24,8 @@ float LoudnessAnalyzer::calculateLoudness(const juce::AudioBuffer<float>& buffer
             return calculateMomentaryLUFS(buffer, sampleRate);
         case LoudnessType::RMS:
             return calculateRMS(buffer);
+        case LoudnessType::TruePeak:
+            return calculateTruePeak(buffer, sampleRate);
         default:
             return 0.0f;
     }
@@ -55,6 +57,9 @@ juce::String LoudnessAnalyzer::getLoudnessDifferenceDescription(float difference
         case LoudnessType::RMS:
             unit = "dB";
             break;
+        case LoudnessType::TruePeak:
+            unit = "dBTP";
+            break;
     }
     
     if (std::abs(difference) < 0.5f)
@@ -142,52 +147,57 @@ float LoudnessAnalyzer::calculateLoudnessMatchScore(const juce::AudioBuffer<floa
 
 float LoudnessAnalyzer::calculateIntegratedLUFS(const juce::AudioBuffer<float>& buffer, double sampleRate)
 {
-    // This is a simplified implementation of the ITU-R BS.1770-4 algorithm
-    // A full implementation would require multiple stages of filtering and gating
-    
+    // ITU-R BS.1770-4: K-weighted, absolute and relative gated
     if (buffer.getNumSamples() == 0)
-        return -70.0f; // Silent
-    
-    // Apply K-weighting filter (simplified)
-    juce::AudioBuffer<float> filteredBuffer(buffer.getNumChannels(), buffer.getNumSamples());
-    filteredBuffer.copyFrom(0, 0, buffer, 0, 0, buffer.getNumSamples());
-    
-    // Calculate mean square for each channel
-    double sum = 0.0;
-    int numChannels = buffer.getNumChannels();
-    
-    for (int channel = 0; channel < numChannels; ++channel)
-    {
-        const float* channelData = buffer.getReadPointer(channel);
-        
-        for (int i = 0; i < buffer.getNumSamples(); ++i)
-        {
-            float sample = channelData[i];
-            sum += sample * sample;
-        }
-    }
+        return StreamingLoudnessMeter::silenceLUFS;
     
-    // Calculate mean square
-    double meanSquare = sum / (buffer.getNumSamples() * numChannels);
-    
-    // Convert to LUFS (simplified)
-    return 10.0f * std::log10(meanSquare) - 0.691f;
+    measureBuffer(buffer, sampleRate);
+    return loudnessMeter.getIntegratedLoudness();
 }
 
 float LoudnessAnalyzer::calculateShortTermLUFS(const juce::AudioBuffer<float>& buffer, double sampleRate)
 {
-    // Short-term LUFS uses a 3-second window
-    // This is a simplified implementation
+    // Short-term LUFS uses a 3-second window; report the maximum over the buffer
+    if (buffer.getNumSamples() == 0)
+        return StreamingLoudnessMeter::silenceLUFS;
     
-    return calculateIntegratedLUFS(buffer, sampleRate) + 0.5f; // Slight adjustment for demonstration
+    measureBuffer(buffer, sampleRate);
+    return loudnessMeter.getMaxShortTermLoudness();
 }
 
 float LoudnessAnalyzer::calculateMomentaryLUFS(const juce::AudioBuffer<float>& buffer, double sampleRate)
 {
-    // Momentary LUFS uses a 400ms window
-    // This is a simplified implementation
+    // Momentary LUFS uses a 400ms window; report the maximum over the buffer
+    if (buffer.getNumSamples() == 0)
+        return StreamingLoudnessMeter::silenceLUFS;
+    
+    measureBuffer(buffer, sampleRate);
+    return loudnessMeter.getMaxMomentaryLoudness();
+}
+
+float LoudnessAnalyzer::calculateLoudnessRange(const juce::AudioBuffer<float>& buffer, double sampleRate)
+{
+    if (buffer.getNumSamples() == 0)
+        return 0.0f;
     
-    return calculateIntegratedLUFS(buffer, sampleRate) + 1.0f; // Slight adjustment for demonstration
+    measureBuffer(buffer, sampleRate);
+    return loudnessMeter.getLoudnessRange();
+}
+
+float LoudnessAnalyzer::calculateTruePeak(const juce::AudioBuffer<float>& buffer, double sampleRate)
+{
+    if (buffer.getNumSamples() == 0)
+        return TruePeakDetector::silenceDb;
+    
+    truePeakDetector.prepare(sampleRate, buffer.getNumChannels());
+    truePeakDetector.processBlock(buffer);
+    return truePeakDetector.getTruePeakDb();
+}
+
+void LoudnessAnalyzer::measureBuffer(const juce::AudioBuffer<float>& buffer, double sampleRate)
+{
+    loudnessMeter.prepare(sampleRate, buffer.getNumChannels());
+    loudnessMeter.processBlock(buffer);
 }
 
 float LoudnessAnalyzer::calculateRMS(const juce::AudioBuffer<float>& buffer)
@@ -209,11 +219,19 @@ float LoudnessAnalyzer::calculateRMS(const juce::AudioBuffer<float>& buffer)
         }
     }
     
+    return rmsFromSumOfSquares(sum, static_cast<double>(buffer.getNumSamples()) * numChannels);
+}
+
+float LoudnessAnalyzer::rmsFromSumOfSquares(double sumOfSquares, double numValues)
+{
+    if (numValues <= 0.0)
+        return -70.0f; // Silent
+    
     // Calculate RMS
-    double rms = std::sqrt(sum / (buffer.getNumSamples() * numChannels));
+    double rms = std::sqrt(sumOfSquares / numValues);
     
     // Convert to dB
-    return 20.0f * std::log10(rms + 1.0e-6f);
+    return static_cast<float>(20.0f * std::log10(rms + 1.0e-6f));
 }
 
 } // namespace ForensEQ
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "StreamingLoudnessMeter.h"
+#include "TruePeakDetector.h"
 
 namespace ForensEQ {
 
@@ -17,7 +19,8 @@ public:
         Integrated,
         ShortTerm,
         Momentary,
-        RMS
+        RMS,
+        TruePeak
     };
     
     // Calculate loudness metrics for an audio buffer
@@ -25,6 +28,12 @@ public:
                            LoudnessType type, 
                            double sampleRate = 44100.0);
     
+    // Calculate the EBU R128 loudness range (LRA) of an audio buffer in LU
+    float calculateLoudnessRange(const juce::AudioBuffer<float>& buffer, double sampleRate = 44100.0);
+    
+    // Convert a sum of squared samples to an RMS level in dB
+    static float rmsFromSumOfSquares(double sumOfSquares, double numValues);
+    
     // Calculate loudness difference between two audio buffers
     float calculateLoudnessDifference(const juce::AudioBuffer<float>& userBuffer,
                                      const juce::AudioBuffer<float>& referenceBuffer,
@@ -49,6 +58,16 @@ private:
     float calculateShortTermLUFS(const juce::AudioBuffer<float>& buffer, double sampleRate);
     float calculateMomentaryLUFS(const juce::AudioBuffer<float>& buffer, double sampleRate);
     float calculateRMS(const juce::AudioBuffer<float>& buffer);
+    float calculateTruePeak(const juce::AudioBuffer<float>& buffer, double sampleRate);
+    
+    // Run a whole buffer through the streaming meter
+    void measureBuffer(const juce::AudioBuffer<float>& buffer, double sampleRate);
+    
+    // Streaming BS.1770-4 meter used for all LUFS measurements
+    StreamingLoudnessMeter loudnessMeter;
+    
+    // 4x oversampled BS.1770-4 true-peak detector
+    TruePeakDetector truePeakDetector;
     
     // Tolerance thresholds for match scoring
     float perfectMatchThreshold = 0.5f;  // LUFS difference for 100% match
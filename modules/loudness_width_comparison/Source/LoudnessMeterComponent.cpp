@@ -150,6 +150,8 @@ juce::String LoudnessMeterComponent::getLoudnessTypeString() const
             return "Momentary LUFS";
         case LoudnessAnalyzer::LoudnessType::RMS:
             return "RMS Level";
+        case LoudnessAnalyzer::LoudnessType::TruePeak:
+            return "True Peak dBTP";
         default:
             return "Loudness";
     }
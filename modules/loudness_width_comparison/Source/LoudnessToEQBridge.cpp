@@ -25,6 +25,11 @@ juce::Array<float> LoudnessToEQBridge::getEQFrequencyData(bool isUserMix) const
     return generateEQDataFromLoudness(isUserMix);
 }
 
+std::vector<float> LoudnessToEQBridge::getEQBandFrequencies()
+{
+    return SpectralBandMap::getCentreFrequencies(SpectralBandMap::thirdOctave());
+}
+
 float LoudnessToEQBridge::getEQMatchPercentage() const
 {
     return currentResult.getCombinedMatchScore(currentStemType);
@@ -36,18 +41,12 @@ juce::Array<float> LoudnessToEQBridge::generateEQDataFromLoudness(bool isUserMix
     // This is a simplified approach - in a real implementation, this would
     // use actual frequency analysis data from the audio
     
-    // Create frequency bands (typically 31-band EQ)
-    const int numBands = 31;
+    // Create frequency bands (31-band EQ, in the shared third-octave layout)
+    const std::vector<float> bands = getEQBandFrequencies();
+    const int numBands = static_cast<int>(bands.size());
     juce::Array<float> eqData;
     eqData.resize(numBands);
     
-    // Define frequency bands (in Hz)
-    const float bands[numBands] = {
-        20, 25, 31.5, 40, 50, 63, 80, 100, 125, 160, 200, 250, 315, 400, 500,
-        630, 800, 1000, 1250, 1600, 2000, 2500, 3150, 4000, 5000, 6300, 8000,
-        10000, 12500, 16000, 20000
-    };
-    
     // Get loudness values for the current stem
     float integratedLUFS = isUserMix 
         ? currentResult.getUserLoudness(currentStemType, LoudnessAnalyzer::LoudnessType::Integrated)
@@ -3,6 +3,7 @@
 #include <JuceHeader.h>
 #include "ComparisonResult.h"
 #include "LoudnessWidthAnalyzer.h"
+#include "SpectralBandMap.h"
 
 namespace ForensEQ {
 
@@ -24,6 +25,9 @@ public:
     // Returns frequency data that can be passed to the EQ visualizer
     juce::Array<float> getEQFrequencyData(bool isUserMix) const;
     
+    // Get the centre frequencies of the third-octave bands returned by getEQFrequencyData()
+    static std::vector<float> getEQBandFrequencies();
+    
     // Get the match percentage between user and reference EQ curves
     float getEQMatchPercentage() const;
 
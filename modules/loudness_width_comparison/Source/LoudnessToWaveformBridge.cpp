@@ -4,8 +4,6 @@ namespace ForensEQ {
 
 LoudnessToWaveformBridge::LoudnessToWaveformBridge()
 {
-    // Generate initial mock data
-    generateMockData();
 }
 
 LoudnessToWaveformBridge::~LoudnessToWaveformBridge()
@@ -14,118 +12,186 @@ LoudnessToWaveformBridge::~LoudnessToWaveformBridge()
 
 void LoudnessToWaveformBridge::setComparisonResult(const ComparisonResult& result)
 {
-    currentResult = result;
+    // Keep only the time series; markers are built again on demand
+    timeSeries.clear();
+    markerCache.clear();
     
-    // Update mock data based on new comparison result
-    generateMockData();
+    referenceOffset = result.getAlignmentConfidence() >= TrackAligner::minConfidence ? result.getAlignmentOffset() : 0.0;
+    
+    for (int i = 0; i < 6; ++i)
+    {
+        auto stemType = static_cast<ComparisonResult::StemType>(i);
+        timeSeries[stemType] = { result.getUserTimeSeries(stemType), result.getReferenceTimeSeries(stemType) };
+    }
 }
 
 void LoudnessToWaveformBridge::setStemType(ComparisonResult::StemType type)
 {
+    // Markers already built for this stem are reused
     currentStemType = type;
-    
-    // Update mock data based on new stem type
-    generateMockData();
 }
 
 juce::Array<LoudnessToWaveformBridge::LoudnessMarker> LoudnessToWaveformBridge::getLoudnessMarkers() const
 {
-    return mockLoudnessMarkers;
+    return getCurrentMarkers().loudnessMarkers;
+}
+
+juce::Array<LoudnessToWaveformBridge::LoudnessMarker> LoudnessToWaveformBridge::getLoudnessMarkers(float startTime, float endTime) const
+{
+    const auto& markers = getCurrentMarkers().loudnessMarkers;
+    
+    // Markers are in time order, so the range is found by binary search
+    auto first = std::lower_bound(markers.begin(), markers.end(), startTime,
+                                  [](const LoudnessMarker& marker, float time) { return marker.timePosition < time; });
+    
+    juce::Array<LoudnessMarker> rangeMarkers;
+    
+    for (auto it = first; it != markers.end() && it->timePosition <= endTime; ++it)
+        rangeMarkers.add(*it);
+    
+    return rangeMarkers;
 }
 
 juce::Array<LoudnessToWaveformBridge::WidthMarker> LoudnessToWaveformBridge::getWidthMarkers() const
 {
-    return mockWidthMarkers;
+    return getCurrentMarkers().widthMarkers;
+}
+
+juce::Array<LoudnessToWaveformBridge::WidthMarker> LoudnessToWaveformBridge::getWidthMarkers(float startTime, float endTime) const
+{
+    const auto& markers = getCurrentMarkers().widthMarkers;
+    
+    auto first = std::lower_bound(markers.begin(), markers.end(), startTime,
+                                  [](const WidthMarker& marker, float time) { return marker.timePosition < time; });
+    
+    juce::Array<WidthMarker> rangeMarkers;
+    
+    for (auto it = first; it != markers.end() && it->timePosition <= endTime; ++it)
+        rangeMarkers.add(*it);
+    
+    return rangeMarkers;
 }
 
 juce::Array<LoudnessToWaveformBridge::DifferenceRegion> LoudnessToWaveformBridge::getDifferenceRegions() const
 {
-    return mockDifferenceRegions;
+    return getCurrentMarkers().differenceRegions;
 }
 
-void LoudnessToWaveformBridge::generateMockData()
+void LoudnessToWaveformBridge::setDifferenceThresholds(float newLoudnessThreshold, float newWidthThreshold,
+                                                       float newMinRegionLength)
 {
-    // Clear existing mock data
-    mockLoudnessMarkers.clear();
-    mockWidthMarkers.clear();
-    mockDifferenceRegions.clear();
+    loudnessThreshold = newLoudnessThreshold;
+    widthThreshold = newWidthThreshold;
+    minRegionLength = newMinRegionLength;
     
-    // Get loudness values for the current stem
-    float userIntegratedLUFS = currentResult.getUserLoudness(currentStemType, LoudnessAnalyzer::LoudnessType::Integrated);
-    float referenceIntegratedLUFS = currentResult.getReferenceLoudness(currentStemType, LoudnessAnalyzer::LoudnessType::Integrated);
+    markerCache.clear();
+}
     
-    float userShortTermLUFS = currentResult.getUserLoudness(currentStemType, LoudnessAnalyzer::LoudnessType::ShortTerm);
-    float referenceShortTermLUFS = currentResult.getReferenceLoudness(currentStemType, LoudnessAnalyzer::LoudnessType::ShortTerm);
+const LoudnessToWaveformBridge::StemMarkers& LoudnessToWaveformBridge::getCurrentMarkers() const
+{
+    auto it = markerCache.find(currentStemType);
     
-    // Get width values for the current stem
-    float userWidthPercentage = currentResult.getUserWidth(currentStemType, StereoWidthAnalyzer::WidthType::Percentage);
-    float referenceWidthPercentage = currentResult.getReferenceWidth(currentStemType, StereoWidthAnalyzer::WidthType::Percentage);
+    if (it == markerCache.end())
+    {
+        it = markerCache.emplace(currentStemType, StemMarkers()).first;
+        buildMarkers(currentStemType, it->second);
+    }
     
-    // Create mock loudness markers
-    // In a real implementation, these would be derived from actual time-based analysis
-    juce::Random random;
+    return it->second;
+}
+
+void LoudnessToWaveformBridge::buildMarkers(ComparisonResult::StemType stemType, StemMarkers& markers) const
+{
+    auto it = timeSeries.find(stemType);
+    if (it == timeSeries.end())
+        return;
     
-    // Create markers for a 3-minute track
-    const float trackLength = 180.0f; // 3 minutes in seconds
-    const int numMarkers = 20;
+    const auto& userSeries = it->second.first;
+    const auto& referenceSeries = it->second.second;
     
-    for (int i = 0; i < numMarkers; ++i)
+    // One marker per interval and track, placed at the end of its interval on the user's
+    // timeline; reference material from before the user mix starts is left out
+    auto addMarkers = [&markers](const ComparisonResult::TimeSeries& series, bool isUserMix, float offset)
     {
-        float timePosition = (i / (float)(numMarkers - 1)) * trackLength;
-        
-        // Create user mix marker with some variation around the integrated LUFS
-        LoudnessMarker userMarker;
-        userMarker.timePosition = timePosition;
-        userMarker.loudnessValue = userIntegratedLUFS + random.nextFloat() * 4.0f - 2.0f;
-        userMarker.isUserMix = true;
-        mockLoudnessMarkers.add(userMarker);
-        
-        // Create reference mix marker with some variation around the integrated LUFS
-        LoudnessMarker referenceMarker;
-        referenceMarker.timePosition = timePosition;
-        referenceMarker.loudnessValue = referenceIntegratedLUFS + random.nextFloat() * 4.0f - 2.0f;
-        referenceMarker.isUserMix = false;
-        mockLoudnessMarkers.add(referenceMarker);
-        
-        // Create width markers
-        WidthMarker userWidthMarker;
-        userWidthMarker.timePosition = timePosition;
-        userWidthMarker.widthValue = userWidthPercentage + random.nextFloat() * 20.0f - 10.0f;
-        userWidthMarker.isUserMix = true;
-        mockWidthMarkers.add(userWidthMarker);
-        
-        WidthMarker referenceWidthMarker;
-        referenceWidthMarker.timePosition = timePosition;
-        referenceWidthMarker.widthValue = referenceWidthPercentage + random.nextFloat() * 20.0f - 10.0f;
-        referenceWidthMarker.isUserMix = false;
-        mockWidthMarkers.add(referenceWidthMarker);
-    }
+        for (size_t i = 0; i < series.loudness.size(); ++i)
+        {
+            const float time = (i + 1) * series.interval - offset;
+            if (time >= 0.0f)
+                markers.loudnessMarkers.add({ time, series.loudness[i], isUserMix });
+        }
+    
+        for (size_t i = 0; i < series.width.size(); ++i)
+        {
+            const float time = (i + 1) * series.interval - offset;
+            if (time >= 0.0f)
+                markers.widthMarkers.add({ time, series.width[i], isUserMix });
+        }
+    };
+    
+    addMarkers(userSeries, true, 0.0f);
+    addMarkers(referenceSeries, false, static_cast<float>(referenceOffset));
+    
+    // Time order, user marker first where both tracks have one
+    std::stable_sort(markers.loudnessMarkers.begin(), markers.loudnessMarkers.end(),
+                     [](const LoudnessMarker& a, const LoudnessMarker& b) { return a.timePosition < b.timePosition; });
+    std::stable_sort(markers.widthMarkers.begin(), markers.widthMarkers.end(),
+                     [](const WidthMarker& a, const WidthMarker& b) { return a.timePosition < b.timePosition; });
+    
+    // Both tracks are analyzed with the same interval
+    jassert(userSeries.interval == referenceSeries.interval);
     
-    // Create mock difference regions
-    // In a real implementation, these would be derived from actual analysis
+    findDifferenceRegions(userSeries.loudness, referenceSeries.loudness, userSeries.interval,
+                          loudnessThreshold, true, markers.differenceRegions);
+    findDifferenceRegions(userSeries.width, referenceSeries.width, userSeries.interval,
+                          widthThreshold, false, markers.differenceRegions);
     
-    // Create a few loudness difference regions
-    const int numLoudnessDiffRegions = 3;
-    for (int i = 0; i < numLoudnessDiffRegions; ++i)
+    std::stable_sort(markers.differenceRegions.begin(), markers.differenceRegions.end(),
+                     [](const DifferenceRegion& a, const DifferenceRegion& b) { return a.startTime < b.startTime; });
+}
+
+void LoudnessToWaveformBridge::findDifferenceRegions(const std::vector<float>& userValues,
+                                                     const std::vector<float>& referenceValues,
+                                                     float interval, float threshold, bool isLoudness,
+                                                     juce::Array<DifferenceRegion>& regions) const
+{
+    // User interval i is compared with the reference interval holding the same material,
+    // over the intervals both tracks cover
+    const int shift = juce::roundToInt(referenceOffset / interval);
+    const int numUserValues = static_cast<int>(userValues.size());
+    const int numReferenceValues = static_cast<int>(referenceValues.size());
+    const int firstValue = juce::jmax(0, -shift);
+    const int endValue = juce::jmin(numUserValues, numReferenceValues - shift);
+    const int minRegionValues = juce::jmax(1, juce::roundToInt(minRegionLength / interval));
+    
+    auto differenceAt = [&](int index)
     {
-        DifferenceRegion region;
-        region.startTime = random.nextFloat() * (trackLength - 20.0f);
-        region.endTime = region.startTime + 10.0f + random.nextFloat() * 10.0f;
-        region.difference = std::abs(userIntegratedLUFS - referenceIntegratedLUFS) + random.nextFloat() * 2.0f;
-        region.isLoudness = true;
-        mockDifferenceRegions.add(region);
-    }
+        return std::abs(userValues[static_cast<size_t>(index)] - referenceValues[static_cast<size_t>(index + shift)]);
+    };
     
-    // Create a few width difference regions
-    const int numWidthDiffRegions = 2;
-    for (int i = 0; i < numWidthDiffRegions; ++i)
+    int index = firstValue;
+    
+    while (index < endValue)
     {
-        DifferenceRegion region;
-        region.startTime = random.nextFloat() * (trackLength - 20.0f);
-        region.endTime = region.startTime + 10.0f + random.nextFloat() * 10.0f;
-        region.difference = std::abs(userWidthPercentage - referenceWidthPercentage) + random.nextFloat() * 10.0f;
-        region.isLoudness = false;
-        mockDifferenceRegions.add(region);
+        if (differenceAt(index) < threshold)
+        {
+            ++index;
+            continue;
+        }
+    
+        // A run of intervals that all differ by at least the threshold
+        const int regionStart = index;
+        float differenceSum = 0.0f;
+    
+        while (index < endValue && differenceAt(index) >= threshold)
+        {
+            differenceSum += differenceAt(index);
+            ++index;
+        }
+    
+        const int regionLength = index - regionStart;
+    
+        if (regionLength >= minRegionValues)
+            regions.add({ regionStart * interval, index * interval, differenceSum / regionLength, isLoudness });
     }
 }
 
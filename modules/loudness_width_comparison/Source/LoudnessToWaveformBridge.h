@@ -8,6 +8,14 @@ namespace ForensEQ {
 
 /**
  * Bridge class to connect the loudness/width module with the waveform viewer module
+ *
+ * Markers and difference regions come from the loudness and width time series measured
+ * during analysis. They are built the first time a stem is shown and kept until a new
+ * comparison result arrives, so switching stems or scrubbing never re-analyzes anything.
+ *
+ * Everything is on the user mix's timeline: when the result holds a reliable alignment,
+ * reference values are shifted by the offset so both tracks are compared at the same
+ * point in the music.
  */
 class LoudnessToWaveformBridge {
 public:
@@ -30,6 +38,9 @@ public:
     
     juce::Array<LoudnessMarker> getLoudnessMarkers() const;
     
+    // Get the loudness markers between startTime and endTime (seconds), e.g. the visible range
+    juce::Array<LoudnessMarker> getLoudnessMarkers(float startTime, float endTime) const;
+    
     // Get width markers for the waveform display
     // Returns time positions and width values that can be overlaid on the waveform
     struct WidthMarker {
@@ -40,6 +51,9 @@ public:
     
     juce::Array<WidthMarker> getWidthMarkers() const;
     
+    // Get the width markers between startTime and endTime (seconds)
+    juce::Array<WidthMarker> getWidthMarkers(float startTime, float endTime) const;
+    
     // Get regions where loudness or width significantly differs between user and reference
     // These can be highlighted in the waveform display
     struct DifferenceRegion {
@@ -51,18 +65,39 @@ public:
     
     juce::Array<DifferenceRegion> getDifferenceRegions() const;
 
+    // Set the differences that count as significant: loudness in LU, width in percent.
+    // Regions must last at least minRegionLength seconds
+    void setDifferenceThresholds(float loudnessThreshold, float widthThreshold, float minRegionLength);
+    
 private:
-    ComparisonResult currentResult;
     ComparisonResult::StemType currentStemType = ComparisonResult::StemType::FullMix;
     
-    // Mock data for demonstration purposes
-    // In a real implementation, this would be derived from actual analysis
-    juce::Array<LoudnessMarker> mockLoudnessMarkers;
-    juce::Array<WidthMarker> mockWidthMarkers;
-    juce::Array<DifferenceRegion> mockDifferenceRegions;
+    // User and reference time series of every stem in the current result
+    std::map<ComparisonResult::StemType, std::pair<ComparisonResult::TimeSeries, ComparisonResult::TimeSeries>> timeSeries;
+    
+    // Reference time minus user time for the same material; 0 if the alignment is unreliable
+    double referenceOffset = 0.0;
+    
+    // Markers and regions of one stem, in time order
+    struct StemMarkers {
+        juce::Array<LoudnessMarker> loudnessMarkers;
+        juce::Array<WidthMarker> widthMarkers;
+        juce::Array<DifferenceRegion> differenceRegions;
+    };
+    
+    // Built on first use per stem; cleared when the result or thresholds change
+    mutable std::map<ComparisonResult::StemType, StemMarkers> markerCache;
+    
+    float loudnessThreshold = 2.0f;
+    float widthThreshold = 15.0f;
+    float minRegionLength = 2.0f;
     
-    // Helper method to generate mock data
-    void generateMockData();
+    // Helper methods
+    const StemMarkers& getCurrentMarkers() const;
+    void buildMarkers(ComparisonResult::StemType stemType, StemMarkers& markers) const;
+    void findDifferenceRegions(const std::vector<float>& userValues, const std::vector<float>& referenceValues,
+                               float interval, float threshold, bool isLoudness,
+                               juce::Array<DifferenceRegion>& regions) const;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessToWaveformBridge)
 };
@@ -1,4 +1,5 @@
 #include "LoudnessWidthAnalyzer.h"
+#include "ParallelJobs.h"
 
 namespace ForensEQ {
 
@@ -19,59 +20,14 @@ ComparisonResult LoudnessWidthAnalyzer::analyzeAndCompare(
 {
     ComparisonResult result;
     
-    // Analyze full mix
-    float userIntegratedLUFS, userShortTermLUFS, userMomentaryLUFS, userRMS;
-    float userCorrelation, userMidSideRatio;
-    
-    float refIntegratedLUFS, refShortTermLUFS, refMomentaryLUFS, refRMS;
-    float refCorrelation, refMidSideRatio;
-    
-    // Analyze user mix
-    analyzeSingleTrack(
-        userMix,
-        userIntegratedLUFS,
-        userShortTermLUFS,
-        userMomentaryLUFS,
-        userRMS,
-        userCorrelation,
-        userMidSideRatio,
-        sampleRate
-    );
-    
-    // Analyze reference mix
-    analyzeSingleTrack(
-        referenceMix,
-        refIntegratedLUFS,
-        refShortTermLUFS,
-        refMomentaryLUFS,
-        refRMS,
-        refCorrelation,
-        refMidSideRatio,
-        sampleRate
-    );
-    
-    // Store full mix results
-    result.setLoudnessValues(
-        ComparisonResult::StemType::FullMix,
-        userIntegratedLUFS,
-        refIntegratedLUFS,
-        userShortTermLUFS,
-        refShortTermLUFS,
-        userMomentaryLUFS,
-        refMomentaryLUFS,
-        userRMS,
-        refRMS
-    );
+    // Collect the independent analyses: the full mixes, then every stem present on both sides
+    std::vector<TrackAnalysis> tracks;
+    std::vector<ComparisonResult::StemType> stemTypes;
+    tracks.reserve(12);
     
-    result.setWidthValues(
-        ComparisonResult::StemType::FullMix,
-        userCorrelation,
-        refCorrelation,
-        userMidSideRatio,
-        refMidSideRatio
-    );
+    tracks.push_back({ &userMix, false });
+    tracks.push_back({ &referenceMix, true });
     
-    // Analyze each stem
     for (int i = 1; i < 6; ++i) // Skip FullMix (0)
     {
         ComparisonResult::StemType stemType = static_cast<ComparisonResult::StemType>(i);
@@ -82,54 +38,109 @@ ComparisonResult LoudnessWidthAnalyzer::analyzeAndCompare(
         
         if (userStemIt != userStems.end() && refStemIt != referenceStems.end())
         {
-            // Analyze user stem
-            analyzeSingleTrack(
-                userStemIt->second,
-                userIntegratedLUFS,
-                userShortTermLUFS,
-                userMomentaryLUFS,
-                userRMS,
-                userCorrelation,
-                userMidSideRatio,
-                sampleRate
-            );
+            stemTypes.push_back(stemType);
+            tracks.push_back({ &userStemIt->second, false });
+            tracks.push_back({ &refStemIt->second, true });
+        }
+    }
+    
+    analyzeTracks(tracks, sampleRate);
+    
+    // Store results in the same order as the analyses were listed
+    storeTrackPair(result, ComparisonResult::StemType::FullMix, tracks[0], tracks[1]);
+    
+    for (size_t i = 0; i < stemTypes.size(); ++i)
+        storeTrackPair(result, stemTypes[i], tracks[2 + i * 2], tracks[3 + i * 2]);
+    
+    // Stems share the timeline of their mix, so one offset serves them all. The reference was
+    // hashed for the reference cache already, and its key is reused for the aligner's cache
+    const auto alignment = alignTracks(userMix, referenceMix, sampleRate, tracks[1].cacheKey);
+    result.setAlignment(alignment.offsetSeconds, alignment.confidence);
+    
+    return result;
+}
+
+TrackAligner::Alignment LoudnessWidthAnalyzer::alignTracks(
+    const juce::AudioBuffer<float>& userMix,
+    const juce::AudioBuffer<float>& referenceMix,
+    double sampleRate,
+    const juce::String& referenceKey)
+{
+    return trackAligner.align(userMix, referenceMix, sampleRate, referenceKey);
+}
+
+void LoudnessWidthAnalyzer::analyzeTracks(std::vector<TrackAnalysis>& tracks, double sampleRate)
+{
+    const int numTracks = static_cast<int>(tracks.size());
+    std::atomic<int> nextTrack { 0 };
+    
+    // Each worker (and the calling thread) claims the next unanalyzed track until none remain.
+    // Every track writes only to its own slot, so the outcome does not depend on scheduling
+    auto analyzeRemainingTracks = [this, &tracks, &nextTrack, numTracks, sampleRate]
+    {
+        for (int i = nextTrack.fetch_add(1); i < numTracks; i = nextTrack.fetch_add(1))
+        {
+            TrackAnalysis& track = tracks[static_cast<size_t>(i)];
+            auto& metrics = track.metrics;
             
-            // Analyze reference stem
-            analyzeSingleTrack(
-                refStemIt->second,
-                refIntegratedLUFS,
-                refShortTermLUFS,
-                refMomentaryLUFS,
-                refRMS,
-                refCorrelation,
-                refMidSideRatio,
-                sampleRate
-            );
+            // A known reference only costs a hash of its samples
+            if (track.isReference)
+            {
+                track.cacheKey = ReferenceAnalysisCache::createKey(*track.buffer, sampleRate);
+                
+                if (referenceCache.lookup(track.cacheKey, metrics))
+                    continue;
+            }
             
-            // Store stem results
-            result.setLoudnessValues(
-                stemType,
-                userIntegratedLUFS,
-                refIntegratedLUFS,
-                userShortTermLUFS,
-                refShortTermLUFS,
-                userMomentaryLUFS,
-                refMomentaryLUFS,
-                userRMS,
-                refRMS
-            );
+            analyzeBuffer(*track.buffer, sampleRate, metrics);
             
-            result.setWidthValues(
-                stemType,
-                userCorrelation,
-                refCorrelation,
-                userMidSideRatio,
-                refMidSideRatio
-            );
+            if (track.isReference)
+                referenceCache.store(track.cacheKey, metrics);
         }
-    }
+    };
     
-    return result;
+    // The calling thread and helpers in the shared pool take tracks until none are left
+    ParallelJobs::run(*threadPool, "Loudness/Width Analysis", numTracks - 1, analyzeRemainingTracks);
+}
+
+void LoudnessWidthAnalyzer::storeTrackPair(ComparisonResult& result, ComparisonResult::StemType stemType,
+                                           const TrackAnalysis& user, const TrackAnalysis& reference)
+{
+    const auto& userMetrics = user.metrics;
+    const auto& refMetrics = reference.metrics;
+    
+    result.setLoudnessValues(
+        stemType,
+        userMetrics.integratedLUFS,
+        refMetrics.integratedLUFS,
+        userMetrics.shortTermLUFS,
+        refMetrics.shortTermLUFS,
+        userMetrics.momentaryLUFS,
+        refMetrics.momentaryLUFS,
+        userMetrics.rms,
+        refMetrics.rms
+    );
+            
+    result.setTruePeakValues(stemType, userMetrics.truePeak, refMetrics.truePeak);
+            
+    result.setWidthValues(
+        stemType,
+        userMetrics.correlation,
+        refMetrics.correlation,
+        userMetrics.midSideRatio,
+        refMetrics.midSideRatio
+    );
+    
+    auto toTimeSeries = [](const ReferenceAnalysisCache::TrackMetrics& metrics)
+    {
+        ComparisonResult::TimeSeries series;
+        series.interval = metrics.seriesInterval;
+        series.loudness = metrics.loudnessSeries;
+        series.width = metrics.widthSeries;
+        return series;
+    };
+    
+    result.setTimeSeries(stemType, toTimeSeries(userMetrics), toTimeSeries(refMetrics));
 }
 
 void LoudnessWidthAnalyzer::analyzeSingleTrack(
@@ -138,45 +149,260 @@ void LoudnessWidthAnalyzer::analyzeSingleTrack(
     float& shortTermLUFS,
     float& momentaryLUFS,
     float& rms,
+    float& truePeak,
     float& correlation,
     float& midSideRatio,
     double sampleRate)
 {
-    // Calculate loudness metrics
-    integratedLUFS = loudnessAnalyzer.calculateLoudness(
-        buffer, 
-        LoudnessAnalyzer::LoudnessType::Integrated, 
-        sampleRate
-    );
+    ReferenceAnalysisCache::TrackMetrics metrics;
+    analyzeBuffer(buffer, sampleRate, metrics);
     
-    shortTermLUFS = loudnessAnalyzer.calculateLoudness(
-        buffer, 
-        LoudnessAnalyzer::LoudnessType::ShortTerm, 
-        sampleRate
-    );
+    integratedLUFS = metrics.integratedLUFS;
+    shortTermLUFS = metrics.shortTermLUFS;
+    momentaryLUFS = metrics.momentaryLUFS;
+    rms = metrics.rms;
+    truePeak = metrics.truePeak;
+    correlation = metrics.correlation;
+    midSideRatio = metrics.midSideRatio;
+}
     
-    momentaryLUFS = loudnessAnalyzer.calculateLoudness(
-        buffer, 
-        LoudnessAnalyzer::LoudnessType::Momentary, 
-        sampleRate
-    );
+void LoudnessWidthAnalyzer::analyzeBuffer(const juce::AudioBuffer<float>& buffer, double sampleRate,
+                                          ReferenceAnalysisCache::TrackMetrics& metrics)
+{
+    // A local accumulator so concurrent calls never share state
+    TrackAccumulator accumulator(sampleRate, buffer.getNumChannels());
+    accumulator.process(buffer, 0, buffer.getNumSamples());
+    accumulator.getMetrics(metrics);
+}
     
-    rms = loudnessAnalyzer.calculateLoudness(
-        buffer, 
-        LoudnessAnalyzer::LoudnessType::RMS, 
-        sampleRate
-    );
+bool LoudnessWidthAnalyzer::analyzeFile(const juce::File& audioFile, ReferenceAnalysisCache::TrackMetrics& metrics)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
     
-    // Calculate width metrics
-    correlation = stereoWidthAnalyzer.calculateWidth(
-        buffer, 
-        StereoWidthAnalyzer::WidthType::Correlation
-    );
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
     
-    midSideRatio = stereoWidthAnalyzer.calculateWidth(
-        buffer, 
-        StereoWidthAnalyzer::WidthType::MidSideRatio
-    );
+    if (reader == nullptr)
+        return false;
+    
+    const int numChannels = static_cast<int>(reader->numChannels);
+    TrackAccumulator accumulator(reader->sampleRate, numChannels);
+    juce::AudioBuffer<float> block(numChannels, fileBlockSize);
+    
+    // 64-bit positions, so files longer than 2^31 samples are read in full
+    for (juce::int64 position = 0; position < reader->lengthInSamples; position += fileBlockSize)
+    {
+        const int numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(fileBlockSize),
+                                                           reader->lengthInSamples - position));
+        
+        reader->read(&block, 0, numSamples, position, true, true);
+        accumulator.process(block, 0, numSamples);
+    }
+    
+    accumulator.getMetrics(metrics);
+    return true;
+}
+
+//==============================================================================
+LoudnessWidthAnalyzer::TrackAccumulator::TrackAccumulator(double sampleRate, int numChannels)
+    : sampleRate(sampleRate),
+      numChannels(numChannels),
+      intervalLength(juce::jmax(1, juce::roundToInt(seriesInterval * sampleRate))),
+      intervalSamplesRemaining(intervalLength)
+{
+    loudnessMeter.prepare(sampleRate, numChannels);
+    truePeakDetector.prepare(sampleRate, numChannels);
+}
+
+void LoudnessWidthAnalyzer::TrackAccumulator::process(const juce::AudioBuffer<float>& block, int startSample, int numSamples)
+{
+    // Single pass: each tile is read by every metric while it is still in cache,
+    // instead of streaming the whole buffer from memory once per metric. Tiles end at
+    // interval boundaries so each tile's sums belong to one time series interval
+    for (int offset = 0; offset < numSamples;)
+    {
+        const int tileStart = startSample + offset;
+        const int tileLength = juce::jmin(analysisTileSize, numSamples - offset, intervalSamplesRemaining);
+        
+        loudnessMeter.processBlock(block, tileStart, tileLength);
+        truePeakDetector.processBlock(block, tileStart, tileLength);
+        
+        TrackSums tileSums;
+        accumulateTile(block, tileStart, tileLength, tileSums);
+        sums.add(tileSums);
+        intervalSums.add(tileSums);
+        
+        offset += tileLength;
+        numSamplesProcessed += tileLength;
+        intervalSamplesRemaining -= tileLength;
+        
+        if (intervalSamplesRemaining == 0)
+            finishInterval();
+    }
+}
+
+void LoudnessWidthAnalyzer::TrackAccumulator::finishInterval()
+{
+    loudnessSeries.push_back(getIntervalLoudness());
+    widthSeries.push_back(getIntervalWidth());
+    
+    intervalSums = TrackSums();
+    intervalSamplesRemaining = intervalLength;
+}
+
+float LoudnessWidthAnalyzer::TrackAccumulator::getIntervalLoudness() const
+{
+    // Short-term loudness needs 3 s of audio; the momentary (400 ms) value stands in until then
+    if (numSamplesProcessed < static_cast<juce::int64>(3.0 * sampleRate))
+        return loudnessMeter.getMomentaryLoudness();
+    
+    return loudnessMeter.getShortTermLoudness();
+}
+
+float LoudnessWidthAnalyzer::TrackAccumulator::getIntervalWidth() const
+{
+    const int intervalSamples = intervalLength - intervalSamplesRemaining;
+    
+    if (numChannels < 2 || intervalSamples == 0)
+        return 0.0f;
+    
+    const float correlation = StereoWidthAnalyzer::correlationFromSums(
+        intervalSamples, intervalSums.sumLeft, intervalSums.sumRight,
+        intervalSums.sumLeftSquared, intervalSums.sumRightSquared, intervalSums.sumLeftRight);
+    
+    return StereoWidthAnalyzer::correlationToPercentage(correlation);
+}
+
+void LoudnessWidthAnalyzer::TrackAccumulator::getMetrics(ReferenceAnalysisCache::TrackMetrics& metrics) const
+{
+    // Loudness metrics
+    if (numSamplesProcessed == 0)
+    {
+        metrics.integratedLUFS = metrics.shortTermLUFS = metrics.momentaryLUFS = StreamingLoudnessMeter::silenceLUFS;
+        metrics.truePeak = TruePeakDetector::silenceDb;
+    }
+    else
+    {
+        metrics.integratedLUFS = loudnessMeter.getIntegratedLoudness();
+        metrics.shortTermLUFS = loudnessMeter.getMaxShortTermLoudness();
+        metrics.momentaryLUFS = loudnessMeter.getMaxMomentaryLoudness();
+        metrics.truePeak = truePeakDetector.getTruePeakDb();
+    }
+    
+    // Time series, including a final partial interval
+    metrics.seriesInterval = seriesInterval;
+    metrics.loudnessSeries = loudnessSeries;
+    metrics.widthSeries = widthSeries;
+    
+    if (intervalSamplesRemaining < intervalLength)
+    {
+        metrics.loudnessSeries.push_back(getIntervalLoudness());
+        metrics.widthSeries.push_back(getIntervalWidth());
+    }
+    
+    metrics.rms = LoudnessAnalyzer::rmsFromSumOfSquares(sums.sumSquares, static_cast<double>(numSamplesProcessed) * numChannels);
+    
+    // Width metrics (same conventions as StereoWidthAnalyzer for mono/empty buffers)
+    if (numChannels < 2 || numSamplesProcessed == 0)
+    {
+        metrics.correlation = 1.0f;
+        metrics.midSideRatio = 0.0f;
+        return;
+    }
+    
+    const double n = static_cast<double>(numSamplesProcessed);
+    
+    metrics.correlation = StereoWidthAnalyzer::correlationFromSums(
+        n, sums.sumLeft, sums.sumRight, sums.sumLeftSquared, sums.sumRightSquared, sums.sumLeftRight);
+    
+    // mid = (L + R) / 2 and side = (L - R) / 2, so their energies follow from the L/R sums
+    const double crossTerm = 2.0 * sums.sumLeftRight;
+    const double sumMidSquared = 0.25 * (sums.sumLeftSquared + crossTerm + sums.sumRightSquared);
+    const double sumSideSquared = juce::jmax(0.0, 0.25 * (sums.sumLeftSquared - crossTerm + sums.sumRightSquared));
+    
+    metrics.midSideRatio = StereoWidthAnalyzer::midSideRatioFromSums(n, sumMidSquared, sumSideSquared);
+}
+
+void LoudnessWidthAnalyzer::TrackSums::add(const TrackSums& other)
+{
+    sumSquares += other.sumSquares;
+    sumLeft += other.sumLeft;
+    sumRight += other.sumRight;
+    sumLeftSquared += other.sumLeftSquared;
+    sumRightSquared += other.sumRightSquared;
+    sumLeftRight += other.sumLeftRight;
+}
+
+void LoudnessWidthAnalyzer::accumulateTile(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples, TrackSums& sums)
+{
+    // Independent float lanes let the compiler vectorize the reductions; each tile's
+    // lanes are folded into double totals so precision holds over long files
+    constexpr int numLanes = 8;
+    const int numChannels = buffer.getNumChannels();
+    const int vectorisedLength = numSamples - (numSamples % numLanes);
+    
+    if (numChannels >= 2)
+    {
+        const float* left = buffer.getReadPointer(0, startSample);
+        const float* right = buffer.getReadPointer(1, startSample);
+        
+        float laneLeft[numLanes] = {};
+        float laneRight[numLanes] = {};
+        float laneLeftSquared[numLanes] = {};
+        float laneRightSquared[numLanes] = {};
+        float laneLeftRight[numLanes] = {};
+        
+        for (int i = 0; i < vectorisedLength; i += numLanes)
+        {
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                const float l = left[i + lane];
+                const float r = right[i + lane];
+                
+                laneLeft[lane] += l;
+                laneRight[lane] += r;
+                laneLeftSquared[lane] += l * l;
+                laneRightSquared[lane] += r * r;
+                laneLeftRight[lane] += l * r;
+            }
+        }
+        
+        for (int i = vectorisedLength; i < numSamples; ++i)
+        {
+            laneLeft[0] += left[i];
+            laneRight[0] += right[i];
+            laneLeftSquared[0] += left[i] * left[i];
+            laneRightSquared[0] += right[i] * right[i];
+            laneLeftRight[0] += left[i] * right[i];
+        }
+        
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            sums.sumLeft += laneLeft[lane];
+            sums.sumRight += laneRight[lane];
+            sums.sumLeftSquared += laneLeftSquared[lane];
+            sums.sumRightSquared += laneRightSquared[lane];
+            sums.sumLeftRight += laneLeftRight[lane];
+            sums.sumSquares += static_cast<double>(laneLeftSquared[lane]) + laneRightSquared[lane];
+        }
+    }
+    
+    // Remaining channels (or the only channel of a mono buffer) only contribute to RMS
+    for (int channel = numChannels >= 2 ? 2 : 0; channel < numChannels; ++channel)
+    {
+        const float* data = buffer.getReadPointer(channel, startSample);
+        float laneSquares[numLanes] = {};
+        
+        for (int i = 0; i < vectorisedLength; i += numLanes)
+            for (int lane = 0; lane < numLanes; ++lane)
+                laneSquares[lane] += data[i + lane] * data[i + lane];
+        
+        for (int i = vectorisedLength; i < numSamples; ++i)
+            laneSquares[0] += data[i] * data[i];
+        
+        for (int lane = 0; lane < numLanes; ++lane)
+            sums.sumSquares += laneSquares[lane];
+    }
 }
 
 } // namespace ForensEQ
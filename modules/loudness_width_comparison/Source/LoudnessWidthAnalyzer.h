@@ -4,6 +4,8 @@
 #include "LoudnessAnalyzer.h"
 #include "StereoWidthAnalyzer.h"
 #include "ComparisonResult.h"
+#include "ReferenceAnalysisCache.h"
+#include "TrackAligner.h"
 
 namespace ForensEQ {
 
@@ -15,7 +17,10 @@ public:
     LoudnessWidthAnalyzer();
     ~LoudnessWidthAnalyzer();
     
-    // Analyze a user mix and reference track, comparing all stems
+    // Analyze a user mix and reference track, comparing all stems. The independent track
+    // analyses run in parallel on the shared analysis pool; the result is identical to a
+    // serial run. Reference-side results are served from the reference cache when known.
+    // The full mixes are aligned first and the offset is stored in the result
     ComparisonResult analyzeAndCompare(
         const juce::AudioBuffer<float>& userMix,
         const juce::AudioBuffer<float>& referenceMix,
@@ -23,26 +28,128 @@ public:
         const std::map<ComparisonResult::StemType, juce::AudioBuffer<float>>& referenceStems,
         double sampleRate = 44100.0);
     
-    // Analyze a single audio buffer for loudness and width
+    // Analyze a single audio buffer for loudness and width in one tiled pass over the audio.
+    // Safe to call concurrently for different buffers. analyzeFile() and analyzeAndCompare()
+    // also record the loudness and width over time
     void analyzeSingleTrack(
         const juce::AudioBuffer<float>& buffer,
         float& integratedLUFS,
         float& shortTermLUFS,
         float& momentaryLUFS,
         float& rms,
+        float& truePeak,
         float& correlation,
         float& midSideRatio,
         double sampleRate = 44100.0);
     
+    // Analyze a whole audio file for loudness and width by streaming it in blocks, so
+    // memory use does not depend on its length. Returns false if it cannot be decoded
+    bool analyzeFile(const juce::File& audioFile, ReferenceAnalysisCache::TrackMetrics& metrics);
+    
+    // Find the time offset between a user mix and a reference, so that time-resolved
+    // comparisons line up. The reference's onset envelope is cached under referenceKey
+    // (see ReferenceAnalysisCache::createKey()) when one is given
+    TrackAligner::Alignment alignTracks(
+        const juce::AudioBuffer<float>& userMix,
+        const juce::AudioBuffer<float>& referenceMix,
+        double sampleRate = 44100.0,
+        const juce::String& referenceKey = {});
+    
     // Get the loudness analyzer
     LoudnessAnalyzer& getLoudnessAnalyzer() { return loudnessAnalyzer; }
     
     // Get the stereo width analyzer
     StereoWidthAnalyzer& getStereoWidthAnalyzer() { return stereoWidthAnalyzer; }
 
+    // Get the cache of reference-side analysis results
+    ReferenceAnalysisCache& getReferenceCache() { return referenceCache; }
+    
+    // Get the track aligner
+    TrackAligner& getTrackAligner() { return trackAligner; }
+
 private:
     LoudnessAnalyzer loudnessAnalyzer;
     StereoWidthAnalyzer stereoWidthAnalyzer;
+    ReferenceAnalysisCache referenceCache;
+    TrackAligner trackAligner;
+    
+    // Process-wide worker pool, kept alive while any analyzer exists
+    juce::SharedResourcePointer<juce::ThreadPool> threadPool;
+    
+    // One independent track analysis and its outputs
+    struct TrackAnalysis {
+        const juce::AudioBuffer<float>* buffer = nullptr;
+        bool isReference = false; // reference tracks go through the cache
+        juce::String cacheKey;    // content key of a reference track
+        ReferenceAnalysisCache::TrackMetrics metrics;
+    };
+    
+    // Run all analyses, fanning out over the shared thread pool, and return when all are done
+    void analyzeTracks(std::vector<TrackAnalysis>& tracks, double sampleRate);
+    
+    // Store a user/reference pair of analyses in the result
+    static void storeTrackPair(ComparisonResult& result, ComparisonResult::StemType stemType,
+                               const TrackAnalysis& user, const TrackAnalysis& reference);
+    
+    // Raw sums gathered by the fused pass
+    struct TrackSums {
+        double sumSquares = 0.0;      // all channels, for RMS
+        double sumLeft = 0.0;
+        double sumRight = 0.0;
+        double sumLeftSquared = 0.0;
+        double sumRightSquared = 0.0;
+        double sumLeftRight = 0.0;
+        
+        void add(const TrackSums& other);
+    };
+    
+    // Analyze a whole buffer, including its time series
+    static void analyzeBuffer(const juce::AudioBuffer<float>& buffer, double sampleRate,
+                              ReferenceAnalysisCache::TrackMetrics& metrics);
+    
+    // Accumulate the sums for one tile of the buffer
+    static void accumulateTile(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples, TrackSums& sums);
+    
+    // Fused analysis state for one track, fed with audio in blocks of any size
+    class TrackAccumulator {
+    public:
+        TrackAccumulator(double sampleRate, int numChannels);
+        
+        // Feed the next numSamples samples of block, starting at startSample
+        void process(const juce::AudioBuffer<float>& block, int startSample, int numSamples);
+        
+        // Get the metrics and time series for all audio fed so far
+        void getMetrics(ReferenceAnalysisCache::TrackMetrics& metrics) const;
+        
+    private:
+        double sampleRate;
+        int numChannels;
+        juce::int64 numSamplesProcessed = 0;
+        StreamingLoudnessMeter loudnessMeter;
+        TruePeakDetector truePeakDetector;
+        TrackSums sums;
+        
+        // Time series: sums for the current interval, and the values of completed intervals
+        int intervalLength;
+        int intervalSamplesRemaining;
+        TrackSums intervalSums;
+        std::vector<float> loudnessSeries;
+        std::vector<float> widthSeries;
+        
+        void finishInterval();
+        float getIntervalLoudness() const;
+        float getIntervalWidth() const;
+    };
+    
+    // Seconds per time series value
+    static constexpr float seriesInterval = 1.0f;
+    
+    // Samples per tile: small enough that a stereo tile stays in L1/L2 cache while
+    // every metric reads it
+    static constexpr int analysisTileSize = 4096;
+    
+    // Samples decoded at a time by analyzeFile()
+    static constexpr int fileBlockSize = 65536;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessWidthAnalyzer)
 };
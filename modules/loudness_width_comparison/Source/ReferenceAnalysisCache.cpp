@@ -0,0 +1,200 @@
+#include "ReferenceAnalysisCache.h"
+
+namespace ForensEQ {
+
+ReferenceAnalysisCache::ReferenceAnalysisCache()
+{
+    cacheDirectory = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                        .getChildFile("ForensEQ")
+                        .getChildFile("AnalysisCache")
+                        .getChildFile("LoudnessWidth");
+}
+
+ReferenceAnalysisCache::~ReferenceAnalysisCache()
+{
+}
+
+juce::String ReferenceAnalysisCache::createKey(const juce::AudioBuffer<float>& buffer, double sampleRate)
+{
+    // Hash each channel's samples, then hash the channel digests together with the
+    // format and analysis version so any of them changing gives a different key
+    juce::MemoryOutputStream keyData;
+    keyData.writeInt(analysisVersion);
+    keyData.writeDouble(sampleRate);
+    keyData.writeInt(buffer.getNumChannels());
+    keyData.writeInt(buffer.getNumSamples());
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        juce::MD5 channelHash(buffer.getReadPointer(channel),
+                              sizeof(float) * static_cast<size_t>(buffer.getNumSamples()));
+        keyData << channelHash.toHexString();
+    }
+
+    return juce::MD5(keyData.getData(), keyData.getDataSize()).toHexString();
+}
+
+bool ReferenceAnalysisCache::lookup(const juce::String& key, TrackMetrics& metrics)
+{
+    juce::File file;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        // Memory tier
+        auto it = memoryEntries.find(key);
+        if (it != memoryEntries.end())
+        {
+            metrics = it->second;
+
+            // Mark as most recently used
+            recentKeys.removeString(key);
+            recentKeys.add(key);
+            return true;
+        }
+
+        file = getFileForKey(key);
+    }
+
+    // Disk tier, read and parsed without holding the lock; only the insert takes it
+    if (file == juce::File() || !file.existsAsFile())
+        return false;
+
+    juce::var parsed = juce::JSON::parse(file);
+    if (!parsed.isObject() || static_cast<int>(parsed["Version"]) != analysisVersion)
+        return false;
+
+    TrackMetrics loaded;
+    loaded.integratedLUFS = static_cast<float>(parsed["IntegratedLUFS"]);
+    loaded.shortTermLUFS = static_cast<float>(parsed["ShortTermLUFS"]);
+    loaded.momentaryLUFS = static_cast<float>(parsed["MomentaryLUFS"]);
+    loaded.rms = static_cast<float>(parsed["RMS"]);
+    loaded.truePeak = static_cast<float>(parsed["TruePeak"]);
+    loaded.correlation = static_cast<float>(parsed["Correlation"]);
+    loaded.midSideRatio = static_cast<float>(parsed["MidSideRatio"]);
+    loaded.seriesInterval = static_cast<float>(parsed["SeriesInterval"]);
+
+    auto readSeries = [&parsed](const char* name, std::vector<float>& series)
+    {
+        if (auto* values = parsed[name].getArray())
+            for (const auto& value : *values)
+                series.push_back(static_cast<float>(value));
+    };
+
+    readSeries("LoudnessSeries", loaded.loudnessSeries);
+    readSeries("WidthSeries", loaded.widthSeries);
+
+    {
+        const juce::ScopedLock sl(lock);
+        addToMemory(key, loaded);
+    }
+
+    metrics = loaded;
+    return true;
+}
+
+void ReferenceAnalysisCache::store(const juce::String& key, const TrackMetrics& metrics)
+{
+    juce::File file;
+
+    {
+        // Only the memory tier is updated under the lock; the file is written after releasing it
+        const juce::ScopedLock sl(lock);
+        addToMemory(key, metrics);
+        file = getFileForKey(key);
+    }
+
+    if (file == juce::File() || !file.getParentDirectory().createDirectory())
+        return;
+
+    juce::DynamicObject::Ptr object = new juce::DynamicObject();
+    object->setProperty("Version", analysisVersion);
+    object->setProperty("IntegratedLUFS", metrics.integratedLUFS);
+    object->setProperty("ShortTermLUFS", metrics.shortTermLUFS);
+    object->setProperty("MomentaryLUFS", metrics.momentaryLUFS);
+    object->setProperty("RMS", metrics.rms);
+    object->setProperty("TruePeak", metrics.truePeak);
+    object->setProperty("Correlation", metrics.correlation);
+    object->setProperty("MidSideRatio", metrics.midSideRatio);
+    object->setProperty("SeriesInterval", metrics.seriesInterval);
+
+    auto writeSeries = [&object](const char* name, const std::vector<float>& series)
+    {
+        juce::Array<juce::var> values;
+        values.ensureStorageAllocated(static_cast<int>(series.size()));
+
+        for (float value : series)
+            values.add(value);
+
+        object->setProperty(name, values);
+    };
+
+    writeSeries("LoudnessSeries", metrics.loudnessSeries);
+    writeSeries("WidthSeries", metrics.widthSeries);
+
+    // replaceWithText writes via a temporary file, so readers never see a partial entry
+    file.replaceWithText(juce::JSON::toString(juce::var(object.get())));
+}
+
+void ReferenceAnalysisCache::setCacheDirectory(const juce::File& directory)
+{
+    const juce::ScopedLock sl(lock);
+    cacheDirectory = directory;
+}
+
+juce::File ReferenceAnalysisCache::getCacheDirectory() const
+{
+    const juce::ScopedLock sl(lock);
+    return cacheDirectory;
+}
+
+void ReferenceAnalysisCache::setMaxMemoryEntries(int maxEntries)
+{
+    const juce::ScopedLock sl(lock);
+    maxMemoryEntries = juce::jmax(1, maxEntries);
+
+    while (recentKeys.size() > maxMemoryEntries)
+    {
+        memoryEntries.erase(recentKeys[0]);
+        recentKeys.remove(0);
+    }
+}
+
+void ReferenceAnalysisCache::clear(bool includeDisk)
+{
+    const juce::ScopedLock sl(lock);
+
+    memoryEntries.clear();
+    recentKeys.clear();
+
+    if (includeDisk && cacheDirectory.isDirectory())
+    {
+        for (const auto& file : cacheDirectory.findChildFiles(juce::File::findFiles, false, "*.json"))
+            file.deleteFile();
+    }
+}
+
+void ReferenceAnalysisCache::addToMemory(const juce::String& key, const TrackMetrics& metrics)
+{
+    memoryEntries[key] = metrics;
+
+    recentKeys.removeString(key);
+    recentKeys.add(key);
+
+    // Evict the least recently used entries
+    while (recentKeys.size() > maxMemoryEntries)
+    {
+        memoryEntries.erase(recentKeys[0]);
+        recentKeys.remove(0);
+    }
+}
+
+juce::File ReferenceAnalysisCache::getFileForKey(const juce::String& key) const
+{
+    if (cacheDirectory == juce::File())
+        return {};
+
+    return cacheDirectory.getChildFile(key + ".json");
+}
+
+} // namespace ForensEQ
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for caching the loudness and width analysis of reference audio
+ *
+ * Entries are keyed by a hash of the audio content plus the sample rate and the analysis
+ * version, so the same reference is recognised however it was loaded and stale results
+ * are never reused after the analysis changes. Recently used entries are kept in memory;
+ * every entry is also written as a small JSON file so it survives restarts.
+ *
+ * All methods are thread-safe.
+ */
+class ReferenceAnalysisCache {
+public:
+    ReferenceAnalysisCache();
+    ~ReferenceAnalysisCache();
+
+    // The cached metrics for one track
+    struct TrackMetrics {
+        float integratedLUFS = -70.0f;
+        float shortTermLUFS = -70.0f;
+        float momentaryLUFS = -70.0f;
+        float rms = -70.0f;
+        float truePeak = -70.0f;
+        float correlation = 1.0f;
+        float midSideRatio = 0.0f;
+
+        // Loudness and width over time, one value per seriesInterval seconds
+        float seriesInterval = 1.0f;
+        std::vector<float> loudnessSeries; // short-term LUFS at the end of each interval
+        std::vector<float> widthSeries;    // width percentage over each interval
+    };
+
+    // Build the cache key for a buffer (reads every sample once)
+    static juce::String createKey(const juce::AudioBuffer<float>& buffer, double sampleRate);
+
+    // Look up an entry in memory, then on disk. Returns false on a miss
+    bool lookup(const juce::String& key, TrackMetrics& metrics);
+
+    // Store an entry in memory and on disk
+    void store(const juce::String& key, const TrackMetrics& metrics);
+
+    // Set/get the directory for the on-disk tier (an invalid File disables it)
+    void setCacheDirectory(const juce::File& directory);
+    juce::File getCacheDirectory() const;
+
+    // Set the number of entries kept in memory
+    void setMaxMemoryEntries(int maxEntries);
+
+    // Remove all entries from memory, and optionally from disk
+    void clear(bool includeDisk = false);
+
+    // Bump whenever the analysis changes in a way that alters its results
+    static constexpr int analysisVersion = 2;
+
+private:
+    // Memory tier, with keys ordered from least to most recently used
+    std::map<juce::String, TrackMetrics> memoryEntries;
+    juce::StringArray recentKeys;
+    int maxMemoryEntries = 64;
+
+    juce::File cacheDirectory;
+    juce::CriticalSection lock;
+
+    // Helper methods
+    void addToMemory(const juce::String& key, const TrackMetrics& metrics);
+    juce::File getFileForKey(const juce::String& key) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ReferenceAnalysisCache)
+};
+
+} // namespace ForensEQ
@@ -218,7 +218,14 @@ float StereoWidthAnalyzer::calculateCorrelation(const juce::AudioBuffer<float>&
         sumLeftRight += left * right;
     }
     
-    double n = static_cast<double>(buffer.getNumSamples());
+    return correlationFromSums(static_cast<double>(buffer.getNumSamples()),
+                               sumLeft, sumRight, sumLeftSquared, sumRightSquared, sumLeftRight);
+}
+
+float StereoWidthAnalyzer::correlationFromSums(double numSamples, double sumLeft, double sumRight,
+                                               double sumLeftSquared, double sumRightSquared, double sumLeftRight)
+{
+    double n = numSamples;
     double numerator = n * sumLeftRight - sumLeft * sumRight;
     double denominator = std::sqrt((n * sumLeftSquared - sumLeft * sumLeft) * 
                                   (n * sumRightSquared - sumRight * sumRight));
@@ -246,6 +253,22 @@ float StereoWidthAnalyzer::calculateMidSideRatio(const juce::AudioBuffer<float>&
     return sideLevel / midLevel;
 }
 
+float StereoWidthAnalyzer::midSideRatioFromSums(double numSamples, double sumMidSquared, double sumSideSquared)
+{
+    if (numSamples <= 0.0)
+        return 0.0f; // Mono
+    
+    // Same RMS levels as calculateMidSide
+    float midLevel = static_cast<float>(std::sqrt(sumMidSquared / numSamples));
+    float sideLevel = static_cast<float>(std::sqrt(sumSideSquared / numSamples));
+    
+    if (midLevel < 1.0e-6f)
+        return 10.0f; // Avoid division by zero, assume very wide
+    
+    // Ratio of side level to mid level
+    return sideLevel / midLevel;
+}
+
 void StereoWidthAnalyzer::calculateMidSide(const juce::AudioBuffer<float>& buffer, 
                                          float& midLevel, 
                                          float& sideLevel)
@@ -39,10 +39,17 @@ public:
                                   WidthType type);
     
     // Convert correlation coefficient to percentage width (0-100%)
-    float correlationToPercentage(float correlation);
+    static float correlationToPercentage(float correlation);
     
     // Convert mid/side ratio to percentage width (0-100%)
     float midSideRatioToPercentage(float ratio);
+    
+    // Pearson correlation of left/right from accumulated sums over numSamples samples
+    static float correlationFromSums(double numSamples, double sumLeft, double sumRight,
+                                     double sumLeftSquared, double sumRightSquared, double sumLeftRight);
+    
+    // Side/mid RMS ratio from accumulated mid and side energy
+    static float midSideRatioFromSums(double numSamples, double sumMidSquared, double sumSideSquared);
 
 private:
     // Internal implementation methods
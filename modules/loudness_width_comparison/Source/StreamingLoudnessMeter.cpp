@@ -0,0 +1,303 @@
+#include "StreamingLoudnessMeter.h"
+
+namespace ForensEQ {
+
+StreamingLoudnessMeter::StreamingLoudnessMeter()
+{
+    prepare(sampleRate, 2);
+}
+
+StreamingLoudnessMeter::~StreamingLoudnessMeter()
+{
+}
+
+void StreamingLoudnessMeter::prepare(double newSampleRate, int newNumChannels)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    numChannels = juce::jmax(0, newNumChannels);
+    hopLength = juce::jmax(1, juce::roundToInt(sampleRate * 0.1));
+
+    shelfFilters.assign(static_cast<size_t>(numChannels), Biquad());
+    highPassFilters.assign(static_cast<size_t>(numChannels), Biquad());
+
+    // BS.1770-4 channel weights: LFE is excluded and surrounds are weighted +1.5 dB,
+    // assuming the usual L R C LFE Ls Rs (or L R C Ls Rs) ordering
+    channelWeights.assign(static_cast<size_t>(numChannels), 1.0);
+
+    if (numChannels == 6)
+    {
+        channelWeights[3] = 0.0;
+        channelWeights[4] = 1.41;
+        channelWeights[5] = 1.41;
+    }
+    else if (numChannels == 5)
+    {
+        channelWeights[3] = 1.41;
+        channelWeights[4] = 1.41;
+    }
+
+    designFilters();
+    reset();
+}
+
+void StreamingLoudnessMeter::reset()
+{
+    for (auto& filter : shelfFilters)
+        filter.z1 = filter.z2 = 0.0;
+
+    for (auto& filter : highPassFilters)
+        filter.z1 = filter.z2 = 0.0;
+
+    hopEnergySum = 0.0;
+    hopSamplesRemaining = hopLength;
+
+    hopEnergies.fill(0.0);
+    hopIndex = 0;
+    numHopsProcessed = 0;
+    momentarySum = 0.0;
+    shortTermSum = 0.0;
+
+    momentaryLoudness.store(silenceLUFS);
+    shortTermLoudness.store(silenceLUFS);
+    maxMomentaryLoudness = silenceLUFS;
+    maxShortTermLoudness = silenceLUFS;
+
+    momentaryHistogram.clear();
+    shortTermHistogram.clear();
+}
+
+void StreamingLoudnessMeter::processBlock(const juce::AudioBuffer<float>& buffer) noexcept
+{
+    processBlock(buffer, 0, buffer.getNumSamples());
+}
+
+void StreamingLoudnessMeter::processBlock(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept
+{
+    const int channelsToProcess = juce::jmin(numChannels, buffer.getNumChannels());
+
+    while (numSamples > 0)
+    {
+        // Never run past the end of the current 100 ms hop
+        const int chunkLength = juce::jmin(numSamples, hopSamplesRemaining);
+
+        for (int channel = 0; channel < channelsToProcess; ++channel)
+        {
+            const float* channelData = buffer.getReadPointer(channel, startSample);
+            Biquad& shelf = shelfFilters[static_cast<size_t>(channel)];
+            Biquad& highPass = highPassFilters[static_cast<size_t>(channel)];
+
+            double sum = 0.0;
+            for (int i = 0; i < chunkLength; ++i)
+            {
+                const double weighted = highPass.process(shelf.process(channelData[i]));
+                sum += weighted * weighted;
+            }
+
+            hopEnergySum += channelWeights[static_cast<size_t>(channel)] * sum;
+        }
+
+        startSample += chunkLength;
+        numSamples -= chunkLength;
+        hopSamplesRemaining -= chunkLength;
+
+        if (hopSamplesRemaining == 0)
+            finishHop();
+    }
+}
+
+float StreamingLoudnessMeter::getIntegratedLoudness() const
+{
+    if (momentaryHistogram.isEmpty())
+        return silenceLUFS;
+
+    // Absolute gate at -70 LUFS (blocks below it never enter the histogram),
+    // then a relative gate 10 LU below the absolutely gated loudness
+    const float absoluteGatedLoudness = momentaryHistogram.getGatedLoudness(silenceLUFS);
+    return momentaryHistogram.getGatedLoudness(absoluteGatedLoudness - 10.0f);
+}
+
+float StreamingLoudnessMeter::getLoudnessRange() const
+{
+    if (shortTermHistogram.isEmpty())
+        return 0.0f;
+
+    // EBU Tech 3342: relative gate 20 LU below the absolutely gated short-term loudness,
+    // then the spread between the 10th and 95th percentiles
+    const float relativeGate = shortTermHistogram.getGatedLoudness(silenceLUFS) - 20.0f;
+
+    return shortTermHistogram.getPercentile(relativeGate, 0.95)
+         - shortTermHistogram.getPercentile(relativeGate, 0.10);
+}
+
+void StreamingLoudnessMeter::designFilters()
+{
+    // K-weighting stage 1: high shelf modelling the acoustic effect of the head.
+    // Designed from the analog prototype so it is correct at any sample rate
+    // (matches the BS.1770 coefficient table exactly at 48 kHz)
+    Biquad shelf;
+    {
+        const double f0 = 1681.974450955533;
+        const double gainDb = 3.999843853973347;
+        const double q = 0.7071752369554196;
+
+        const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gainDb / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    // K-weighting stage 2: RLB high-pass
+    Biquad highPass;
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+
+        const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+
+        highPass.b0 = 1.0;
+        highPass.b1 = -2.0;
+        highPass.b2 = 1.0;
+        highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    std::fill(shelfFilters.begin(), shelfFilters.end(), shelf);
+    std::fill(highPassFilters.begin(), highPassFilters.end(), highPass);
+}
+
+void StreamingLoudnessMeter::finishHop() noexcept
+{
+    const double hopEnergy = hopEnergySum / static_cast<double>(hopLength);
+    hopEnergySum = 0.0;
+    hopSamplesRemaining = hopLength;
+
+    // Slide both windows by one hop: add the new hop, drop the one leaving each window.
+    // Unfilled ring entries are zero, so the first windows need no special casing
+    const int momentaryDropIndex = (hopIndex + hopsPerShortTerm - hopsPerMomentary) % hopsPerShortTerm;
+    momentarySum += hopEnergy - hopEnergies[static_cast<size_t>(momentaryDropIndex)];
+    shortTermSum += hopEnergy - hopEnergies[static_cast<size_t>(hopIndex)];
+
+    hopEnergies[static_cast<size_t>(hopIndex)] = hopEnergy;
+    hopIndex = (hopIndex + 1) % hopsPerShortTerm;
+    ++numHopsProcessed;
+
+    // Re-sum once per ring cycle so rounding error in the running sums cannot accumulate
+    if (hopIndex == 0)
+    {
+        shortTermSum = 0.0;
+        for (double energy : hopEnergies)
+            shortTermSum += energy;
+
+        momentarySum = 0.0;
+        for (int i = hopsPerShortTerm - hopsPerMomentary; i < hopsPerShortTerm; ++i)
+            momentarySum += hopEnergies[static_cast<size_t>(i)];
+    }
+
+    // 400 ms gating block (75% overlap)
+    if (numHopsProcessed >= hopsPerMomentary)
+    {
+        const double energy = juce::jmax(0.0, momentarySum) / hopsPerMomentary;
+        const float loudness = energyToLoudness(energy);
+
+        momentaryLoudness.store(loudness, std::memory_order_relaxed);
+        maxMomentaryLoudness = juce::jmax(maxMomentaryLoudness, loudness);
+
+        if (loudness > silenceLUFS)
+            momentaryHistogram.add(energy, loudness);
+    }
+
+    // 3 s short-term block, 10 Hz update rate
+    if (numHopsProcessed >= hopsPerShortTerm)
+    {
+        const double energy = juce::jmax(0.0, shortTermSum) / hopsPerShortTerm;
+        const float loudness = energyToLoudness(energy);
+
+        shortTermLoudness.store(loudness, std::memory_order_relaxed);
+        maxShortTermLoudness = juce::jmax(maxShortTermLoudness, loudness);
+
+        if (loudness > silenceLUFS)
+            shortTermHistogram.add(energy, loudness);
+    }
+}
+
+float StreamingLoudnessMeter::energyToLoudness(double energy)
+{
+    if (energy <= 0.0)
+        return silenceLUFS;
+
+    return juce::jmax(silenceLUFS, static_cast<float>(-0.691 + 10.0 * std::log10(energy)));
+}
+
+//==============================================================================
+void StreamingLoudnessMeter::GatingHistogram::clear()
+{
+    counts.fill(0);
+    energies.fill(0.0);
+    totalCount = 0;
+}
+
+void StreamingLoudnessMeter::GatingHistogram::add(double energy, float loudness)
+{
+    const int bin = getBinIndex(loudness);
+
+    ++counts[static_cast<size_t>(bin)];
+    energies[static_cast<size_t>(bin)] += energy;
+    ++totalCount;
+}
+
+float StreamingLoudnessMeter::GatingHistogram::getGatedLoudness(float gateLoudness) const
+{
+    double energySum = 0.0;
+    juce::uint64 count = 0;
+
+    for (int bin = getBinIndex(gateLoudness); bin < numBins; ++bin)
+    {
+        energySum += energies[static_cast<size_t>(bin)];
+        count += counts[static_cast<size_t>(bin)];
+    }
+
+    if (count == 0)
+        return silenceLUFS;
+
+    return energyToLoudness(energySum / static_cast<double>(count));
+}
+
+float StreamingLoudnessMeter::GatingHistogram::getPercentile(float gateLoudness, double fraction) const
+{
+    const int firstBin = getBinIndex(gateLoudness);
+
+    juce::uint64 count = 0;
+    for (int bin = firstBin; bin < numBins; ++bin)
+        count += counts[static_cast<size_t>(bin)];
+
+    if (count == 0)
+        return silenceLUFS;
+
+    // Walk up to the bin holding the requested rank and report its centre
+    const double targetRank = fraction * static_cast<double>(count - 1);
+    juce::uint64 cumulative = 0;
+
+    for (int bin = firstBin; bin < numBins; ++bin)
+    {
+        cumulative += counts[static_cast<size_t>(bin)];
+
+        if (static_cast<double>(cumulative) > targetRank)
+            return minLoudness + (static_cast<float>(bin) + 0.5f) * binWidth;
+    }
+
+    return maxLoudness;
+}
+
+int StreamingLoudnessMeter::GatingHistogram::getBinIndex(float loudness) const
+{
+    return juce::jlimit(0, numBins - 1, static_cast<int>(std::floor((loudness - minLoudness) / binWidth)));
+}
+
+} // namespace ForensEQ
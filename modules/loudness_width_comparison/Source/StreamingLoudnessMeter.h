@@ -0,0 +1,132 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for measuring loudness per ITU-R BS.1770-4 / EBU R128 on a stream of audio
+ *
+ * Audio is K-weighted with two biquads designed for the actual sample rate and
+ * accumulated in 100 ms hops. The 400 ms momentary and 3 s short-term windows are
+ * running sums over the hop energies, so each hop costs O(1). Gating blocks are kept
+ * in fixed-size loudness histograms, so integrated loudness and loudness range (LRA)
+ * over any length of programme need constant memory.
+ *
+ * prepare() allocates; processBlock() never allocates or locks and may be called from
+ * the audio thread. The same object is used offline by feeding a whole file through it.
+ */
+class StreamingLoudnessMeter {
+public:
+    StreamingLoudnessMeter();
+    ~StreamingLoudnessMeter();
+
+    // Prepare for a stream (allocates; not on the audio thread)
+    void prepare(double sampleRate, int numChannels);
+
+    // Clear filter state, windows and gating history
+    void reset();
+
+    // Feed the next block of audio. Channels beyond those prepared are ignored
+    void processBlock(const juce::AudioBuffer<float>& buffer) noexcept;
+    void processBlock(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+
+    // Latest 400 ms / 3 s loudness in LUFS; safe to read from any thread
+    float getMomentaryLoudness() const { return momentaryLoudness.load(std::memory_order_relaxed); }
+    float getShortTermLoudness() const { return shortTermLoudness.load(std::memory_order_relaxed); }
+
+    // Maximum momentary / short-term loudness since the last reset
+    float getMaxMomentaryLoudness() const { return maxMomentaryLoudness; }
+    float getMaxShortTermLoudness() const { return maxShortTermLoudness; }
+
+    // Gated integrated loudness in LUFS since the last reset (processing thread)
+    float getIntegratedLoudness() const;
+
+    // Loudness range in LU since the last reset (processing thread)
+    float getLoudnessRange() const;
+
+    // Level reported when nothing above the absolute gate has been measured
+    static constexpr float silenceLUFS = -70.0f;
+
+private:
+    // Transposed direct form II biquad state
+    struct Biquad {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+        double z1 = 0.0, z2 = 0.0;
+
+        double process(double x) noexcept
+        {
+            const double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    // Fixed-resolution histogram of gating block loudness, holding the block count and
+    // the summed mean-square energy per bin so gated averages stay exact
+    class GatingHistogram {
+    public:
+        void clear();
+        void add(double energy, float loudness);
+
+        // Energy-weighted mean loudness of all blocks at or above the given loudness
+        float getGatedLoudness(float gateLoudness) const;
+
+        // Loudness below which the given fraction of blocks at or above the gate lie
+        float getPercentile(float gateLoudness, double fraction) const;
+
+        bool isEmpty() const { return totalCount == 0; }
+
+    private:
+        int getBinIndex(float loudness) const;
+
+        static constexpr float minLoudness = -70.0f;
+        static constexpr float maxLoudness = 10.0f;
+        static constexpr float binWidth = 0.1f;
+        static constexpr int numBins = 800;
+
+        std::array<juce::uint64, numBins> counts {};
+        std::array<double, numBins> energies {};
+        juce::uint64 totalCount = 0;
+    };
+
+    // Per-channel K-weighting filters
+    std::vector<Biquad> shelfFilters;
+    std::vector<Biquad> highPassFilters;
+    std::vector<double> channelWeights;
+
+    double sampleRate = 44100.0;
+    int numChannels = 0;
+    int hopLength = 4410;
+
+    // Current 100 ms hop
+    double hopEnergySum = 0.0;
+    int hopSamplesRemaining = 4410;
+
+    // Ring of the last 30 hop energies (3 s) with running window sums
+    static constexpr int hopsPerMomentary = 4;
+    static constexpr int hopsPerShortTerm = 30;
+    std::array<double, hopsPerShortTerm> hopEnergies {};
+    int hopIndex = 0;
+    juce::int64 numHopsProcessed = 0;
+    double momentarySum = 0.0;
+    double shortTermSum = 0.0;
+
+    // Results
+    std::atomic<float> momentaryLoudness { silenceLUFS };
+    std::atomic<float> shortTermLoudness { silenceLUFS };
+    float maxMomentaryLoudness = silenceLUFS;
+    float maxShortTermLoudness = silenceLUFS;
+    GatingHistogram momentaryHistogram;  // 400 ms blocks, for integrated loudness
+    GatingHistogram shortTermHistogram;  // 3 s blocks, for loudness range
+
+    // Helper methods
+    void designFilters();
+    void finishHop() noexcept;
+    static float energyToLoudness(double energy);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StreamingLoudnessMeter)
+};
+
+} // namespace ForensEQ
@@ -0,0 +1,198 @@
+#include <JuceHeader.h>
+#include "../StreamingLoudnessMeter.h"
+#include "../TruePeakDetector.h"
+
+//==============================================================================
+// Reference signals from EBU Tech 3341 (loudness and true peak) and EBU Tech 3342
+// (loudness range), all built from sine tones so no test files are needed
+
+namespace
+{
+    // One section of a test signal: a level in dBFS held for a number of seconds
+    struct Section
+    {
+        float levelDb;
+        double seconds;
+    };
+
+    // A sine tone in every channel, changing level from section to section. fadeInSeconds
+    // ramps the start in, so an interpolator measures the tone rather than its onset
+    juce::AudioBuffer<float> createSine(double sampleRate, int numChannels, double frequency,
+                                        std::initializer_list<Section> sections,
+                                        double phaseDegrees = 0.0, double fadeInSeconds = 0.0)
+    {
+        double totalSeconds = 0.0;
+        for (const auto& section : sections)
+            totalSeconds += section.seconds;
+
+        juce::AudioBuffer<float> buffer(numChannels, juce::roundToInt(totalSeconds * sampleRate));
+
+        const double phaseStep = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+        const double startPhase = juce::degreesToRadians(phaseDegrees);
+        const int fadeInLength = juce::roundToInt(fadeInSeconds * sampleRate);
+        int sample = 0;
+
+        for (const auto& section : sections)
+        {
+            const float gain = juce::Decibels::decibelsToGain(section.levelDb, -200.0f);
+            const int sectionEnd = juce::jmin(buffer.getNumSamples(), sample + juce::roundToInt(section.seconds * sampleRate));
+
+            for (; sample < sectionEnd; ++sample)
+            {
+                float value = gain * static_cast<float>(std::sin(startPhase + phaseStep * sample));
+
+                if (sample < fadeInLength)
+                    value *= static_cast<float>(0.5 - 0.5 * std::cos(juce::MathConstants<double>::pi * sample / fadeInLength));
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    buffer.setSample(channel, sample, value);
+            }
+        }
+
+        return buffer;
+    }
+
+    // Feed a buffer through a processor in host-sized blocks
+    template <typename Processor>
+    void processInBlocks(Processor& processor, const juce::AudioBuffer<float>& buffer, int blockSize = 512)
+    {
+        for (int start = 0; start < buffer.getNumSamples(); start += blockSize)
+            processor.processBlock(buffer, start, juce::jmin(blockSize, buffer.getNumSamples() - start));
+    }
+}
+
+//==============================================================================
+class StreamingLoudnessMeterTests : public juce::UnitTest
+{
+public:
+    StreamingLoudnessMeterTests() : juce::UnitTest("StreamingLoudnessMeter", "ForensEQ Loudness") {}
+
+    void runTest() override
+    {
+        beginTest("EBU Tech 3341 case 1: stereo 1 kHz at -23 dBFS reads -23 LUFS");
+        expectIntegrated(48000.0, { { -23.0f, 20.0 } }, -23.0f);
+        expectIntegrated(44100.0, { { -23.0f, 20.0 } }, -23.0f);
+
+        beginTest("EBU Tech 3341 case 2: stereo 1 kHz at -33 dBFS reads -33 LUFS");
+        expectIntegrated(48000.0, { { -33.0f, 20.0 } }, -33.0f);
+
+        beginTest("EBU Tech 3341 case 3: relative gate removes the -36 dBFS sections");
+        expectIntegrated(48000.0, { { -36.0f, 10.0 }, { -23.0f, 60.0 }, { -36.0f, 10.0 } }, -23.0f);
+
+        beginTest("EBU Tech 3341 case 4: absolute and relative gates together");
+        expectIntegrated(48000.0, { { -72.0f, 10.0 }, { -36.0f, 10.0 }, { -23.0f, 60.0 },
+                                    { -36.0f, 10.0 }, { -72.0f, 10.0 } }, -23.0f);
+
+        beginTest("EBU Tech 3341 cases 5 and 6: momentary and short-term of a steady tone");
+        {
+            ForensEQ::StreamingLoudnessMeter meter;
+            meter.prepare(48000.0, 2);
+            processInBlocks(meter, createSine(48000.0, 2, 1000.0, { { -23.0f, 20.0 } }));
+
+            expectWithinAbsoluteError(meter.getMaxMomentaryLoudness(), -23.0f, 0.1f);
+            expectWithinAbsoluteError(meter.getMaxShortTermLoudness(), -23.0f, 0.1f);
+        }
+
+        beginTest("EBU Tech 3342 cases 1 to 3: loudness range of two levels");
+        expectLoudnessRange({ { -20.0f, 20.0 }, { -30.0f, 20.0 } }, 10.0f);
+        expectLoudnessRange({ { -20.0f, 20.0 }, { -15.0f, 20.0 } }, 5.0f);
+        expectLoudnessRange({ { -40.0f, 20.0 }, { -20.0f, 20.0 } }, 20.0f);
+
+        beginTest("Digital silence reads the silence level");
+        {
+            ForensEQ::StreamingLoudnessMeter meter;
+            meter.prepare(48000.0, 2);
+
+            juce::AudioBuffer<float> silence(2, 48000 * 5);
+            silence.clear();
+            processInBlocks(meter, silence);
+
+            expectEquals(meter.getIntegratedLoudness(), ForensEQ::StreamingLoudnessMeter::silenceLUFS);
+        }
+    }
+
+private:
+    // EBU Tech 3341 allows +/-0.1 LU for integrated loudness
+    void expectIntegrated(double sampleRate, std::initializer_list<Section> sections, float expectedLUFS)
+    {
+        ForensEQ::StreamingLoudnessMeter meter;
+        meter.prepare(sampleRate, 2);
+        processInBlocks(meter, createSine(sampleRate, 2, 1000.0, sections));
+
+        expectWithinAbsoluteError(meter.getIntegratedLoudness(), expectedLUFS, 0.1f,
+                                  "at " + juce::String(sampleRate) + " Hz");
+    }
+
+    // EBU Tech 3342 allows +/-1 LU for loudness range
+    void expectLoudnessRange(std::initializer_list<Section> sections, float expectedLU)
+    {
+        ForensEQ::StreamingLoudnessMeter meter;
+        meter.prepare(48000.0, 2);
+        processInBlocks(meter, createSine(48000.0, 2, 1000.0, sections));
+
+        expectWithinAbsoluteError(meter.getLoudnessRange(), expectedLU, 1.0f);
+    }
+};
+
+//==============================================================================
+class TruePeakDetectorTests : public juce::UnitTest
+{
+public:
+    TruePeakDetectorTests() : juce::UnitTest("TruePeakDetector", "ForensEQ Loudness") {}
+
+    void runTest() override
+    {
+        // Each tone peaks at -6 dBFS between samples, so its sample peak is lower
+        beginTest("EBU Tech 3341 true peak: inter-sample peaks read -6 dBTP");
+        expectTruePeak(12000.0, 45.0);
+        expectTruePeak(8000.0, 60.0);
+        expectTruePeak(6000.0, 67.5);
+
+        beginTest("A low tone reads its -6 dBFS peak");
+        expectTruePeak(997.0, 0.0);
+
+        beginTest("Digital silence reads the silence level");
+        {
+            ForensEQ::TruePeakDetector detector;
+            detector.prepare(48000.0, 2);
+
+            juce::AudioBuffer<float> silence(2, 48000);
+            silence.clear();
+            processInBlocks(detector, silence);
+
+            expectEquals(detector.getTruePeakDb(), ForensEQ::TruePeakDetector::silenceDb);
+        }
+    }
+
+private:
+    // EBU Tech 3341 allows +0.2/-0.4 dB for true peak
+    void expectTruePeak(double frequency, double phaseDegrees)
+    {
+        ForensEQ::TruePeakDetector detector;
+        detector.prepare(48000.0, 2);
+        processInBlocks(detector, createSine(48000.0, 2, frequency, { { -6.0f, 1.0 } }, phaseDegrees, 0.1));
+
+        const float truePeakDb = detector.getTruePeakDb();
+        const juce::String description = juce::String(frequency) + " Hz using the "
+                                       + detector.getKernelName() + " kernel reads " + juce::String(truePeakDb);
+
+        expectLessOrEqual(truePeakDb, -6.0f + 0.2f, description);
+        expectGreaterOrEqual(truePeakDb, -6.0f - 0.4f, description);
+    }
+};
+
+static StreamingLoudnessMeterTests streamingLoudnessMeterTests;
+static TruePeakDetectorTests truePeakDetectorTests;
+
+//==============================================================================
+int main()
+{
+    juce::UnitTestRunner runner;
+    runner.runTestsInCategory("ForensEQ Loudness");
+
+    int numFailures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult(i)->failures;
+
+    return numFailures > 0 ? 1 : 0;
+}
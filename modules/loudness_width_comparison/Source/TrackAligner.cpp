@@ -0,0 +1,243 @@
+#include "TrackAligner.h"
+
+namespace ForensEQ {
+
+TrackAligner::TrackAligner()
+{
+}
+
+TrackAligner::~TrackAligner()
+{
+}
+
+TrackAligner::Alignment TrackAligner::align(const juce::AudioBuffer<float>& userMix,
+                                            const juce::AudioBuffer<float>& referenceMix,
+                                            double sampleRate, const juce::String& referenceKey)
+{
+    std::shared_ptr<const std::vector<float>> referenceEnvelope;
+
+    if (referenceKey.isNotEmpty())
+    {
+        const juce::ScopedLock sl(lock);
+
+        auto it = cache.find(referenceKey);
+        if (it != cache.end())
+        {
+            referenceEnvelope = it->second;
+            recentKeys.removeString(referenceKey);
+            recentKeys.add(referenceKey);
+        }
+    }
+
+    if (referenceEnvelope == nullptr)
+    {
+        referenceEnvelope = std::make_shared<const std::vector<float>>(computeOnsetEnvelope(referenceMix, sampleRate));
+
+        if (referenceKey.isNotEmpty())
+        {
+            const juce::ScopedLock sl(lock);
+
+            cache[referenceKey] = referenceEnvelope;
+            recentKeys.removeString(referenceKey);
+            recentKeys.add(referenceKey);
+
+            // Evict the least recently used entries
+            while (recentKeys.size() > maxCacheEntries)
+            {
+                cache.erase(recentKeys[0]);
+                recentKeys.remove(0);
+            }
+        }
+    }
+
+    return alignEnvelopes(computeOnsetEnvelope(userMix, sampleRate), *referenceEnvelope);
+}
+
+TrackAligner::Alignment TrackAligner::alignEnvelopes(const std::vector<float>& userEnvelope,
+                                                     const std::vector<float>& referenceEnvelope) const
+{
+    Alignment alignment;
+
+    const int userLength = static_cast<int>(userEnvelope.size());
+    const int referenceLength = static_cast<int>(referenceEnvelope.size());
+
+    if (userLength < 2 || referenceLength < 2)
+        return alignment;
+
+    // Remove the means so the peak reflects the shape of the envelopes, not their average
+    auto removeMean = [](const std::vector<float>& envelope)
+    {
+        const double sum = std::accumulate(envelope.begin(), envelope.end(), 0.0);
+        const float mean = static_cast<float>(sum / static_cast<double>(envelope.size()));
+
+        std::vector<float> centred(envelope.size());
+        for (size_t i = 0; i < envelope.size(); ++i)
+            centred[i] = envelope[i] - mean;
+
+        return centred;
+    };
+
+    const std::vector<float> user = removeMean(userEnvelope);
+    const std::vector<float> reference = removeMean(referenceEnvelope);
+
+    // Zero-pad to at least userLength + referenceLength - 1 so the circular correlation
+    // has no wrap-around at the lags we read
+    int order = 1;
+    while ((1 << order) < userLength + referenceLength - 1)
+        ++order;
+
+    const int fftSize = 1 << order;
+    juce::dsp::FFT fft(order);
+
+    // Real-only transforms need twice the FFT size
+    std::vector<float> userSpectrum(static_cast<size_t>(fftSize) * 2, 0.0f);
+    std::vector<float> correlation(static_cast<size_t>(fftSize) * 2, 0.0f);
+    std::copy(user.begin(), user.end(), userSpectrum.begin());
+    std::copy(reference.begin(), reference.end(), correlation.begin());
+
+    fft.performRealOnlyForwardTransform(userSpectrum.data(), true);
+    fft.performRealOnlyForwardTransform(correlation.data(), true);
+
+    // conj(User) * Reference; its inverse transform holds sum_n user[n] * reference[n + lag]
+    for (int bin = 0; bin <= fftSize / 2; ++bin)
+    {
+        const float userReal = userSpectrum[static_cast<size_t>(bin * 2)];
+        const float userImag = userSpectrum[static_cast<size_t>(bin * 2 + 1)];
+        const float referenceReal = correlation[static_cast<size_t>(bin * 2)];
+        const float referenceImag = correlation[static_cast<size_t>(bin * 2 + 1)];
+
+        correlation[static_cast<size_t>(bin * 2)] = userReal * referenceReal + userImag * referenceImag;
+        correlation[static_cast<size_t>(bin * 2 + 1)] = userReal * referenceImag - userImag * referenceReal;
+    }
+
+    fft.performRealOnlyInverseTransform(correlation.data());
+
+    // Negative lags wrap around to the end of the output
+    auto correlationAt = [&correlation, fftSize](int lag)
+    {
+        return correlation[static_cast<size_t>((lag + fftSize) % fftSize)];
+    };
+
+    const int maxLag = juce::roundToInt(getMaxOffset() * envelopeRate);
+    const int minSearchLag = juce::jmax(-(userLength - 1), -maxLag);
+    const int maxSearchLag = juce::jmin(referenceLength - 1, maxLag);
+
+    int bestLag = 0;
+    float bestValue = -std::numeric_limits<float>::max();
+
+    for (int lag = minSearchLag; lag <= maxSearchLag; ++lag)
+    {
+        if (correlationAt(lag) > bestValue)
+        {
+            bestValue = correlationAt(lag);
+            bestLag = lag;
+        }
+    }
+
+    // Parabolic interpolation through the peak and its neighbours
+    double fraction = 0.0;
+
+    if (bestLag > minSearchLag && bestLag < maxSearchLag)
+    {
+        const float before = correlationAt(bestLag - 1);
+        const float after = correlationAt(bestLag + 1);
+        const float curvature = before - 2.0f * bestValue + after;
+
+        if (curvature < 0.0f)
+            fraction = juce::jlimit(-0.5, 0.5, 0.5 * static_cast<double>(before - after) / curvature);
+    }
+
+    alignment.offsetSeconds = (bestLag + fraction) / envelopeRate;
+    alignment.confidence = juce::jlimit(0.0f, 1.0f, getCorrelationAtLag(user, reference, bestLag));
+
+    return alignment;
+}
+
+std::vector<float> TrackAligner::computeOnsetEnvelope(const juce::AudioBuffer<float>& buffer, double sampleRate)
+{
+    const int hopSize = juce::jmax(1, juce::roundToInt(sampleRate / envelopeRate));
+    const int numChannels = buffer.getNumChannels();
+    const int numFrames = buffer.getNumSamples() / hopSize;
+
+    std::vector<float> envelope(static_cast<size_t>(juce::jmax(0, numFrames)), 0.0f);
+
+    if (numChannels == 0)
+        return envelope;
+
+    // -100 dB, so audio starting at full level still registers as an onset
+    constexpr float energyFloor = 1.0e-10f;
+    float previousLevel = 10.0f * std::log10(energyFloor);
+
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        // Channels are summed by energy, so out-of-phase content doesn't cancel
+        double energy = 0.0;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const float* data = buffer.getReadPointer(channel, frame * hopSize);
+
+            for (int i = 0; i < hopSize; ++i)
+                energy += static_cast<double>(data[i]) * data[i];
+        }
+
+        const float level = 10.0f * std::log10(static_cast<float>(energy / (hopSize * numChannels)) + energyFloor);
+
+        // Only rises in level mark onsets
+        envelope[static_cast<size_t>(frame)] = juce::jmax(0.0f, level - previousLevel);
+        previousLevel = level;
+    }
+
+    return envelope;
+}
+
+void TrackAligner::setMaxOffset(double seconds)
+{
+    const juce::ScopedLock sl(lock);
+    maxOffset = juce::jmax(0.0, seconds);
+}
+
+double TrackAligner::getMaxOffset() const
+{
+    const juce::ScopedLock sl(lock);
+    return maxOffset;
+}
+
+void TrackAligner::clearCache()
+{
+    const juce::ScopedLock sl(lock);
+
+    cache.clear();
+    recentKeys.clear();
+}
+
+float TrackAligner::getCorrelationAtLag(const std::vector<float>& userEnvelope,
+                                        const std::vector<float>& referenceEnvelope, int lag)
+{
+    // Pearson-style normalization over the overlapping part only
+    const int userLength = static_cast<int>(userEnvelope.size());
+    const int referenceLength = static_cast<int>(referenceEnvelope.size());
+    const int first = juce::jmax(0, -lag);
+    const int end = juce::jmin(userLength, referenceLength - lag);
+
+    double sumProducts = 0.0;
+    double sumUserSquared = 0.0;
+    double sumReferenceSquared = 0.0;
+
+    for (int n = first; n < end; ++n)
+    {
+        const double user = userEnvelope[static_cast<size_t>(n)];
+        const double reference = referenceEnvelope[static_cast<size_t>(n + lag)];
+
+        sumProducts += user * reference;
+        sumUserSquared += user * user;
+        sumReferenceSquared += reference * reference;
+    }
+
+    if (sumUserSquared <= 0.0 || sumReferenceSquared <= 0.0)
+        return 0.0f;
+
+    return static_cast<float>(sumProducts / std::sqrt(sumUserSquared * sumReferenceSquared));
+}
+
+} // namespace ForensEQ
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for finding the time offset between a user mix and a reference
+ *
+ * Each track is reduced to an onset envelope at 100 frames per second: the rise in log
+ * energy from one 10 ms frame to the next, which follows the rhythm of the material
+ * rather than its level or EQ. The two envelopes are cross-correlated with one FFT
+ * (O(N log N) instead of the O(N^2) of trying every lag), the best lag within the search
+ * range is picked, and it is refined to a fraction of a frame by parabolic interpolation.
+ *
+ * The reference's onset envelope is cached under a key the caller already has for its
+ * content (e.g. its ReferenceAnalysisCache key), so aligning against a known reference
+ * only computes the user mix's envelope and nothing is hashed here. All methods are
+ * thread-safe.
+ */
+class TrackAligner {
+public:
+    TrackAligner();
+    ~TrackAligner();
+
+    // Offset between two tracks: material at time t in the user mix is at time
+    // t + offsetSeconds in the reference
+    struct Alignment {
+        double offsetSeconds = 0.0;
+        float confidence = 0.0f; // Normalized correlation of the envelopes at that offset (0 to 1)
+
+        // Whether the envelopes match well enough for the offset to mean anything; a
+        // reference that is a different song has no meaningful offset
+        bool isReliable() const { return confidence >= minConfidence; }
+    };
+
+    // Align two tracks. With a referenceKey identifying the reference's content, its onset
+    // envelope is cached under that key; an empty key caches nothing
+    Alignment align(const juce::AudioBuffer<float>& userMix, const juce::AudioBuffer<float>& referenceMix,
+                    double sampleRate, const juce::String& referenceKey = {});
+
+    // Align two onset envelopes computed by computeOnsetEnvelope()
+    Alignment alignEnvelopes(const std::vector<float>& userEnvelope, const std::vector<float>& referenceEnvelope) const;
+
+    // Compute the onset envelope of a buffer (all channels mixed), envelopeRate values per second
+    static std::vector<float> computeOnsetEnvelope(const juce::AudioBuffer<float>& buffer, double sampleRate);
+
+    // Set/get the largest offset searched, in seconds
+    void setMaxOffset(double seconds);
+    double getMaxOffset() const;
+
+    // Remove all cached reference envelopes
+    void clearCache();
+
+    // Onset envelope frames per second
+    static constexpr double envelopeRate = 100.0;
+
+    // Confidence below which an alignment is treated as unreliable
+    static constexpr float minConfidence = 0.3f;
+
+private:
+    double maxOffset = 30.0;
+
+    // Cached reference envelopes, with keys ordered from least to most recently used
+    std::map<juce::String, std::shared_ptr<const std::vector<float>>> cache;
+    juce::StringArray recentKeys;
+    static constexpr int maxCacheEntries = 32;
+
+    juce::CriticalSection lock;
+
+    // Helper methods
+    static float getCorrelationAtLag(const std::vector<float>& userEnvelope, const std::vector<float>& referenceEnvelope,
+                                     int lag);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackAligner)
+};
+
+} // namespace ForensEQ
@@ -0,0 +1,278 @@
+#include "TruePeakDetector.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#elif JUCE_ARM && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+ #include <arm_neon.h>
+ #define FORENSEQ_TRUE_PEAK_NEON 1
+#endif
+
+// GCC and Clang only emit SSE/AVX instructions inside functions marked for them,
+// which lets the AVX kernel live in a binary built for baseline x86
+#if JUCE_INTEL && (defined(__GNUC__) || defined(__clang__))
+ #define FORENSEQ_TARGET_SSE2 __attribute__((target("sse2")))
+ #define FORENSEQ_TARGET_AVX __attribute__((target("avx")))
+#else
+ #define FORENSEQ_TARGET_SSE2
+ #define FORENSEQ_TARGET_AVX
+#endif
+
+namespace ForensEQ {
+
+// BS.1770-4 Annex 2 interpolation filter, 4 phases of 12 taps. Phases 2 and 3 are
+// phases 1 and 0 reversed
+static const float truePeakPhase0[TruePeakDetector::tapsPerPhase] = {
+     0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+    -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+     0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f
+};
+
+static const float truePeakPhase1[TruePeakDetector::tapsPerPhase] = {
+    -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+    -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+     0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f
+};
+
+//==============================================================================
+// Interpolation kernels. For each input sample n, phase p of the output is
+// sum over taps k of coefficients[k][p] * input[n - k]
+
+static float interpolateScalar(const float* input, int numSamples, const float* coefficients)
+{
+    constexpr int phases = TruePeakDetector::oversamplingFactor;
+    float peak = 0.0f;
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        float sums[phases] = {};
+
+        for (int k = 0; k < TruePeakDetector::tapsPerPhase; ++k)
+        {
+            const float x = input[n - k];
+            for (int p = 0; p < phases; ++p)
+                sums[p] += x * coefficients[k * phases + p];
+        }
+
+        for (int p = 0; p < phases; ++p)
+            peak = juce::jmax(peak, std::abs(sums[p]));
+    }
+
+    return peak;
+}
+
+#if JUCE_INTEL
+FORENSEQ_TARGET_SSE2 static float interpolateSSE(const float* input, int numSamples, const float* coefficients)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 peak = _mm_setzero_ps();
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        // All four phases of one input sample in one register
+        __m128 sum = _mm_setzero_ps();
+
+        for (int k = 0; k < TruePeakDetector::tapsPerPhase; ++k)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(input[n - k]), _mm_load_ps(coefficients + k * 4)));
+
+        peak = _mm_max_ps(peak, _mm_andnot_ps(signMask, sum));
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peak);
+    return juce::jmax(juce::jmax(lanes[0], lanes[1]), juce::jmax(lanes[2], lanes[3]));
+}
+
+FORENSEQ_TARGET_AVX static float interpolateAVX(const float* input, int numSamples, const float* coefficients)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 peak = _mm256_setzero_ps();
+    int n = 0;
+
+    // Two input samples (eight output samples) per iteration; the coefficient rows
+    // hold each tap's four phases twice
+    for (; n + 1 < numSamples; n += 2)
+    {
+        __m256 sum = _mm256_setzero_ps();
+
+        for (int k = 0; k < TruePeakDetector::tapsPerPhase; ++k)
+        {
+            const __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(input[n - k])),
+                                                  _mm_set1_ps(input[n + 1 - k]), 1);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(x, _mm256_load_ps(coefficients + k * 8)));
+        }
+
+        peak = _mm256_max_ps(peak, _mm256_andnot_ps(signMask, sum));
+    }
+
+    __m128 peak4 = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+
+    // Odd trailing sample
+    if (n < numSamples)
+    {
+        __m128 sum = _mm_setzero_ps();
+
+        for (int k = 0; k < TruePeakDetector::tapsPerPhase; ++k)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(input[n - k]), _mm_load_ps(coefficients + k * 8)));
+
+        peak4 = _mm_max_ps(peak4, _mm_andnot_ps(_mm_set1_ps(-0.0f), sum));
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peak4);
+    return juce::jmax(juce::jmax(lanes[0], lanes[1]), juce::jmax(lanes[2], lanes[3]));
+}
+#endif
+
+#if FORENSEQ_TRUE_PEAK_NEON
+static float interpolateNEON(const float* input, int numSamples, const float* coefficients)
+{
+    float32x4_t peak = vdupq_n_f32(0.0f);
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        float32x4_t sum = vdupq_n_f32(0.0f);
+
+        for (int k = 0; k < TruePeakDetector::tapsPerPhase; ++k)
+            sum = vmlaq_n_f32(sum, vld1q_f32(coefficients + k * 4), input[n - k]);
+
+        peak = vmaxq_f32(peak, vabsq_f32(sum));
+    }
+
+    float lanes[4];
+    vst1q_f32(lanes, peak);
+    return juce::jmax(juce::jmax(lanes[0], lanes[1]), juce::jmax(lanes[2], lanes[3]));
+}
+#endif
+
+//==============================================================================
+TruePeakDetector::TruePeakDetector()
+{
+    // Transpose the phase tables to [tap][phase]
+    for (int k = 0; k < tapsPerPhase; ++k)
+    {
+        coefficients[k][0] = truePeakPhase0[k];
+        coefficients[k][1] = truePeakPhase1[k];
+        coefficients[k][2] = truePeakPhase1[tapsPerPhase - 1 - k];
+        coefficients[k][3] = truePeakPhase0[tapsPerPhase - 1 - k];
+
+        for (int p = 0; p < oversamplingFactor * 2; ++p)
+            coefficientsX2[k][p] = coefficients[k][p % oversamplingFactor];
+    }
+
+    selectKernel();
+    prepare(44100.0, 2);
+}
+
+TruePeakDetector::~TruePeakDetector()
+{
+}
+
+void TruePeakDetector::prepare(double sampleRate, int newNumChannels)
+{
+    // The Annex 2 filter is specified relative to the input rate, so 4x oversampling
+    // is applied at every rate (it is conservative above 48 kHz)
+    juce::ignoreUnused(sampleRate);
+
+    numChannels = juce::jmax(0, newNumChannels);
+    workBuffers.assign(static_cast<size_t>(numChannels),
+                       std::vector<float>(static_cast<size_t>(tapsPerPhase - 1 + chunkSize), 0.0f));
+
+    reset();
+}
+
+void TruePeakDetector::reset()
+{
+    for (auto& work : workBuffers)
+        std::fill(work.begin(), work.end(), 0.0f);
+
+    truePeak.store(0.0f);
+}
+
+void TruePeakDetector::processBlock(const juce::AudioBuffer<float>& buffer) noexcept
+{
+    processBlock(buffer, 0, buffer.getNumSamples());
+}
+
+void TruePeakDetector::processBlock(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept
+{
+    const int channelsToProcess = juce::jmin(numChannels, buffer.getNumChannels());
+    const int historyLength = tapsPerPhase - 1;
+    float peak = truePeak.load(std::memory_order_relaxed);
+
+    for (int channel = 0; channel < channelsToProcess; ++channel)
+    {
+        float* work = workBuffers[static_cast<size_t>(channel)].data();
+        int position = startSample;
+        int remaining = numSamples;
+
+        while (remaining > 0)
+        {
+            const int chunkLength = juce::jmin(remaining, chunkSize);
+
+            std::copy(buffer.getReadPointer(channel, position),
+                      buffer.getReadPointer(channel, position) + chunkLength,
+                      work + historyLength);
+
+            peak = juce::jmax(peak, kernelFunction(work + historyLength, chunkLength, kernelCoefficients));
+
+            // The interpolator can undershoot the samples themselves; a true peak is never below the sample peak
+            peak = juce::jmax(peak, buffer.getMagnitude(channel, position, chunkLength));
+
+            // Keep the newest samples as history for the next chunk
+            std::copy(work + chunkLength, work + chunkLength + historyLength, work);
+
+            position += chunkLength;
+            remaining -= chunkLength;
+        }
+    }
+
+    truePeak.store(peak, std::memory_order_relaxed);
+}
+
+float TruePeakDetector::getTruePeakDb() const
+{
+    const float peak = getTruePeak();
+
+    if (peak <= 0.0f)
+        return silenceDb;
+
+    return juce::jmax(silenceDb, 20.0f * std::log10(peak));
+}
+
+juce::String TruePeakDetector::getKernelName() const
+{
+    switch (kernel)
+    {
+        case Kernel::SSE:  return "SSE2";
+        case Kernel::AVX:  return "AVX";
+        case Kernel::NEON: return "NEON";
+        case Kernel::Scalar:
+        default:           return "Scalar";
+    }
+}
+
+void TruePeakDetector::selectKernel()
+{
+    kernel = Kernel::Scalar;
+    kernelFunction = interpolateScalar;
+    kernelCoefficients = &coefficients[0][0];
+
+   #if JUCE_INTEL
+    if (juce::SystemStats::hasAVX())
+    {
+        kernel = Kernel::AVX;
+        kernelFunction = interpolateAVX;
+        kernelCoefficients = &coefficientsX2[0][0];
+    }
+    else if (juce::SystemStats::hasSSE2())
+    {
+        kernel = Kernel::SSE;
+        kernelFunction = interpolateSSE;
+    }
+   #elif FORENSEQ_TRUE_PEAK_NEON
+    kernel = Kernel::NEON;
+    kernelFunction = interpolateNEON;
+   #endif
+}
+
+} // namespace ForensEQ
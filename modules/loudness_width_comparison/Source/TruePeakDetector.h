@@ -0,0 +1,83 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for measuring true peak level per ITU-R BS.1770-4 Annex 2
+ *
+ * Each channel is upsampled 4x with the 48-tap polyphase FIR from the standard and
+ * the largest absolute interpolated value is kept. The interpolation kernel is chosen
+ * once at prepare() time from the CPU's capabilities (AVX, SSE2 or NEON, with a
+ * scalar fallback), and all kernels compute the same filter so results agree.
+ *
+ * prepare() allocates; processBlock() never allocates or locks and may be called from
+ * the audio thread.
+ */
+class TruePeakDetector {
+public:
+    TruePeakDetector();
+    ~TruePeakDetector();
+
+    // Prepare for a stream (allocates; not on the audio thread)
+    void prepare(double sampleRate, int numChannels);
+
+    // Clear the filter history and the measured peak
+    void reset();
+
+    // Feed the next block of audio. Channels beyond those prepared are ignored
+    void processBlock(const juce::AudioBuffer<float>& buffer) noexcept;
+    void processBlock(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+
+    // Highest true peak since the last reset, as a linear gain; safe to read from any thread
+    float getTruePeak() const { return truePeak.load(std::memory_order_relaxed); }
+
+    // Highest true peak since the last reset in dBTP
+    float getTruePeakDb() const;
+
+    // Name of the interpolation kernel in use (for diagnostics)
+    juce::String getKernelName() const;
+
+    // Level reported for digital silence
+    static constexpr float silenceDb = -70.0f;
+
+    // Filter layout: 4 phases of 12 taps
+    static constexpr int oversamplingFactor = 4;
+    static constexpr int tapsPerPhase = 12;
+
+private:
+    // Returns the largest absolute interpolated value for numSamples inputs. The input
+    // pointer is preceded by tapsPerPhase - 1 samples of history
+    using KernelFunction = float (*)(const float* input, int numSamples, const float* coefficients);
+
+    enum class Kernel {
+        Scalar,
+        SSE,
+        AVX,
+        NEON
+    };
+
+    Kernel kernel = Kernel::Scalar;
+    KernelFunction kernelFunction = nullptr;
+    const float* kernelCoefficients = nullptr;
+
+    // Coefficients transposed to [tap][phase], and duplicated to [tap][2 * phase]
+    // so the AVX kernel can interpolate two input samples per iteration
+    alignas(32) float coefficients[tapsPerPhase][oversamplingFactor];
+    alignas(32) float coefficientsX2[tapsPerPhase][oversamplingFactor * 2];
+
+    // Per-channel working buffers: tapsPerPhase - 1 samples of history followed by input
+    static constexpr int chunkSize = 1024;
+    std::vector<std::vector<float>> workBuffers;
+    int numChannels = 0;
+
+    std::atomic<float> truePeak { 0.0f };
+
+    // Helper methods
+    void selectKernel();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TruePeakDetector)
+};
+
+} // namespace ForensEQ
@@ -0,0 +1,82 @@
+#include "AudioBlockReader.h"
+
+namespace ForensEQ {
+
+AudioBlockReader::AudioBlockReader(int blockSize)
+    : blockSize(juce::jmax(1, blockSize))
+{
+    formatManager.registerBasicFormats();
+}
+
+AudioBlockReader::~AudioBlockReader()
+{
+}
+
+bool AudioBlockReader::open(const juce::File& audioFile)
+{
+    close();
+
+    reader.reset(formatManager.createReaderFor(audioFile));
+
+    if (reader == nullptr)
+        return false;
+
+    block.setSize(static_cast<int>(reader->numChannels), blockSize);
+    return true;
+}
+
+void AudioBlockReader::close()
+{
+    reader.reset();
+    block.setSize(0, 0);
+    position = 0;
+}
+
+double AudioBlockReader::getSampleRate() const
+{
+    return reader != nullptr ? reader->sampleRate : 0.0;
+}
+
+int AudioBlockReader::getNumChannels() const
+{
+    return reader != nullptr ? static_cast<int>(reader->numChannels) : 0;
+}
+
+juce::int64 AudioBlockReader::getTotalLength() const
+{
+    return reader != nullptr ? reader->lengthInSamples : 0;
+}
+
+void AudioBlockReader::setPosition(juce::int64 newPosition)
+{
+    position = juce::jlimit(static_cast<juce::int64>(0), getTotalLength(), newPosition);
+}
+
+int AudioBlockReader::readNextBlock()
+{
+    if (reader == nullptr)
+        return 0;
+
+    const int numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(blockSize),
+                                                       reader->lengthInSamples - position));
+
+    if (numSamples <= 0)
+        return 0;
+
+    reader->read(&block, 0, numSamples, position, true, true);
+    position += numSamples;
+
+    return numSamples;
+}
+
+float AudioBlockReader::getProgress() const
+{
+    const juce::int64 totalLength = getTotalLength();
+
+    if (totalLength <= 0)
+        return 1.0f;
+
+    return static_cast<float>(static_cast<double>(position) / static_cast<double>(totalLength));
+}
+
+} // namespace ForensEQ
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for reading an audio file as a stream of fixed-size blocks
+ *
+ * Only one block is held in memory at a time, so analysis that consumes the blocks
+ * runs in constant memory whatever the file length. Positions are 64-bit, so files
+ * longer than 2^31 samples are read correctly.
+ */
+class AudioBlockReader {
+public:
+    AudioBlockReader(int blockSize = defaultBlockSize);
+    ~AudioBlockReader();
+
+    // Open a file for reading from the start. Returns false if it cannot be decoded
+    bool open(const juce::File& audioFile);
+
+    // Close the current file
+    void close();
+
+    // Check if a file is open
+    bool isOpen() const { return reader != nullptr; }
+
+    // Get the format of the open file
+    double getSampleRate() const;
+    int getNumChannels() const;
+    juce::int64 getTotalLength() const;
+
+    // Get/set the position of the next block, in samples
+    juce::int64 getPosition() const { return position; }
+    void setPosition(juce::int64 newPosition);
+
+    // Read the next block. Returns the number of samples read, which is less than the
+    // block size only for the last block and 0 at the end of the file
+    int readNextBlock();
+
+    // The most recently read block (only the samples reported by readNextBlock are valid)
+    const juce::AudioBuffer<float>& getBlock() const { return block; }
+
+    // Get the fraction of the file read so far (0.0 to 1.0)
+    float getProgress() const;
+
+    // Block size used when none is given
+    static constexpr int defaultBlockSize = 65536;
+
+private:
+    juce::AudioFormatManager formatManager;
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    juce::AudioBuffer<float> block;
+    int blockSize;
+    juce::int64 position = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioBlockReader)
+};
+
+} // namespace ForensEQ
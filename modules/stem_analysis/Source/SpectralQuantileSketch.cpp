@@ -0,0 +1,78 @@
+#include "SpectralQuantileSketch.h"
+
+namespace ForensEQ {
+
+SpectralQuantileSketch::SpectralQuantileSketch(int numBands)
+{
+    reset(numBands);
+}
+
+SpectralQuantileSketch::~SpectralQuantileSketch()
+{
+}
+
+void SpectralQuantileSketch::reset(int newNumBands)
+{
+    numBands = juce::jmax(0, newNumBands);
+    numFrames = 0;
+    counts.assign(static_cast<size_t>(numBands) * numBuckets, 0);
+}
+
+void SpectralQuantileSketch::addFrame(const float* bandLevels)
+{
+    for (int band = 0; band < numBands; ++band)
+    {
+        const int bucket = juce::jlimit(0, numBuckets - 1,
+                                        static_cast<int>((bandLevels[band] - minLevel) / levelStep));
+
+        ++counts[static_cast<size_t>(band) * numBuckets + static_cast<size_t>(bucket)];
+    }
+
+    ++numFrames;
+}
+
+void SpectralQuantileSketch::merge(const SpectralQuantileSketch& other)
+{
+    jassert(other.numBands == numBands);
+
+    if (other.numBands != numBands)
+        return;
+
+    for (size_t i = 0; i < counts.size(); ++i)
+        counts[i] += other.counts[i];
+
+    numFrames += other.numFrames;
+}
+
+void SpectralQuantileSketch::getPercentile(float percentile, std::vector<float>& levels) const
+{
+    levels.assign(static_cast<size_t>(numBands), minLevel);
+
+    if (numFrames == 0)
+        return;
+
+    // Rank of the requested frame, counting from 1
+    const double fraction = juce::jlimit(0.0, 1.0, static_cast<double>(percentile) / 100.0);
+    const juce::int64 rank = juce::jmax(static_cast<juce::int64>(1),
+                                        static_cast<juce::int64>(std::ceil(fraction * static_cast<double>(numFrames))));
+
+    for (int band = 0; band < numBands; ++band)
+    {
+        const juce::uint32* bandCounts = counts.data() + static_cast<size_t>(band) * numBuckets;
+        juce::int64 seen = 0;
+
+        for (int bucket = 0; bucket < numBuckets; ++bucket)
+        {
+            seen += bandCounts[bucket];
+
+            if (seen >= rank)
+            {
+                // Report the middle of the bucket
+                levels[static_cast<size_t>(band)] = minLevel + (static_cast<float>(bucket) + 0.5f) * levelStep;
+                break;
+            }
+        }
+    }
+}
+
+} // namespace ForensEQ
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for estimating per-band level percentiles over time in fixed memory
+ *
+ * Each band keeps a histogram of frame levels in fixed dB steps (equivalent to a
+ * relative-error sketch on power), so memory depends only on the number of bands and
+ * percentiles are accurate to half a step. Counts are integers, so sketches filled on
+ * different threads merge to the same result in any order.
+ */
+class SpectralQuantileSketch {
+public:
+    SpectralQuantileSketch(int numBands = 0);
+    ~SpectralQuantileSketch();
+
+    // Clear all counts and set the number of bands
+    void reset(int numBands);
+
+    // Add one frame of band levels (dB), one value per band
+    void addFrame(const float* bandLevels);
+
+    // Add the counts of another sketch with the same number of bands
+    void merge(const SpectralQuantileSketch& other);
+
+    // Get the level (dB) below which the given percentage (0 to 100) of frames lie, per band
+    void getPercentile(float percentile, std::vector<float>& levels) const;
+
+    int getNumBands() const { return numBands; }
+    juce::int64 getNumFrames() const { return numFrames; }
+
+    // Histogram range and step, in dB. Levels outside the range count in the end buckets
+    static constexpr float minLevel = -200.0f;
+    static constexpr float maxLevel = 60.0f;
+    static constexpr float levelStep = 0.5f;
+    static constexpr int numBuckets = static_cast<int>((maxLevel - minLevel) / levelStep);
+
+private:
+    int numBands = 0;
+    juce::int64 numFrames = 0;
+    std::vector<juce::uint32> counts; // numBuckets per band
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectralQuantileSketch)
+};
+
+} // namespace ForensEQ
@@ -0,0 +1,317 @@
+#include "SpectrogramStore.h"
+
+namespace ForensEQ {
+
+// Power values at or below this floor read as -200 dB
+static constexpr float spectrogramPowerFloor = 1.0e-20f;
+
+// Linear power of every code from 0 to maxCode, spread evenly in dB over the level range
+static std::vector<float> makeCodePowerTable(int maxCode)
+{
+    const float step = (SpectrogramStore::maxLevel - SpectrogramStore::minLevel) / static_cast<float>(maxCode);
+
+    std::vector<float> powers(static_cast<size_t>(maxCode) + 1);
+
+    for (int code = 0; code <= maxCode; ++code)
+        powers[static_cast<size_t>(code)] = std::pow(10.0f, (SpectrogramStore::minLevel + code * step) / 10.0f);
+
+    return powers;
+}
+
+SpectrogramStore::SpectrogramStore(const std::vector<float>& bandFrequencies, double frameRate, Precision precision)
+    : bandFrequencies(bandFrequencies),
+      frameRate(frameRate > 0.0 ? frameRate : 1.0),
+      precision(precision)
+{
+    if (precision == Precision::Bits16)
+    {
+        static const std::vector<float> table16 = makeCodePowerTable(65535);
+        codePowers = &table16;
+        levels16.resize(1);
+    }
+    else
+    {
+        static const std::vector<float> table8 = makeCodePowerTable(255);
+        codePowers = &table8;
+        levels8.resize(1);
+    }
+}
+
+SpectrogramStore::~SpectrogramStore()
+{
+}
+
+void SpectrogramStore::setNumFrames(int newNumFrames)
+{
+    numFrames = juce::jmax(0, newNumFrames);
+    const size_t numValues = static_cast<size_t>(numFrames) * bandFrequencies.size();
+
+    // Any pyramid is out of date now
+    if (precision == Precision::Bits16)
+    {
+        levels16.resize(1);
+        levels16[0].resize(numValues, 0);
+    }
+    else
+    {
+        levels8.resize(1);
+        levels8[0].resize(numValues, 0);
+    }
+}
+
+void SpectrogramStore::setFrame(int frameIndex, const float* bandPowers)
+{
+    jassert(frameIndex >= 0 && frameIndex < numFrames);
+
+    if (frameIndex >= 0 && frameIndex < numFrames)
+        storeNode(0, frameIndex, bandPowers);
+}
+
+void SpectrogramStore::addFrame(const float* bandPowers)
+{
+    setNumFrames(numFrames + 1);
+    storeNode(0, numFrames - 1, bandPowers);
+}
+
+void SpectrogramStore::buildPyramid()
+{
+    const size_t numBands = bandFrequencies.size();
+
+    if (precision == Precision::Bits16)
+        levels16.resize(1);
+    else
+        levels8.resize(1);
+
+    // Each level is averaged from the unquantized level below, so every node is quantized
+    // only once, however high up it is
+    std::vector<float> previous(static_cast<size_t>(numFrames) * numBands);
+
+    for (size_t i = 0; i < previous.size(); ++i)
+        previous[i] = (*codePowers)[precision == Precision::Bits16 ? levels16[0][i] : levels8[0][i]];
+
+    std::vector<float> current;
+
+    for (int numNodes = numFrames / 2, level = 1; numNodes > 0; numNodes /= 2, ++level)
+    {
+        current.resize(static_cast<size_t>(numNodes) * numBands);
+
+        for (int node = 0; node < numNodes; ++node)
+        {
+            const float* first = previous.data() + static_cast<size_t>(node * 2) * numBands;
+            const float* second = first + numBands;
+            float* average = current.data() + static_cast<size_t>(node) * numBands;
+
+            for (size_t band = 0; band < numBands; ++band)
+                average[band] = 0.5f * (first[band] + second[band]);
+        }
+
+        if (precision == Precision::Bits16)
+            levels16.emplace_back(current.size());
+        else
+            levels8.emplace_back(current.size());
+
+        for (int node = 0; node < numNodes; ++node)
+            storeNode(level, node, current.data() + static_cast<size_t>(node) * numBands);
+
+        std::swap(previous, current);
+    }
+}
+
+int SpectrogramStore::timeToFrame(double seconds) const
+{
+    return juce::jlimit(0, juce::jmax(0, numFrames - 1), static_cast<int>(std::floor(seconds * frameRate)));
+}
+
+void SpectrogramStore::getAverage(int startFrame, int endFrame, std::vector<float>& levels) const
+{
+    const int numBands = getNumBands();
+    levels.assign(static_cast<size_t>(numBands), minLevel);
+
+    startFrame = juce::jlimit(0, numFrames, startFrame);
+    endFrame = juce::jlimit(startFrame, numFrames, endFrame);
+
+    if (startFrame == endFrame || numBands == 0)
+        return;
+
+    std::vector<double> sums(static_cast<size_t>(numBands), 0.0);
+    const int topLevel = getNumLevels() - 1;
+
+    // Walk up the pyramid, taking the nodes at the range's ragged ends on each level
+    int first = startFrame;
+    int end = endFrame;
+
+    for (int level = 0; first < end; ++level)
+    {
+        const double weight = static_cast<double>(1 << level);
+
+        // Without a (complete) pyramid, add whatever is left on the highest level there is
+        if (level == topLevel)
+        {
+            for (int node = first; node < end; ++node)
+                addNodePowers(level, node, weight, sums.data());
+
+            break;
+        }
+
+        if ((first & 1) != 0)
+            addNodePowers(level, first++, weight, sums.data());
+
+        if ((end & 1) != 0)
+            addNodePowers(level, --end, weight, sums.data());
+
+        first /= 2;
+        end /= 2;
+    }
+
+    const double numFramesInRange = static_cast<double>(endFrame - startFrame);
+
+    for (int band = 0; band < numBands; ++band)
+        levels[static_cast<size_t>(band)] = 10.0f * std::log10(static_cast<float>(sums[static_cast<size_t>(band)] / numFramesInRange)
+                                                               + spectrogramPowerFloor);
+}
+
+void SpectrogramStore::getAverageForTime(double startSeconds, double endSeconds, std::vector<float>& levels) const
+{
+    const int startFrame = timeToFrame(startSeconds);
+    const int endFrame = juce::jlimit(startFrame + 1, juce::jmax(startFrame + 1, numFrames),
+                                      static_cast<int>(std::ceil(endSeconds * frameRate)));
+
+    getAverage(startFrame, endFrame, levels);
+}
+
+void SpectrogramStore::getColumns(double startSeconds, double endSeconds, int numColumns, std::vector<float>& levels) const
+{
+    const size_t numBands = bandFrequencies.size();
+    numColumns = juce::jmax(0, numColumns);
+    levels.assign(static_cast<size_t>(numColumns) * numBands, minLevel);
+
+    if (numFrames == 0)
+        return;
+
+    const int startFrame = timeToFrame(startSeconds);
+    const int endFrame = juce::jlimit(startFrame + 1, numFrames, static_cast<int>(std::ceil(endSeconds * frameRate)));
+    const juce::int64 rangeLength = endFrame - startFrame;
+
+    std::vector<float> columnLevels;
+
+    for (int column = 0; column < numColumns; ++column)
+    {
+        // With more columns than frames, neighbouring columns show the same frame
+        const int columnStart = startFrame + static_cast<int>(column * rangeLength / numColumns);
+        const int columnEnd = juce::jmax(columnStart + 1, startFrame + static_cast<int>((column + 1) * rangeLength / numColumns));
+
+        getAverage(columnStart, columnEnd, columnLevels);
+        std::copy(columnLevels.begin(), columnLevels.end(), levels.begin() + static_cast<std::ptrdiff_t>(column * numBands));
+    }
+}
+
+void SpectrogramStore::writeToStream(juce::OutputStream& stream) const
+{
+    stream.writeInt(static_cast<int>(bandFrequencies.size()));
+    stream.write(bandFrequencies.data(), sizeof(float) * bandFrequencies.size());
+    stream.writeDouble(frameRate);
+    stream.writeInt(static_cast<int>(precision));
+    stream.writeInt(numFrames);
+
+    if (precision == Precision::Bits16)
+        stream.write(levels16[0].data(), sizeof(juce::uint16) * levels16[0].size());
+    else
+        stream.write(levels8[0].data(), levels8[0].size());
+}
+
+std::unique_ptr<SpectrogramStore> SpectrogramStore::readFromStream(juce::InputStream& stream)
+{
+    // Counts are checked against the bytes left, so corrupt data can't cause a huge allocation
+    auto fitsInStream = [&stream](juce::int64 numBytes)
+    {
+        return numBytes >= 0 && numBytes <= stream.getTotalLength() - stream.getPosition();
+    };
+
+    const int numBands = stream.readInt();
+    if (!fitsInStream(static_cast<juce::int64>(numBands) * static_cast<juce::int64>(sizeof(float))))
+        return nullptr;
+
+    std::vector<float> frequencies(static_cast<size_t>(numBands));
+    const int frequencyBytes = static_cast<int>(sizeof(float)) * numBands;
+    if (stream.read(frequencies.data(), frequencyBytes) != frequencyBytes)
+        return nullptr;
+
+    const double frameRate = stream.readDouble();
+    const int precisionValue = stream.readInt();
+    const int numFrames = stream.readInt();
+
+    if (frameRate <= 0.0 || numFrames < 0
+        || (precisionValue != static_cast<int>(Precision::Bits8) && precisionValue != static_cast<int>(Precision::Bits16)))
+        return nullptr;
+
+    const auto precision = static_cast<Precision>(precisionValue);
+    const juce::int64 numBytes = static_cast<juce::int64>(numFrames) * numBands
+                               * (precision == Precision::Bits16 ? 2 : 1);
+
+    if (!fitsInStream(numBytes))
+        return nullptr;
+
+    auto store = std::make_unique<SpectrogramStore>(frequencies, frameRate, precision);
+    store->setNumFrames(numFrames);
+
+    void* data = precision == Precision::Bits16 ? static_cast<void*>(store->levels16[0].data())
+                                                : static_cast<void*>(store->levels8[0].data());
+
+    if (stream.read(data, static_cast<int>(numBytes)) != static_cast<int>(numBytes))
+        return nullptr;
+
+    store->buildPyramid();
+    return store;
+}
+
+int SpectrogramStore::getMaxCode() const
+{
+    return precision == Precision::Bits16 ? 65535 : 255;
+}
+
+int SpectrogramStore::getNumLevels() const
+{
+    return static_cast<int>(precision == Precision::Bits16 ? levels16.size() : levels8.size());
+}
+
+void SpectrogramStore::storeNode(int level, int node, const float* bandPowers)
+{
+    const int maxCode = getMaxCode();
+    const float codesPerDecibel = static_cast<float>(maxCode) / (maxLevel - minLevel);
+    const size_t numBands = bandFrequencies.size();
+    const size_t offset = static_cast<size_t>(node) * numBands;
+
+    for (size_t band = 0; band < numBands; ++band)
+    {
+        const float decibels = 10.0f * std::log10(bandPowers[band] + spectrogramPowerFloor);
+        const int code = juce::jlimit(0, maxCode, juce::roundToInt((decibels - minLevel) * codesPerDecibel));
+
+        if (precision == Precision::Bits16)
+            levels16[static_cast<size_t>(level)][offset + band] = static_cast<juce::uint16>(code);
+        else
+            levels8[static_cast<size_t>(level)][offset + band] = static_cast<juce::uint8>(code);
+    }
+}
+
+void SpectrogramStore::addNodePowers(int level, int node, double weight, double* sums) const
+{
+    const size_t numBands = bandFrequencies.size();
+    const size_t offset = static_cast<size_t>(node) * numBands;
+
+    if (precision == Precision::Bits16)
+    {
+        const juce::uint16* codes = levels16[static_cast<size_t>(level)].data() + offset;
+
+        for (size_t band = 0; band < numBands; ++band)
+            sums[band] += weight * (*codePowers)[codes[band]];
+    }
+    else
+    {
+        const juce::uint8* codes = levels8[static_cast<size_t>(level)].data() + offset;
+
+        for (size_t band = 0; band < numBands; ++band)
+            sums[band] += weight * (*codePowers)[codes[band]];
+    }
+}
+
+} // namespace ForensEQ
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for keeping band levels over time in compact form
+ *
+ * Each analysis frame is stored as one quantized level per fractional-octave band (8 or 16
+ * bits, dB re full scale² per Hz). On top of the frames sits a pyramid over time: level k
+ * holds the average power of every aligned run of 2^k frames. The average spectrum of any
+ * frame range is made from at most two nodes per level, so it costs O(bands * log frames)
+ * rather than a new FFT pass over the audio. The pyramid roughly doubles the frame storage.
+ *
+ * Frames are filled once (setFrame() from any number of threads, one thread per frame, or
+ * addFrame() in order), then buildPyramid() is called. The store is read-only after that and
+ * can be shared between threads.
+ */
+class SpectrogramStore {
+public:
+    // Bits per stored level: 8 bits gives ~0.7 dB steps, 16 bits ~0.003 dB
+    enum class Precision {
+        Bits8,
+        Bits16
+    };
+
+    // bandFrequencies are the band centres; frameRate is frames per second (sample rate / hop size)
+    SpectrogramStore(const std::vector<float>& bandFrequencies, double frameRate,
+                     Precision precision = Precision::Bits8);
+    ~SpectrogramStore();
+
+    // Resize to numFrames silent frames, e.g. before filling them with setFrame()
+    void setNumFrames(int numFrames);
+
+    // Store the band powers (linear PSD, one per band) of an existing frame
+    void setFrame(int frameIndex, const float* bandPowers);
+
+    // Append a frame of band powers
+    void addFrame(const float* bandPowers);
+
+    // Rebuild the time pyramid from the frames. Call once all frames are in
+    void buildPyramid();
+
+    int getNumFrames() const { return numFrames; }
+    int getNumBands() const { return static_cast<int>(bandFrequencies.size()); }
+    const std::vector<float>& getBandFrequencies() const { return bandFrequencies; }
+    double getFrameRate() const { return frameRate; }
+    Precision getPrecision() const { return precision; }
+
+    // Get the time covered by the frames, in seconds
+    double getDuration() const { return numFrames / frameRate; }
+
+    // Get the frame containing the given time, clamped to the stored frames
+    int timeToFrame(double seconds) const;
+
+    // Get the average level (dB) of each band over frames [startFrame, endFrame)
+    void getAverage(int startFrame, int endFrame, std::vector<float>& levels) const;
+
+    // Same as above for a time range in seconds; always covers at least one frame
+    void getAverageForTime(double startSeconds, double endSeconds, std::vector<float>& levels) const;
+
+    // Split a time range into numColumns equal columns and get each column's average levels,
+    // column after column (numColumns * getNumBands() values), e.g. to draw a spectrogram
+    void getColumns(double startSeconds, double endSeconds, int numColumns, std::vector<float>& levels) const;
+
+    // Write the frames to a stream; the pyramid is rebuilt on reading
+    void writeToStream(juce::OutputStream& stream) const;
+
+    // Read a store written by writeToStream(). Returns nullptr if the data is invalid
+    static std::unique_ptr<SpectrogramStore> readFromStream(juce::InputStream& stream);
+
+    // Range of stored levels, in dB. Levels outside the range are clamped
+    static constexpr float minLevel = -160.0f;
+    static constexpr float maxLevel = 20.0f;
+
+private:
+    std::vector<float> bandFrequencies;
+    double frameRate;
+    Precision precision;
+    int numFrames = 0;
+
+    // Quantized levels, one vector per pyramid level (level 0 holds the frames). Only the
+    // vectors matching the precision are used
+    std::vector<std::vector<juce::uint8>> levels8;
+    std::vector<std::vector<juce::uint16>> levels16;
+
+    // Linear power of every code, shared by all stores of the same precision
+    const std::vector<float>* codePowers;
+
+    // Helper methods
+    int getMaxCode() const;
+    int getNumLevels() const;
+    void storeNode(int level, int node, const float* bandPowers);
+    void addNodePowers(int level, int node, double weight, double* sums) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrogramStore)
+};
+
+} // namespace ForensEQ
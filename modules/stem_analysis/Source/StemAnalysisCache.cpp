@@ -0,0 +1,383 @@
+#include "StemAnalysisCache.h"
+
+namespace ForensEQ {
+
+// Marks the start of an on-disk entry ("FQST")
+static constexpr int stemCacheMagic = 0x46515354;
+
+StemAnalysisCache::StemAnalysisCache()
+{
+    cacheDirectory = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                        .getChildFile("ForensEQ")
+                        .getChildFile("AnalysisCache")
+                        .getChildFile("Stems");
+}
+
+StemAnalysisCache::~StemAnalysisCache()
+{
+}
+
+juce::String StemAnalysisCache::createKey(const juce::AudioBuffer<float>& buffer, double sampleRate,
+                                          const juce::String& settings)
+{
+    KeyBuilder builder(sampleRate, buffer.getNumChannels(), settings);
+    builder.addBlock(buffer, 0, buffer.getNumSamples());
+    return builder.getKey();
+}
+
+bool StemAnalysisCache::lookup(const juce::String& key, std::map<StemType, std::unique_ptr<StemData>>& stems)
+{
+    std::shared_ptr<const Entry> entry;
+    juce::File file;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        // Memory tier
+        auto it = memoryEntries.find(key);
+        if (it != memoryEntries.end())
+        {
+            entry = it->second;
+
+            // Mark as most recently used
+            recentKeys.removeString(key);
+            recentKeys.add(key);
+        }
+        else
+        {
+            file = getFileForKey(key);
+        }
+    }
+
+    if (entry == nullptr)
+    {
+        // Disk tier, read without holding the lock; only the insert takes it
+        if (file == juce::File() || !file.existsAsFile())
+            return false;
+
+        entry = readEntry(file);
+        if (entry == nullptr)
+            return false;
+
+        // Keep recently used entries from being pruned
+        file.setLastModificationTime(juce::Time::getCurrentTime());
+
+        const juce::ScopedLock sl(lock);
+        addToMemory(key, entry);
+    }
+
+    for (const auto& result : *entry)
+    {
+        auto stem = std::make_unique<StemData>(result.type);
+        stem->setFrequencyData(result.frequencies, result.magnitudes);
+        stem->setFrequencyPercentiles(result.percentiles, result.percentileMagnitudes);
+        stem->setSpectrogram(result.spectrogram);
+        stem->setLUFS(result.lufs);
+        stem->setRMS(result.rms);
+        stem->setWidth(result.width);
+        stems[result.type] = std::move(stem);
+    }
+
+    return true;
+}
+
+void StemAnalysisCache::store(const juce::String& key, const std::map<StemType, std::unique_ptr<StemData>>& stems)
+{
+    auto entry = std::make_shared<Entry>();
+
+    for (const auto& pair : stems)
+    {
+        if (pair.second == nullptr)
+            continue;
+
+        StemResult result;
+        result.type = pair.first;
+        pair.second->getFrequencyData(result.frequencies, result.magnitudes);
+        pair.second->getFrequencyPercentiles(result.percentiles, result.percentileMagnitudes);
+        result.percentileMagnitudes.resize(result.percentiles.size());
+        result.spectrogram = pair.second->getSpectrogram();
+        result.lufs = pair.second->getLUFS();
+        result.rms = pair.second->getRMS();
+        result.width = pair.second->getWidth();
+        entry->push_back(std::move(result));
+    }
+
+    juce::File file;
+
+    {
+        // Only the memory tier is updated under the lock; the file is written after releasing it
+        const juce::ScopedLock sl(lock);
+        addToMemory(key, entry);
+        file = getFileForKey(key);
+    }
+
+    if (file == juce::File() || !file.getParentDirectory().createDirectory())
+        return;
+
+    if (writeEntry(file, *entry))
+    {
+        const juce::ScopedLock sl(lock);
+        pruneDiskEntries();
+    }
+}
+
+void StemAnalysisCache::setCacheDirectory(const juce::File& directory)
+{
+    const juce::ScopedLock sl(lock);
+    cacheDirectory = directory;
+}
+
+juce::File StemAnalysisCache::getCacheDirectory() const
+{
+    const juce::ScopedLock sl(lock);
+    return cacheDirectory;
+}
+
+void StemAnalysisCache::setMaxMemoryEntries(int maxEntries)
+{
+    const juce::ScopedLock sl(lock);
+    maxMemoryEntries = juce::jmax(1, maxEntries);
+
+    while (recentKeys.size() > maxMemoryEntries)
+    {
+        memoryEntries.erase(recentKeys[0]);
+        recentKeys.remove(0);
+    }
+}
+
+void StemAnalysisCache::setMaxDiskEntries(int maxEntries)
+{
+    const juce::ScopedLock sl(lock);
+    maxDiskEntries = juce::jmax(0, maxEntries);
+    pruneDiskEntries();
+}
+
+void StemAnalysisCache::clear(bool includeDisk)
+{
+    const juce::ScopedLock sl(lock);
+
+    memoryEntries.clear();
+    recentKeys.clear();
+
+    if (includeDisk && cacheDirectory.isDirectory())
+    {
+        for (const auto& file : cacheDirectory.findChildFiles(juce::File::findFiles, false, "*.stems"))
+            file.deleteFile();
+    }
+}
+
+void StemAnalysisCache::addToMemory(const juce::String& key, std::shared_ptr<const Entry> entry)
+{
+    memoryEntries[key] = std::move(entry);
+
+    recentKeys.removeString(key);
+    recentKeys.add(key);
+
+    // Evict the least recently used entries
+    while (recentKeys.size() > maxMemoryEntries)
+    {
+        memoryEntries.erase(recentKeys[0]);
+        recentKeys.remove(0);
+    }
+}
+
+juce::File StemAnalysisCache::getFileForKey(const juce::String& key) const
+{
+    if (cacheDirectory == juce::File())
+        return {};
+
+    return cacheDirectory.getChildFile(key + ".stems");
+}
+
+bool StemAnalysisCache::writeEntry(const juce::File& file, const Entry& entry) const
+{
+    // Write to a temporary file and swap it in, so readers never see a partial entry
+    juce::TemporaryFile temporaryFile(file);
+
+    {
+        juce::FileOutputStream stream(temporaryFile.getFile());
+        if (!stream.openedOk())
+            return false;
+
+        stream.writeInt(stemCacheMagic);
+        stream.writeInt(analysisVersion);
+        stream.writeInt(static_cast<int>(entry.size()));
+
+        for (const auto& result : entry)
+        {
+            stream.writeInt(static_cast<int>(result.type));
+            stream.writeFloat(result.lufs);
+            stream.writeFloat(result.rms);
+            stream.writeFloat(result.width);
+
+            stream.writeInt(static_cast<int>(result.frequencies.size()));
+            stream.write(result.frequencies.data(), sizeof(float) * result.frequencies.size());
+            stream.writeInt(static_cast<int>(result.magnitudes.size()));
+            stream.write(result.magnitudes.data(), sizeof(float) * result.magnitudes.size());
+            
+            stream.writeInt(static_cast<int>(result.percentiles.size()));
+            stream.write(result.percentiles.data(), sizeof(float) * result.percentiles.size());
+            
+            for (const auto& levels : result.percentileMagnitudes)
+            {
+                stream.writeInt(static_cast<int>(levels.size()));
+                stream.write(levels.data(), sizeof(float) * levels.size());
+            }
+            
+            stream.writeBool(result.spectrogram != nullptr);
+            
+            if (result.spectrogram != nullptr)
+                result.spectrogram->writeToStream(stream);
+        }
+
+        stream.flush();
+    }
+
+    return temporaryFile.overwriteTargetFileWithTemporary();
+}
+
+std::shared_ptr<const StemAnalysisCache::Entry> StemAnalysisCache::readEntry(const juce::File& file) const
+{
+    juce::FileInputStream stream(file);
+    if (!stream.openedOk())
+        return nullptr;
+
+    if (stream.readInt() != stemCacheMagic || stream.readInt() != analysisVersion)
+        return nullptr;
+
+    // Every count read from the file is checked against the bytes left, so a truncated
+    // or corrupt entry is rejected rather than causing a huge allocation
+    auto fitsInStream = [&stream](juce::int64 numFloats)
+    {
+        return numFloats >= 0
+            && numFloats * static_cast<juce::int64>(sizeof(float)) <= stream.getTotalLength() - stream.getPosition();
+    };
+
+    auto readFloats = [&stream, &fitsInStream](std::vector<float>& values)
+    {
+        const int count = stream.readInt();
+        if (!fitsInStream(count))
+            return false;
+
+        values.resize(static_cast<size_t>(count));
+        const int numBytes = static_cast<int>(sizeof(float)) * count;
+        return stream.read(values.data(), numBytes) == numBytes;
+    };
+
+    const int numStems = stream.readInt();
+    if (numStems < 0 || numStems > static_cast<int>(StemType::Full) + 1)
+        return nullptr;
+
+    auto entry = std::make_shared<Entry>();
+
+    for (int i = 0; i < numStems; ++i)
+    {
+        StemResult result;
+
+        const int type = stream.readInt();
+        if (type < 0 || type > static_cast<int>(StemType::Full))
+            return nullptr;
+
+        result.type = static_cast<StemType>(type);
+        result.lufs = stream.readFloat();
+        result.rms = stream.readFloat();
+        result.width = stream.readFloat();
+
+        if (!readFloats(result.frequencies) || !readFloats(result.magnitudes) || !readFloats(result.percentiles))
+            return nullptr;
+        
+        result.percentileMagnitudes.resize(result.percentiles.size());
+        
+        for (auto& levels : result.percentileMagnitudes)
+        {
+            if (!readFloats(levels))
+                return nullptr;
+        }
+        
+        if (stream.readBool())
+        {
+            result.spectrogram = SpectrogramStore::readFromStream(stream);
+            if (result.spectrogram == nullptr)
+                return nullptr;
+        }
+
+        entry->push_back(std::move(result));
+    }
+
+    return entry;
+}
+
+void StemAnalysisCache::pruneDiskEntries()
+{
+    if (!cacheDirectory.isDirectory())
+        return;
+
+    auto files = cacheDirectory.findChildFiles(juce::File::findFiles, false, "*.stems");
+
+    // Oldest first
+    std::sort(files.begin(), files.end(), [](const juce::File& a, const juce::File& b)
+    {
+        return a.getLastModificationTime() < b.getLastModificationTime();
+    });
+
+    for (int i = 0; i < files.size() - maxDiskEntries; ++i)
+        files.getReference(i).deleteFile();
+}
+
+//==============================================================================
+StemAnalysisCache::KeyBuilder::KeyBuilder(double sampleRate, int numChannels, const juce::String& settings)
+    : chunk(juce::jmax(0, numChannels), chunkSize)
+{
+    // The format, settings and analysis version are hashed with the samples so any of
+    // them changing gives a different key
+    keyData.writeInt(analysisVersion);
+    keyData.writeDouble(sampleRate);
+    keyData.writeInt(numChannels);
+    keyData << settings;
+}
+
+void StemAnalysisCache::KeyBuilder::addBlock(const juce::AudioBuffer<float>& block, int startSample, int numSamples)
+{
+    const int numChannels = juce::jmin(chunk.getNumChannels(), block.getNumChannels());
+
+    while (numSamples > 0)
+    {
+        const int toCopy = juce::jmin(numSamples, chunkSize - chunkFill);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            chunk.copyFrom(channel, chunkFill, block, channel, startSample, toCopy);
+
+        chunkFill += toCopy;
+        startSample += toCopy;
+        numSamples -= toCopy;
+        totalSamples += toCopy;
+
+        if (chunkFill == chunkSize)
+            hashChunk();
+    }
+}
+
+juce::String StemAnalysisCache::KeyBuilder::getKey()
+{
+    if (chunkFill > 0)
+        hashChunk();
+
+    juce::MemoryOutputStream finalData;
+    finalData.write(keyData.getData(), keyData.getDataSize());
+    finalData.writeInt64(totalSamples);
+
+    return juce::MD5(finalData.getData(), finalData.getDataSize()).toHexString();
+}
+
+void StemAnalysisCache::KeyBuilder::hashChunk()
+{
+    for (int channel = 0; channel < chunk.getNumChannels(); ++channel)
+    {
+        juce::MD5 channelHash(chunk.getReadPointer(channel), sizeof(float) * static_cast<size_t>(chunkFill));
+        keyData << channelHash.toHexString();
+    }
+
+    chunkFill = 0;
+}
+
+} // namespace ForensEQ
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "StemData.h"
+
+namespace ForensEQ {
+
+/**
+ * Class for caching the analysis of isolated reference stems
+ *
+ * Entries are keyed by a hash of the decoded reference audio plus the isolator and
+ * analyzer settings, so loading a known reference again skips analysis. Only analysis
+ * results are cached (spectra, spectrograms and levels), never stem audio, so entries stay
+ * small; stems restored from the cache have no audio. The few most recently used entries
+ * are kept in memory; every entry is also written to a binary file so it survives restarts.
+ *
+ * All methods are thread-safe.
+ */
+class StemAnalysisCache {
+public:
+    StemAnalysisCache();
+    ~StemAnalysisCache();
+
+    // The cached results for one stem
+    struct StemResult {
+        StemType type = StemType::Full;
+        std::vector<float> frequencies;
+        std::vector<float> magnitudes;
+        std::vector<float> percentiles;
+        std::vector<std::vector<float>> percentileMagnitudes;
+        std::shared_ptr<const SpectrogramStore> spectrogram;
+        float lufs = -70.0f;
+        float rms = 0.0f;
+        float width = 0.0f;
+    };
+
+    using Entry = std::vector<StemResult>;
+
+    /**
+     * Builds a cache key from audio that arrives in blocks of any size. settings should
+     * describe everything else that affects the results, e.g. isolator and FFT setup
+     */
+    class KeyBuilder {
+    public:
+        KeyBuilder(double sampleRate, int numChannels, const juce::String& settings);
+
+        // Hash the next numSamples samples of block, starting at startSample
+        void addBlock(const juce::AudioBuffer<float>& block, int startSample, int numSamples);
+
+        // Get the key for all audio added so far
+        juce::String getKey();
+
+    private:
+        // Samples are hashed in fixed-size chunks so the key does not depend on how the
+        // audio was split into blocks
+        static constexpr int chunkSize = 65536;
+
+        juce::MemoryOutputStream keyData;
+        juce::AudioBuffer<float> chunk;
+        int chunkFill = 0;
+        juce::int64 totalSamples = 0;
+
+        void hashChunk();
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(KeyBuilder)
+    };
+
+    // Build the cache key for a whole buffer (reads every sample once)
+    static juce::String createKey(const juce::AudioBuffer<float>& buffer, double sampleRate,
+                                  const juce::String& settings);
+
+    // Look up an entry in memory, then on disk, and fill stems from it (without audio).
+    // Returns false on a miss
+    bool lookup(const juce::String& key, std::map<StemType, std::unique_ptr<StemData>>& stems);
+
+    // Store the analysis of the given stems in memory and on disk
+    void store(const juce::String& key, const std::map<StemType, std::unique_ptr<StemData>>& stems);
+
+    // Set/get the directory for the on-disk tier (an invalid File disables it)
+    void setCacheDirectory(const juce::File& directory);
+    juce::File getCacheDirectory() const;
+
+    // Set the number of entries kept in memory and on disk
+    void setMaxMemoryEntries(int maxEntries);
+    void setMaxDiskEntries(int maxEntries);
+
+    // Remove all entries from memory, and optionally from disk
+    void clear(bool includeDisk = false);
+
+    // Bump whenever isolation or analysis changes in a way that alters results
+    static constexpr int analysisVersion = 7;
+
+private:
+    // Memory tier, with keys ordered from least to most recently used
+    std::map<juce::String, std::shared_ptr<const Entry>> memoryEntries;
+    juce::StringArray recentKeys;
+    int maxMemoryEntries = 4;
+    int maxDiskEntries = 16;
+
+    juce::File cacheDirectory;
+    juce::CriticalSection lock;
+
+    // Helper methods
+    void addToMemory(const juce::String& key, std::shared_ptr<const Entry> entry);
+    juce::File getFileForKey(const juce::String& key) const;
+    bool writeEntry(const juce::File& file, const Entry& entry) const;
+    std::shared_ptr<const Entry> readEntry(const juce::File& file) const;
+    void pruneDiskEntries();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StemAnalysisCache)
+};
+
+} // namespace ForensEQ
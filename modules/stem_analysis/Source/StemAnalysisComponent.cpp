@@ -8,21 +8,35 @@ StemAnalysisComponent::StemAnalysisComponent()
     addAndMakeVisible(stemSelector);
     addAndMakeVisible(stemInfo);
     
+    // Follow reference loads so progress can be shown
+    stemManager.addListener(this);
+    
     // Set size
     setSize(800, 400);
 }
 
 StemAnalysisComponent::~StemAnalysisComponent()
 {
+    stemManager.removeListener(this);
 }
 
 void StemAnalysisComponent::paint(juce::Graphics& g)
 {
     g.fillAll(backgroundColor);
     
-    // If no reference track is loaded, show instructions
-    if (stemManager.getNumLoadedStems() == 0)
+    // While a reference is loading, show which stage it is in
+    if (stemManager.isLoading())
     {
+        const int percent = juce::roundToInt(stemManager.getLoadProgress() * 100.0f);
+        
+        g.setColour(textColor);
+        g.setFont(16.0f);
+        g.drawText(getLoadStageText(stemManager.getLoadStage()) + " " + juce::String(percent) + "%",
+                  getLocalBounds().removeFromBottom(40), juce::Justification::centred);
+    }
+    else if (stemManager.getNumLoadedStems() == 0)
+    {
+        // If no reference track is loaded, show instructions
         g.setColour(textColor);
         g.setFont(16.0f);
         g.drawText("Drag and drop an audio file to analyze stems",
@@ -81,7 +95,35 @@ void StemAnalysisComponent::filesDropped(const juce::StringArray& files, int x,
 
 bool StemAnalysisComponent::loadReferenceTrack(const juce::File& file)
 {
-    return stemManager.loadReferenceTrack(file);
+    if (!file.existsAsFile())
+        return false;
+    
+    // Decoding, isolation and analysis run on the stem manager's loader thread
+    stemManager.loadReferenceTrackAsync(file);
+    return true;
+}
+
+void StemAnalysisComponent::referenceLoadProgressChanged(StemManager& manager, StemManager::LoadStage stage, float progress)
+{
+    juce::ignoreUnused(manager, stage, progress);
+    repaint();
+}
+
+juce::String StemAnalysisComponent::getLoadStageText(StemManager::LoadStage stage)
+{
+    switch (stage)
+    {
+        case StemManager::LoadStage::Decoding:
+            return "Decoding reference...";
+        case StemManager::LoadStage::AnalyzingFullMix:
+            return "Analyzing full mix...";
+        case StemManager::LoadStage::Isolating:
+            return "Isolating stems...";
+        case StemManager::LoadStage::AnalyzingStems:
+            return "Analyzing stems...";
+        default:
+            return {};
+    }
 }
 
 StemType StemAnalysisComponent::getSelectedStemType() const
@@ -11,7 +11,8 @@ namespace ForensEQ {
  * Main component for the stem analysis module that integrates all UI elements
  */
 class StemAnalysisComponent : public juce::Component,
-                             public juce::FileDragAndDropTarget
+                             public juce::FileDragAndDropTarget,
+                             private StemManager::Listener
 {
 public:
     StemAnalysisComponent();
@@ -27,7 +28,8 @@ public:
     // Get the stem manager
     StemManager& getStemManager() { return stemManager; }
     
-    // Load a reference track
+    // Start loading a reference track in the background, replacing any load in progress.
+    // Returns false if the file does not exist
     bool loadReferenceTrack(const juce::File& file);
     
     // Get the currently selected stem type
@@ -42,6 +44,12 @@ private:
     StemSelectorComponent stemSelector{stemManager};
     StemInfoComponent stemInfo{stemManager};
     
+    // StemManager::Listener implementation
+    void referenceLoadProgressChanged(StemManager& manager, StemManager::LoadStage stage, float progress) override;
+    
+    // Get the text shown for a reference load stage
+    static juce::String getLoadStageText(StemManager::LoadStage stage);
+    
     // UI colors
     juce::Colour backgroundColor = juce::Colour(30, 30, 30);
     juce::Colour textColor = juce::Colour(220, 220, 220);
@@ -1,4 +1,5 @@
 #include "StemAnalyzer.h"
+#include "ParallelJobs.h"
 
 namespace ForensEQ {
 
@@ -13,94 +14,409 @@ StemAnalyzer::~StemAnalyzer()
 bool StemAnalyzer::analyzeStem(StemData& stem)
 {
     if (!stem.hasValidAudio())
-        return false;
+    {
+        if (!stem.hasAudioSource())
+            return false;
+        
+        AudioBlockReader reader;
+        return reader.open(stem.getAudioSourceFile()) && analyzeStream(reader, stem, stem.getAudioSourceGain());
+    }
     
+    // The stream analyzes its frames in parallel batches, so audio in memory takes the same
+    // path as audio read from a file
     const auto& audioBuffer = stem.getAudioBuffer();
     
-    // Prepare FFT data
-    juce::dsp::FFT fft(static_cast<int>(std::log2(fftSize)));
+    Stream stream(*this, audioBuffer.getNumChannels(), sampleRate);
+    stream.process(audioBuffer, audioBuffer.getNumSamples());
+    stream.finish(stem);
+    
+    return true;
+}
+
+bool StemAnalyzer::analyzeStream(AudioBlockReader& reader, StemData& stem, float gain)
+{
+    if (!reader.isOpen() || reader.getTotalLength() <= 0)
+        return false;
+    
+    Stream stream(*this, reader.getNumChannels(), reader.getSampleRate());
     
-    // Create window and FFT buffers
-    std::vector<float> windowBuffer(fftSize, 0.0f);
-    std::vector<float> fftBuffer(fftSize * 2, 0.0f); // Complex data (real/imag pairs)
+    // Scaled copy of each block, when there is a gain to apply
+    juce::AudioBuffer<float> scaledBlock;
+    if (gain != 1.0f)
+        scaledBlock.setSize(reader.getBlock().getNumChannels(), reader.getBlock().getNumSamples());
     
-    // Number of FFT frames to analyze
-    int numSamples = audioBuffer.getNumSamples();
-    int numFrames = numSamples / (fftSize / 2) - 1;
-    numFrames = juce::jmax(1, numFrames);
+    for (int numSamples = reader.readNextBlock(); numSamples > 0; numSamples = reader.readNextBlock())
+    {
+        if (gain == 1.0f)
+        {
+            stream.process(reader.getBlock(), numSamples);
+            continue;
+        }
+        
+        for (int channel = 0; channel < scaledBlock.getNumChannels(); ++channel)
+            scaledBlock.copyFrom(channel, 0, reader.getBlock().getReadPointer(channel), numSamples, gain);
+        
+        stream.process(scaledBlock, numSamples);
+    }
+    
+    stream.finish(stem);
+    
+    return true;
+}
+
+//==============================================================================
+StemAnalyzer::Stream::Stream(StemAnalyzer& analyzer, int numChannels, double sampleRate)
+    : analyzer(analyzer),
+      plan(analyzer.getAnalysisPlan()),
+      spectrumMode(analyzer.getSpectrumMode()),
+      percentiles(analyzer.getPercentiles()),
+      numChannels(juce::jmax(1, numChannels)),
+      fftSize(plan->fftSize),
+      hopSize(fftSize / 2),
+      numBins(fftSize / 2 + 1),
+      framesPerBatch(framesPerChunk * 2 * (analyzer.threadPool->getNumThreads() + 1))
+{
+    bandMap = SpectralBandMap::getShared(sampleRate, fftSize, analyzer.getBandLayout());
+    
+    if (!percentiles.empty())
+        sketch = std::make_unique<SpectralQuantileSketch>(bandMap->getNumBands());
+    
+    if (analyzer.isSpectrogramEnabled())
+    {
+        spectrogramMap = SpectralBandMap::getShared(sampleRate, fftSize, analyzer.getSpectrogramLayout());
+        spectrogram = std::make_unique<SpectrogramStore>(spectrogramMap->getBandFrequencies(),
+                                                         spectrogramMap->getSampleRate() / hopSize,
+                                                         analyzer.getSpectrogramPrecision());
+    }
     
-    // Frequency resolution
-    float sampleRate = 44100.0f; // Assuming 44.1kHz, would be retrieved from actual audio
-    float freqResolution = sampleRate / fftSize;
+    // Room for a batch of frames at 50% overlap
+    monoSamples.assign(static_cast<size_t>(framesPerBatch + 1) * static_cast<size_t>(hopSize), 0.0f);
+    
+    // We're only interested in the first half of the FFT output (DC up to Nyquist frequency)
+    magnitudeTotals.assign(static_cast<size_t>(numBins), 0.0);
+    
+    loudnessMeter.prepare(sampleRate, this->numChannels);
+}
+
+StemAnalyzer::Stream::~Stream()
+{
+}
+
+void StemAnalyzer::Stream::process(const juce::AudioBuffer<float>& block, int numSamples)
+{
+    const int channelsInBlock = juce::jmin(numChannels, block.getNumChannels());
+    
+    loudnessMeter.processBlock(block, 0, numSamples);
+    
+    // Level and width sums
+    for (int channel = 0; channel < channelsInBlock; ++channel)
+    {
+        const float* data = block.getReadPointer(channel);
+        
+        for (int i = 0; i < numSamples; ++i)
+            sumSquares += static_cast<double>(data[i]) * data[i];
+    }
+    
+    if (channelsInBlock >= 2)
+    {
+        const float* left = block.getReadPointer(0);
+        const float* right = block.getReadPointer(1);
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            sumLeftSquared += static_cast<double>(left[i]) * left[i];
+            sumRightSquared += static_cast<double>(right[i]) * right[i];
+            sumLeftRight += static_cast<double>(left[i]) * right[i];
+        }
+    }
+    
+    numSamplesProcessed += numSamples;
+    
+    // Spectrum: mix down until a batch of frames is complete, analyze it, then keep the last
+    // half frame, where the next frame starts (50% overlap)
+    const int windowSize = static_cast<int>(monoSamples.size());
+    
+    for (int position = 0; position < numSamples;)
+    {
+        const int toCopy = juce::jmin(numSamples - position, windowSize - monoFill);
+        
+        // Average the channels
+        mixToMono(block, position, numChannels, monoSamples.data() + monoFill, toCopy);
+        
+        monoFill += toCopy;
+        position += toCopy;
+        
+        if (monoFill == windowSize)
+        {
+            analyzeFrames(framesPerBatch, fftSize);
+            
+            std::copy(monoSamples.end() - hopSize, monoSamples.end(), monoSamples.begin());
+            monoFill = hopSize;
+        }
+    }
+}
+        
+void StemAnalyzer::Stream::finish(StemData& stem)
+{
+    // Complete frames left over from the last batch. Audio shorter than one frame is
+    // analyzed as a single zero-padded frame
+    const int numRemainingFrames = monoFill >= fftSize ? (monoFill - fftSize) / hopSize + 1 : 0;
+    
+    if (numRemainingFrames > 0)
+        analyzeFrames(numRemainingFrames, fftSize);
+    else if (numFrames == 0)
+        analyzeFrames(1, monoFill);
+    
+    // Average per bin, then reduce to the band layout in one pass
+    std::vector<float> binAverages(static_cast<size_t>(numBins), 0.0f);
+    
+    if (numFrames > 0)
+    {
+        for (int i = 0; i < numBins; ++i)
+            binAverages[static_cast<size_t>(i)] = static_cast<float>(magnitudeTotals[static_cast<size_t>(i)] / numFrames);
+    }
     
-    // Prepare frequency and magnitude vectors
-    std::vector<float> frequencies;
     std::vector<float> magnitudes;
     
-    // We're only interested in the first half of the FFT output (up to Nyquist frequency)
-    for (int i = 0; i < fftSize / 2; ++i)
+    if (spectrumMode == SpectrumMode::WelchPSD)
+    {
+        // Band power is averaged linearly too; each band is converted to dB exactly once
+        scaleToDensity(binAverages.data(), numBins,
+                       static_cast<float>(1.0 / (bandMap->getSampleRate() * plan->windowPowerSum)));
+        bandMap->mapBins(binAverages, magnitudes);
+        
+        for (auto& magnitude : magnitudes)
+            magnitude = 10.0f * std::log10(magnitude + powerFloor);
+    }
+    else
     {
-        frequencies.push_back(i * freqResolution);
-        magnitudes.push_back(0.0f);
+        bandMap->mapBins(binAverages, magnitudes);
     }
     
-    // Process each frame
-    for (int frame = 0; frame < numFrames; ++frame)
+    // Set the frequency data to the stem
+    stem.setFrequencyData(bandMap->getBandFrequencies(), magnitudes);
+    
+    if (sketch != nullptr)
     {
-        // Get the start sample for this frame (with 50% overlap)
-        int startSample = frame * (fftSize / 2);
+        std::vector<std::vector<float>> percentileMagnitudes(percentiles.size());
         
-        // Clear the FFT buffer
-        std::fill(fftBuffer.begin(), fftBuffer.end(), 0.0f);
+        for (size_t i = 0; i < percentiles.size(); ++i)
+            sketch->getPercentile(percentiles[i], percentileMagnitudes[i]);
         
-        // Copy audio data to the FFT buffer (averaging channels)
-        for (int channel = 0; channel < audioBuffer.getNumChannels(); ++channel)
+        stem.setFrequencyPercentiles(percentiles, percentileMagnitudes);
+    }
+    
+    if (spectrogram != nullptr)
+    {
+        spectrogram->buildPyramid();
+        stem.setSpectrogram(std::move(spectrogram));
+    }
+    
+    // LUFS, RMS and width, computed as in calculateLUFS(), calculateRMS() and calculateWidth()
+    const double numValues = static_cast<double>(numSamplesProcessed) * numChannels;
+    const float rms = numValues > 0.0 ? static_cast<float>(std::sqrt(sumSquares / numValues)) : 0.0f;
+    
+    stem.setLUFS(loudnessMeter.getIntegratedLoudness());
+    stem.setRMS(rms);
+    
+    // Need at least stereo for width calculation
+    float width = 0.0f;
+    if (numChannels >= 2)
+    {
+        float correlation = 0.0f;
+        if (sumLeftSquared > 0.0 && sumRightSquared > 0.0)
         {
-            const float* channelData = audioBuffer.getReadPointer(channel);
+            correlation = static_cast<float>(sumLeftRight / (std::sqrt(sumLeftSquared) * std::sqrt(sumRightSquared)));
+        }
+        
+        // Invert so that 1.0 = wide, 0.0 = mono
+        width = 1.0f - std::abs(correlation);
+    }
+    
+    stem.setWidth(width);
+}
+
+void StemAnalyzer::Stream::analyzeFrames(int numBatchFrames, int frameLength)
+{
+    const int numChunks = (numBatchFrames + framesPerChunk - 1) / framesPerChunk;
+    const int firstFrame = numFrames;
+    
+    chunkSums.assign(static_cast<size_t>(numChunks) * static_cast<size_t>(numBins), 0.0f);
+    
+    // Every frame has its own slot in the spectrogram, so threads can fill it without locking
+    if (spectrogram != nullptr)
+        spectrogram->setNumFrames(firstFrame + numBatchFrames);
+    
+    std::atomic<int> nextChunk { 0 };
+    
+    auto analyzeRemainingChunks = [this, &nextChunk, numChunks, numBatchFrames, frameLength, firstFrame]
+    {
+        // Scratch space and sketch for this thread, reused from earlier analyses
+        FrameAnalyzer frameAnalyzer(analyzer, *plan, *bandMap, spectrumMode, spectrogramMap.get());
+        float* spectrogramPowers = frameAnalyzer.getSpectrogramPowers();
+        SpectralQuantileSketch* threadSketch = sketch != nullptr ? &frameAnalyzer.getThreadSketch() : nullptr;
+        
+        for (int chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++)
+        {
+            float* sums = chunkSums.data() + static_cast<size_t>(chunk) * static_cast<size_t>(numBins);
+            const int chunkStart = chunk * framesPerChunk;
+            const int chunkEnd = juce::jmin(numBatchFrames, chunkStart + framesPerChunk);
             
-            for (int i = 0; i < fftSize; ++i)
+            for (int frame = chunkStart; frame < chunkEnd; ++frame)
             {
-                if (startSample + i < numSamples)
-                {
-                    // Add to real part (even indices)
-                    fftBuffer[i * 2] += channelData[startSample + i] / audioBuffer.getNumChannels();
-                }
+                frameAnalyzer.addFrame(monoSamples.data() + static_cast<size_t>(frame) * static_cast<size_t>(hopSize),
+                                       frameLength, sums, threadSketch, spectrogramPowers);
+                
+                if (spectrogram != nullptr)
+                    spectrogram->setFrame(firstFrame + frame, spectrogramPowers);
             }
         }
         
-        // Apply window function
-        applyWindow(fftBuffer.data(), fftSize);
+        // Sketch counts are integers, so the merge order doesn't matter
+        if (threadSketch != nullptr && threadSketch->getNumFrames() > 0)
+        {
+            const juce::ScopedLock sl(sketchLock);
+            sketch->merge(*threadSketch);
+        }
+    };
+    
+    // The calling thread and helpers in the shared pool take chunks until none are left
+    ParallelJobs::run(*analyzer.threadPool, "Stem Analysis", numChunks - 1, analyzeRemainingChunks);
+    
+    // Add the chunk sums in chunk order
+    for (int chunk = 0; chunk < numChunks; ++chunk)
+    {
+        addSpectrumChunk(chunkSums.data() + static_cast<size_t>(chunk) * static_cast<size_t>(numBins),
+                         juce::jmin(framesPerChunk, numBatchFrames - chunk * framesPerChunk));
+    }
+}
+
+void StemAnalyzer::Stream::addSpectrumChunk(const float* sums, int numChunkFrames)
+{
+    for (size_t i = 0; i < magnitudeTotals.size(); ++i)
+        magnitudeTotals[i] += sums[i];
+    
+    numFrames += numChunkFrames;
+}
+
+//==============================================================================
+void StemAnalyzer::mixToMono(const juce::AudioBuffer<float>& source, int startSample, int numChannels,
+                             float* dest, int numSamples)
+{
+    const int channelsInSource = juce::jmin(numChannels, source.getNumChannels());
+    const float channelGain = 1.0f / static_cast<float>(numChannels);
+    
+    if (channelsInSource == 0)
+        juce::FloatVectorOperations::clear(dest, numSamples);
+    
+    for (int channel = 0; channel < channelsInSource; ++channel)
+    {
+        const float* data = source.getReadPointer(channel, startSample);
+        
+        if (channel == 0)
+            juce::FloatVectorOperations::copyWithMultiply(dest, data, channelGain, numSamples);
+        else
+            juce::FloatVectorOperations::addWithMultiply(dest, data, channelGain, numSamples);
+    }
+}
+
+void StemAnalyzer::scaleToDensity(float* power, int numBins, float scale)
+{
+    // One-sided spectrum: every bin but DC and Nyquist also holds the negative frequencies
+    power[0] *= scale;
+    juce::FloatVectorOperations::multiply(power + 1, 2.0f * scale, numBins - 2);
+    power[numBins - 1] *= scale;
+}
+
+//==============================================================================
+StemAnalyzer::FrameAnalyzer::FrameAnalyzer(StemAnalyzer& analyzer, const AnalysisPlan& plan,
+                                           const SpectralBandMap& bandMap, SpectrumMode mode,
+                                           const SpectralBandMap* spectrogramMap)
+    : analyzer(analyzer),
+      plan(plan),
+      bandMap(bandMap),
+      mode(mode),
+      spectrogramMap(spectrogramMap),
+      numBins(plan.fftSize / 2 + 1),
+      workspace(plan.acquireWorkspace())
+{
+    // Only the buffers sized by the band maps can differ from the last use of the workspace
+    workspace->bandLevels.resize(static_cast<size_t>(bandMap.getNumBands()));
+    workspace->spectrogramPowers.resize(spectrogramMap != nullptr ? static_cast<size_t>(spectrogramMap->getNumBands()) : 0);
+    workspace->sketch.reset(bandMap.getNumBands());
+}
+
+StemAnalyzer::FrameAnalyzer::~FrameAnalyzer()
+{
+    plan.releaseWorkspace(std::move(workspace));
+}
+
+void StemAnalyzer::FrameAnalyzer::addFrame(const float* frame, int frameLength, float* sums,
+                                           SpectralQuantileSketch* sketch, float* spectrogramPowers)
+{
+    const int size = plan.fftSize;
+    auto& fftBuffer = workspace->fftBuffer;
+    auto& binValues = workspace->binValues;
+    auto& binLevels = workspace->binLevels;
+    auto& bandLevels = workspace->bandLevels;
+    
+    // Window the frame into the FFT buffer, zero-padding a short final frame
+    juce::FloatVectorOperations::multiply(fftBuffer.data(), frame, plan.window.data(), frameLength);
+    juce::FloatVectorOperations::clear(fftBuffer.data() + frameLength, size * 2 - frameLength);
+        
+    // Perform FFT
+    workspace->fft.performRealOnlyForwardTransform(fftBuffer.data(), true);
+        
+    // Power per bin, DC to Nyquist
+    for (int i = 0; i < numBins; ++i)
+    {
+        const float real = fftBuffer[static_cast<size_t>(i * 2)];
+        const float imag = fftBuffer[static_cast<size_t>(i * 2 + 1)];
+        binValues[static_cast<size_t>(i)] = real * real + imag * imag;
+    }
+            
+    if (mode == SpectrumMode::AveragedDecibels)
+    {
+        // Convert to dB and accumulate
+        for (int i = 0; i < numBins; ++i)
+            binLevels[static_cast<size_t>(i)] = analyzer.linearToDecibel(std::sqrt(binValues[static_cast<size_t>(i)]));
         
-        // Perform FFT
-        fft.performRealOnlyForwardTransform(fftBuffer.data(), true);
+        juce::FloatVectorOperations::add(sums, binLevels.data(), numBins);
         
-        // Calculate magnitudes and accumulate
-        for (int i = 0; i < fftSize / 2; ++i)
+        if (sketch != nullptr)
         {
-            float real = fftBuffer[i * 2];
-            float imag = fftBuffer[i * 2 + 1];
-            float magnitude = std::sqrt(real * real + imag * imag);
-            
-            // Convert to dB and accumulate
-            magnitudes[i] += linearToDecibel(magnitude);
+            bandMap.mapBins(binLevels.data(), bandLevels.data());
+            sketch->addFrame(bandLevels.data());
         }
     }
-    
-    // Average the magnitudes
-    for (auto& mag : magnitudes)
+    else
     {
-        mag /= numFrames;
+        // Linear power is summed as is; dB conversion waits until the average is known
+        juce::FloatVectorOperations::add(sums, binValues.data(), numBins);
     }
     
-    // Set the frequency data to the stem
-    stem.setFrequencyData(frequencies, magnitudes);
+    const bool sketchNeedsDensity = mode == SpectrumMode::WelchPSD && sketch != nullptr;
+    const bool spectrogramNeedsDensity = spectrogramMap != nullptr && spectrogramPowers != nullptr;
     
-    // Calculate and set LUFS, RMS, and width
-    stem.setLUFS(calculateLUFS(stem));
-    stem.setRMS(calculateRMS(stem));
-    stem.setWidth(calculateWidth(stem));
+    if (!sketchNeedsDensity && !spectrogramNeedsDensity)
+        return;
     
-    return true;
+    // The sketch (in Welch mode) and the spectrogram both see this frame's PSD
+    scaleToDensity(binValues.data(), numBins,
+                   static_cast<float>(1.0 / (bandMap.getSampleRate() * plan.windowPowerSum)));
+    
+    if (sketchNeedsDensity)
+    {
+        bandMap.mapBins(binValues.data(), bandLevels.data());
+        
+        for (auto& level : bandLevels)
+            level = 10.0f * std::log10(level + powerFloor);
+        
+        sketch->addFrame(bandLevels.data());
+    }
+    
+    if (spectrogramNeedsDensity)
+        spectrogramMap->mapBins(binValues.data(), spectrogramPowers);
 }
 
 float StemAnalyzer::compareStemFrequencies(const StemData& stem1, const StemData& stem2)
@@ -216,34 +532,90 @@ StemAnalyzer::WindowType StemAnalyzer::getWindowType() const
     return windowType;
 }
 
+void StemAnalyzer::setSpectrumMode(SpectrumMode mode)
+{
+    spectrumMode = mode;
+}
+
+StemAnalyzer::SpectrumMode StemAnalyzer::getSpectrumMode() const
+{
+    return spectrumMode;
+}
+
+void StemAnalyzer::setPercentiles(const std::vector<float>& newPercentiles)
+{
+    percentiles = newPercentiles;
+}
+
+std::vector<float> StemAnalyzer::getPercentiles() const
+{
+    return percentiles;
+}
+
+void StemAnalyzer::setSpectrogramEnabled(bool enabled)
+{
+    spectrogramEnabled = enabled;
+}
+
+bool StemAnalyzer::isSpectrogramEnabled() const
+{
+    return spectrogramEnabled;
+}
+
+void StemAnalyzer::setSpectrogramLayout(const SpectralBandMap::Layout& layout)
+{
+    spectrogramLayout = layout;
+}
+
+SpectralBandMap::Layout StemAnalyzer::getSpectrogramLayout() const
+{
+    return spectrogramLayout;
+}
+
+void StemAnalyzer::setSpectrogramPrecision(SpectrogramStore::Precision precision)
+{
+    spectrogramPrecision = precision;
+}
+
+SpectrogramStore::Precision StemAnalyzer::getSpectrogramPrecision() const
+{
+    return spectrogramPrecision;
+}
+
+void StemAnalyzer::setSampleRate(double newSampleRate)
+{
+    if (newSampleRate > 0.0)
+        sampleRate = newSampleRate;
+}
+
+double StemAnalyzer::getSampleRate() const
+{
+    return sampleRate;
+}
+
+void StemAnalyzer::setBandLayout(const SpectralBandMap::Layout& layout)
+{
+    bandLayout = layout;
+}
+
+SpectralBandMap::Layout StemAnalyzer::getBandLayout() const
+{
+    return bandLayout;
+}
+
 float StemAnalyzer::calculateLUFS(const StemData& stem)
 {
     if (!stem.hasValidAudio())
-        return -70.0f;
+        return StreamingLoudnessMeter::silenceLUFS;
     
     const auto& audioBuffer = stem.getAudioBuffer();
     
-    // This is a simplified LUFS calculation
-    // A real implementation would follow the ITU-R BS.1770 standard
-    
-    float sum = 0.0f;
-    int numSamples = audioBuffer.getNumSamples();
+    // K-weighted and gated per ITU-R BS.1770, as for streamed analysis
+    StreamingLoudnessMeter loudnessMeter;
+    loudnessMeter.prepare(sampleRate, audioBuffer.getNumChannels());
+    loudnessMeter.processBlock(audioBuffer);
     
-    for (int channel = 0; channel < audioBuffer.getNumChannels(); ++channel)
-    {
-        const float* data = audioBuffer.getReadPointer(channel);
-        
-        for (int i = 0; i < numSamples; ++i)
-        {
-            float sample = data[i];
-            sum += sample * sample;
-        }
-    }
-    
-    float rms = std::sqrt(sum / (numSamples * audioBuffer.getNumChannels()));
-    
-    // Convert to LUFS (very approximate)
-    return linearToDecibel(rms) - 10.0f;
+    return loudnessMeter.getIntegratedLoudness();
 }
 
 float StemAnalyzer::calculateRMS(const StemData& stem)
@@ -311,8 +683,25 @@ float StemAnalyzer::calculateWidth(const StemData& stem)
     return 1.0f - std::abs(correlation);
 }
 
-void StemAnalyzer::applyWindow(float* data, int size)
+std::shared_ptr<const StemAnalyzer::AnalysisPlan> StemAnalyzer::getAnalysisPlan()
+{
+    const juce::ScopedLock sl(planLock);
+    
+    auto& plan = analysisPlans[{ fftSize, windowType }];
+    
+    if (plan == nullptr)
+        plan = std::make_shared<const AnalysisPlan>(fftSize, windowType);
+    
+    return plan;
+}
+
+StemAnalyzer::AnalysisPlan::AnalysisPlan(int size, WindowType windowType)
+    : fftSize(size),
+      fftOrder(static_cast<int>(std::log2(size))),
+      window(static_cast<size_t>(size), 1.0f),
+      windowPowerSum(0.0)
 {
+    // Window tables are computed once here instead of for every frame
     switch (windowType)
     {
         case WindowType::Rectangular:
@@ -322,16 +711,14 @@ void StemAnalyzer::applyWindow(float* data, int size)
         case WindowType::Hanning:
             for (int i = 0; i < size; ++i)
             {
-                float factor = 0.5f * (1.0f - std::cos(2.0f * juce::MathConstants<float>::pi * i / (size - 1)));
-                data[i * 2] *= factor;
+                window[static_cast<size_t>(i)] = 0.5f * (1.0f - std::cos(2.0f * juce::MathConstants<float>::pi * i / (size - 1)));
             }
             break;
             
         case WindowType::Hamming:
             for (int i = 0; i < size; ++i)
             {
-                float factor = 0.54f - 0.46f * std::cos(2.0f * juce::MathConstants<float>::pi * i / (size - 1));
-                data[i * 2] *= factor;
+                window[static_cast<size_t>(i)] = 0.54f - 0.46f * std::cos(2.0f * juce::MathConstants<float>::pi * i / (size - 1));
             }
             break;
             
@@ -339,11 +726,44 @@ void StemAnalyzer::applyWindow(float* data, int size)
             for (int i = 0; i < size; ++i)
             {
                 float x = 2.0f * juce::MathConstants<float>::pi * i / (size - 1);
-                float factor = 0.42f - 0.5f * std::cos(x) + 0.08f * std::cos(2.0f * x);
-                data[i * 2] *= factor;
+                window[static_cast<size_t>(i)] = 0.42f - 0.5f * std::cos(x) + 0.08f * std::cos(2.0f * x);
             }
             break;
     }
+    
+    for (float value : window)
+        windowPowerSum += static_cast<double>(value) * value;
+}
+
+StemAnalyzer::AnalysisPlan::Workspace::Workspace(const AnalysisPlan& plan)
+    : fft(plan.fftOrder),
+      fftBuffer(static_cast<size_t>(plan.fftSize * 2), 0.0f), // Complex data (real/imag pairs)
+      binValues(static_cast<size_t>(plan.fftSize / 2 + 1), 0.0f),
+      binLevels(static_cast<size_t>(plan.fftSize / 2 + 1), 0.0f)
+{
+}
+
+std::unique_ptr<StemAnalyzer::AnalysisPlan::Workspace> StemAnalyzer::AnalysisPlan::acquireWorkspace() const
+{
+    {
+        const juce::ScopedLock sl(workspaceLock);
+        
+        if (!spareWorkspaces.empty())
+        {
+            auto workspace = std::move(spareWorkspaces.back());
+            spareWorkspaces.pop_back();
+            return workspace;
+        }
+    }
+    
+    // Built outside the lock; only the first analyses on a plan get here
+    return std::make_unique<Workspace>(*this);
+}
+
+void StemAnalyzer::AnalysisPlan::releaseWorkspace(std::unique_ptr<Workspace> workspace) const
+{
+    const juce::ScopedLock sl(workspaceLock);
+    spareWorkspaces.push_back(std::move(workspace));
 }
 
 float StemAnalyzer::linearToDecibel(float value)
@@ -2,6 +2,11 @@
 
 #include <JuceHeader.h>
 #include "StemData.h"
+#include "AudioBlockReader.h"
+#include "SpectralBandMap.h"
+#include "SpectralQuantileSketch.h"
+#include "SpectrogramStore.h"
+#include "StreamingLoudnessMeter.h"
 
 namespace ForensEQ {
 
@@ -13,9 +18,112 @@ public:
     StemAnalyzer();
     ~StemAnalyzer();
     
-    // Analyze a stem and update its frequency data
+    // Analyze a stem at the analyzer's sample rate and update its frequency data. The frames
+    // are spread over the shared thread pool (see Stream); results are identical whatever the
+    // number of threads. A stem without audio in memory is streamed from its audio source.
+    // Returns false if the stem has neither, or its source cannot be read
     bool analyzeStem(StemData& stem);
     
+    // Analyze audio streamed from a reader at the file's sample rate, scaled by gain, and store
+    // the results in the stem (the stem's audio is left untouched). Memory use does not depend
+    // on the file length
+    bool analyzeStream(AudioBlockReader& reader, StemData& stem, float gain = 1.0f);
+    
+    // How frame spectra are averaged
+    enum class SpectrumMode {
+        WelchPSD,        // Average linear power and convert to dB once (PSD, dB re full scale^2 / Hz)
+        AveragedDecibels // Average each frame's dB magnitudes
+    };
+    void setSpectrumMode(SpectrumMode mode);
+    SpectrumMode getSpectrumMode() const;
+    
+    // Set/get the percentiles (0 to 100) of per-frame band levels to report with the average
+    // spectrum, e.g. { 10, 50, 90 }. Empty (the default) skips the quantile sketch
+    void setPercentiles(const std::vector<float>& newPercentiles);
+    std::vector<float> getPercentiles() const;
+    
+    // Enable/disable keeping band levels over time in a SpectrogramStore on the stem, and set
+    // its bands and precision. On by default, with 1/6-octave bands at 8 bits
+    void setSpectrogramEnabled(bool enabled);
+    bool isSpectrogramEnabled() const;
+    void setSpectrogramLayout(const SpectralBandMap::Layout& layout);
+    SpectralBandMap::Layout getSpectrogramLayout() const;
+    void setSpectrogramPrecision(SpectrogramStore::Precision precision);
+    SpectrogramStore::Precision getSpectrogramPrecision() const;
+    
+    // Sizes and window table for one FFT size and window type
+    struct AnalysisPlan;
+    
+    // Transforms single frames and accumulates them; one per worker thread
+    class FrameAnalyzer;
+    
+    /**
+     * Incremental analysis of audio that arrives in blocks, with memory use independent of
+     * its length. The audio is mixed down until a batch of frames is complete, and the batch
+     * is analyzed on the shared thread pool in fixed chunks of frames whose sums are added in
+     * order, so results depend neither on the number of threads nor on the block sizes.
+     * analyzeStem() is a stream fed with the whole buffer
+     */
+    class Stream {
+    public:
+        Stream(StemAnalyzer& analyzer, int numChannels, double sampleRate);
+        ~Stream();
+        
+        // Feed the next numSamples samples of block
+        void process(const juce::AudioBuffer<float>& block, int numSamples);
+        
+        // Store the frequency data (and percentiles and spectrogram, if enabled), LUFS, RMS and
+        // width in the stem
+        void finish(StemData& stem);
+        
+    private:
+        StemAnalyzer& analyzer;
+        std::shared_ptr<const AnalysisPlan> plan;
+        std::shared_ptr<const SpectralBandMap> bandMap;
+        SpectrumMode spectrumMode;
+        std::vector<float> percentiles;
+        int numChannels;
+        int fftSize;
+        int hopSize;
+        int numBins;
+        
+        // Mono mix of the audio not analyzed yet, with a frame starting every hopSize samples,
+        // and how much of it is filled. It holds one batch of frames
+        std::vector<float> monoSamples;
+        int monoFill = 0;
+        int framesPerBatch;
+        
+        // Band levels of every frame, when percentiles are requested
+        std::unique_ptr<SpectralQuantileSketch> sketch;
+        juce::CriticalSection sketchLock;
+        
+        // Band power of every frame, when the spectrogram is enabled
+        std::shared_ptr<const SpectralBandMap> spectrogramMap;
+        std::unique_ptr<SpectrogramStore> spectrogram;
+        
+        // Per-bin sums (power or dB) of each chunk of the current batch, and of all completed chunks
+        std::vector<float> chunkSums;
+        std::vector<double> magnitudeTotals;
+        int numFrames = 0;
+        
+        // Level and width sums, with 64-bit sample counts
+        double sumSquares = 0.0;
+        double sumLeftSquared = 0.0;
+        double sumRightSquared = 0.0;
+        double sumLeftRight = 0.0;
+        juce::int64 numSamplesProcessed = 0;
+        
+        // BS.1770 integrated loudness
+        StreamingLoudnessMeter loudnessMeter;
+        
+        // Analyze the first numBatchFrames frames of monoSamples, each frameLength samples long
+        // (zero-padded to the FFT size), in parallel
+        void analyzeFrames(int numBatchFrames, int frameLength);
+        void addSpectrumChunk(const float* sums, int numChunkFrames);
+        
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Stream)
+    };
+    
     // Compare two stems and return a similarity score (0.0 to 1.0)
     float compareStemFrequencies(const StemData& stem1, const StemData& stem2);
     
@@ -37,7 +145,82 @@ public:
     // Get the current window type
     WindowType getWindowType() const;
     
-    // Calculate LUFS for a stem
+    // Set/get the sample rate used by analyzeStem() to place frequency bins
+    void setSampleRate(double newSampleRate);
+    double getSampleRate() const;
+    
+    // Set/get the fractional-octave bands the spectrum is reported in
+    void setBandLayout(const SpectralBandMap::Layout& layout);
+    SpectralBandMap::Layout getBandLayout() const;
+    
+    // Built once per FFT size and window type and shared by every analysis that uses it.
+    // The sizes and window are never modified after construction, so analyses on different
+    // threads can share one. FFTs are not shared: each thread borrows a workspace of its own
+    struct AnalysisPlan {
+        AnalysisPlan(int fftSize, WindowType windowType);
+        
+        int fftSize;
+        int fftOrder;
+        std::vector<float> window;
+        double windowPowerSum; // sum of squared window values, for PSD scaling
+        
+        // FFT and scratch buffers for transforming one thread's frames
+        struct Workspace {
+            explicit Workspace(const AnalysisPlan& plan);
+            
+            juce::dsp::FFT fft;                   // some FFT engines lock around each transform
+            std::vector<float> fftBuffer;         // 2 * fftSize, as the real-only transform needs
+            std::vector<float> binValues;         // a frame's power per bin
+            std::vector<float> binLevels;         // a frame's dB magnitude per bin (AveragedDecibels)
+            std::vector<float> bandLevels;        // a frame's band levels, for the sketch
+            std::vector<float> spectrogramPowers; // a frame's spectrogram band powers
+            SpectralQuantileSketch sketch;        // band levels of one thread's frames
+        };
+        
+        // Borrow a workspace, reusing one returned by an earlier analysis if any is free, and
+        // give it back when done. FFTs and scratch buffers are therefore built once per thread
+        // that uses the plan, not once per analysis
+        std::unique_ptr<Workspace> acquireWorkspace() const;
+        void releaseWorkspace(std::unique_ptr<Workspace> workspace) const;
+        
+    private:
+        mutable std::vector<std::unique_ptr<Workspace>> spareWorkspaces;
+        mutable juce::CriticalSection workspaceLock;
+    };
+    
+    class FrameAnalyzer {
+    public:
+        FrameAnalyzer(StemAnalyzer& analyzer, const AnalysisPlan& plan, const SpectralBandMap& bandMap,
+                      SpectrumMode mode, const SpectralBandMap* spectrogramMap = nullptr);
+        ~FrameAnalyzer();
+        
+        // Window a frame of frameLength samples (zero-padded to the FFT size), transform it, add
+        // its per-bin power (or dB magnitudes) to sums, and its band levels to the sketch if given.
+        // If the analyzer has a spectrogram map, spectrogramPowers receives the frame's PSD on its bands
+        void addFrame(const float* frame, int frameLength, float* sums, SpectralQuantileSketch* sketch,
+                      float* spectrogramPowers = nullptr);
+        
+        // Scratch space for the caller: a frame of spectrogram band powers
+        float* getSpectrogramPowers() { return workspace->spectrogramPowers.data(); }
+        
+        // An empty sketch on the analyzer's bands, for a thread to fill and merge afterwards
+        SpectralQuantileSketch& getThreadSketch() { return workspace->sketch; }
+        
+    private:
+        StemAnalyzer& analyzer;
+        const AnalysisPlan& plan;
+        const SpectralBandMap& bandMap;
+        SpectrumMode mode;
+        const SpectralBandMap* spectrogramMap;
+        int numBins;
+        
+        // Borrowed from the plan for the analyzer's lifetime
+        std::unique_ptr<AnalysisPlan::Workspace> workspace;
+        
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrameAnalyzer)
+    };
+    
+    // Calculate the BS.1770 integrated loudness (LUFS) of a stem
     float calculateLUFS(const StemData& stem);
     
     // Calculate RMS for a stem
@@ -49,9 +232,36 @@ public:
 private:
     int fftSize = 2048;
     WindowType windowType = WindowType::Hanning;
+    double sampleRate = 44100.0;
+    SpectralBandMap::Layout bandLayout = SpectralBandMap::analysisResolution();
+    SpectrumMode spectrumMode = SpectrumMode::WelchPSD;
+    std::vector<float> percentiles;
+    bool spectrogramEnabled = true;
+    SpectralBandMap::Layout spectrogramLayout { 6 };
+    SpectrogramStore::Precision spectrogramPrecision = SpectrogramStore::Precision::Bits8;
+    
+    std::map<std::pair<int, WindowType>, std::shared_ptr<const AnalysisPlan>> analysisPlans;
+    juce::CriticalSection planLock;
+    
+    // Process-wide worker pool, kept alive while any analyzer exists
+    juce::SharedResourcePointer<juce::ThreadPool> threadPool;
+    
+    // Get the plan for the current FFT size and window type, building it on first use
+    std::shared_ptr<const AnalysisPlan> getAnalysisPlan();
+    
+    // Frames are summed in fixed-size chunks, and the chunk sums are added in order. The
+    // chunks don't depend on the thread count or batch size, so neither does the rounding
+    static constexpr int framesPerChunk = 32;
+    
+    // Average the channels of numSamples samples from startSample into dest
+    static void mixToMono(const juce::AudioBuffer<float>& source, int startSample, int numChannels,
+                          float* dest, int numSamples);
+    
+    // Scale summed or averaged frame power to one-sided power spectral density
+    static void scaleToDensity(float* power, int numBins, float scale);
     
-    // Apply window function to FFT data
-    void applyWindow(float* data, int size);
+    // Power values at or below this floor read as -200 dB
+    static constexpr float powerFloor = 1.0e-20f;
     
     // Convert linear magnitude to dB
     float linearToDecibel(float value);
@@ -48,11 +48,32 @@ void StemData::setAudioBuffer(const juce::AudioBuffer<float>& buffer)
     audioBuffer = buffer;
 }
 
+void StemData::setAudioBuffer(juce::AudioBuffer<float>&& buffer)
+{
+    audioBuffer = std::move(buffer);
+}
+
 const juce::AudioBuffer<float>& StemData::getAudioBuffer() const
 {
     return audioBuffer;
 }
 
+void StemData::setAudioSource(const juce::File& file, float gain)
+{
+    audioSourceFile = file;
+    audioSourceGain = gain;
+}
+
+juce::File StemData::getAudioSourceFile() const
+{
+    return audioSourceFile;
+}
+
+float StemData::getAudioSourceGain() const
+{
+    return audioSourceGain;
+}
+
 void StemData::setFrequencyData(const std::vector<float>& freqs, const std::vector<float>& mags)
 {
     frequencies = freqs;
@@ -65,6 +86,28 @@ void StemData::getFrequencyData(std::vector<float>& freqs, std::vector<float>& m
     mags = magnitudes;
 }
 
+void StemData::setFrequencyPercentiles(const std::vector<float>& newPercentiles, const std::vector<std::vector<float>>& mags)
+{
+    percentiles = newPercentiles;
+    percentileMagnitudes = mags;
+}
+
+void StemData::getFrequencyPercentiles(std::vector<float>& outPercentiles, std::vector<std::vector<float>>& mags) const
+{
+    outPercentiles = percentiles;
+    mags = percentileMagnitudes;
+}
+
+void StemData::setSpectrogram(std::shared_ptr<const SpectrogramStore> newSpectrogram)
+{
+    spectrogram = std::move(newSpectrogram);
+}
+
+std::shared_ptr<const SpectrogramStore> StemData::getSpectrogram() const
+{
+    return spectrogram;
+}
+
 void StemData::setLUFS(float value)
 {
     lufs = value;
@@ -98,8 +141,13 @@ float StemData::getWidth() const
 void StemData::clear()
 {
     audioBuffer.clear();
+    audioSourceFile = juce::File();
+    audioSourceGain = 1.0f;
     frequencies.clear();
     magnitudes.clear();
+    percentiles.clear();
+    percentileMagnitudes.clear();
+    spectrogram.reset();
     lufs = -70.0f;
     rms = 0.0f;
     width = 0.0f;
@@ -110,6 +158,11 @@ bool StemData::hasValidAudio() const
     return audioBuffer.getNumSamples() > 0;
 }
 
+bool StemData::hasAudioSource() const
+{
+    return audioSourceFile != juce::File();
+}
+
 bool StemData::hasValidFrequencyData() const
 {
     return !frequencies.empty() && !magnitudes.empty() && 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "SpectrogramStore.h"
 
 namespace ForensEQ {
 
@@ -32,12 +33,28 @@ public:
     
     // Set/get the audio buffer for this stem
     void setAudioBuffer(const juce::AudioBuffer<float>& buffer);
+    void setAudioBuffer(juce::AudioBuffer<float>&& buffer);
     const juce::AudioBuffer<float>& getAudioBuffer() const;
     
+    // Set/get where the stem's audio can be read from when it isn't held in memory: a file,
+    // scaled by gain. Analysis streams it block by block
+    void setAudioSource(const juce::File& file, float gain = 1.0f);
+    juce::File getAudioSourceFile() const;
+    float getAudioSourceGain() const;
+    
     // Set/get the frequency data for this stem
     void setFrequencyData(const std::vector<float>& frequencies, const std::vector<float>& magnitudes);
     void getFrequencyData(std::vector<float>& frequencies, std::vector<float>& magnitudes) const;
     
+    // Set/get per-band level percentiles over time, on the same frequencies as the frequency
+    // data: magnitudes[i] holds the levels for percentiles[i]
+    void setFrequencyPercentiles(const std::vector<float>& percentiles, const std::vector<std::vector<float>>& magnitudes);
+    void getFrequencyPercentiles(std::vector<float>& percentiles, std::vector<std::vector<float>>& magnitudes) const;
+    
+    // Set/get the band levels over time. The store is read-only, so stems can share one
+    void setSpectrogram(std::shared_ptr<const SpectrogramStore> spectrogram);
+    std::shared_ptr<const SpectrogramStore> getSpectrogram() const;
+    
     // Set/get the LUFS value for this stem
     void setLUFS(float lufs);
     float getLUFS() const;
@@ -56,6 +73,9 @@ public:
     // Check if this stem has valid audio data
     bool hasValidAudio() const;
     
+    // Check if this stem's audio can be read from a file
+    bool hasAudioSource() const;
+    
     // Check if this stem has valid frequency data
     bool hasValidFrequencyData() const;
 
@@ -63,8 +83,13 @@ private:
     StemType type;
     juce::String name;
     juce::AudioBuffer<float> audioBuffer;
+    juce::File audioSourceFile;
+    float audioSourceGain = 1.0f;
     std::vector<float> frequencies;
     std::vector<float> magnitudes;
+    std::vector<float> percentiles;
+    std::vector<std::vector<float>> percentileMagnitudes;
+    std::shared_ptr<const SpectrogramStore> spectrogram;
     float lufs = -70.0f;
     float rms = 0.0f;
     float width = 0.0f;
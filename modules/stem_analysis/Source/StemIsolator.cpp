@@ -196,10 +196,18 @@ bool MockStemIsolator::isAvailable() const
 bool MockStemIsolator::processStemIsolation(const juce::File& audioFile, 
                                           std::map<StemType, std::unique_ptr<StemData>>& stems)
 {
+    // A mock stem is the source scaled by its gain, so nothing is decoded here: each stem
+    // refers to the file and its gain, and is streamed from the file when analyzed
+    AudioBlockReader reader;
+    if (!reader.open(audioFile))
+        return false;
+    
+    const juce::int64 totalLength = reader.getTotalLength();
+    
     // Generate mock stems for each supported stem type
-    for (auto stemType : getSupportedStemTypes())
+    for (auto type : getSupportedStemTypes())
     {
-        generateMockStem(stemType, audioFile, stems);
+        generateMockStem(type, audioFile, totalLength, stems);
     }
     
     return true;
@@ -226,97 +234,54 @@ std::vector<StemType> MockStemIsolator::getSupportedStemTypes() const
     };
 }
 
-void MockStemIsolator::generateMockStem(StemType type, const juce::File& sourceFile, 
-                                      std::map<StemType, std::unique_ptr<StemData>>& stems)
+float MockStemIsolator::getMockGain(StemType type)
 {
-    // Create a new stem data object
-    auto stem = std::make_unique<StemData>(type);
-    
-    // Load the source audio file
-    juce::AudioFormatManager formatManager;
-    formatManager.registerBasicFormats();
-    
-    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(sourceFile));
-    
-    if (reader != nullptr)
-    {
-        // Create an audio buffer with the same specs as the source file
-        juce::AudioBuffer<float> buffer(reader->numChannels, static_cast<int>(reader->lengthInSamples));
-        
-        // Read the entire file into the buffer
-        reader->read(&buffer, 0, buffer.getNumSamples(), 0, true, true);
-        
-        // Apply different processing based on stem type to simulate separation
-        float gainFactor = 0.8f;
+    // Apply a different gain per stem type to simulate separation
+    float gainFactor = 0.8f;
         
-        switch (type)
-        {
-            case StemType::Kick:
-                // Apply low-pass filter to simulate kick drum
-                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-                {
-                    auto* data = buffer.getWritePointer(channel);
-                    for (int i = 0; i < buffer.getNumSamples(); ++i)
-                    {
-                        data[i] *= gainFactor;
-                    }
-                }
-                break;
+    switch (type)
+    {
+        case StemType::Kick:
+            // Simulates a kick drum
+            break;
                 
-            case StemType::Snare:
-                // Apply band-pass filter to simulate snare
-                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-                {
-                    auto* data = buffer.getWritePointer(channel);
-                    for (int i = 0; i < buffer.getNumSamples(); ++i)
-                    {
-                        data[i] *= gainFactor * 0.7f;
-                    }
-                }
-                break;
+        case StemType::Snare:
+            // Simulates a snare
+            gainFactor *= 0.7f;
+            break;
                 
-            case StemType::Bass:
-                // Apply low-pass filter to simulate bass
-                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-                {
-                    auto* data = buffer.getWritePointer(channel);
-                    for (int i = 0; i < buffer.getNumSamples(); ++i)
-                    {
-                        data[i] *= gainFactor * 0.9f;
-                    }
-                }
-                break;
+        case StemType::Bass:
+            // Simulates bass
+            gainFactor *= 0.9f;
+            break;
                 
-            case StemType::Vocals:
-                // Apply band-pass filter to simulate vocals
-                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-                {
-                    auto* data = buffer.getWritePointer(channel);
-                    for (int i = 0; i < buffer.getNumSamples(); ++i)
-                    {
-                        data[i] *= gainFactor * 0.6f;
-                    }
-                }
-                break;
+        case StemType::Vocals:
+            // Simulates vocals
+            gainFactor *= 0.6f;
+            break;
                 
-            case StemType::Other:
-                // Apply high-pass filter to simulate other elements
-                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-                {
-                    auto* data = buffer.getWritePointer(channel);
-                    for (int i = 0; i < buffer.getNumSamples(); ++i)
-                    {
-                        data[i] *= gainFactor * 0.5f;
-                    }
-                }
-                break;
+        case StemType::Other:
+            // Simulates other elements
+            gainFactor *= 0.5f;
+            break;
                 
-            default:
-                break;
-        }
+        default:
+            break;
+    }
         
-        // Set the processed buffer to the stem
-        stem->setAudioBuffer(buffer);
+    return gainFactor;
+}
+
+void MockStemIsolator::generateMockStem(StemType type, const juce::File& audioFile, juce::int64 sourceLength,
+                                      std::map<StemType, std::unique_ptr<StemData>>& stems)
+{
+    // Create a new stem data object
+    auto stem = std::make_unique<StemData>(type);
+    
+    if (sourceLength > 0)
+    {
+        // The stem's audio is the source at this stem's gain
+        stem->setAudioSource(audioFile, getMockGain(type));
         
         // Generate mock frequency data
         std::vector<float> frequencies;
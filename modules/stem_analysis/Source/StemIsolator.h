@@ -2,6 +2,7 @@
 
 #include <JuceHeader.h>
 #include "StemData.h"
+#include "AudioBlockReader.h"
 
 namespace ForensEQ {
 
@@ -16,7 +17,8 @@ public:
     // Check if the isolator is available on this system
     virtual bool isAvailable() const = 0;
     
-    // Process an audio file and isolate stems
+    // Process an audio file and isolate stems. Each stem gets its audio in memory or an audio
+    // source to stream it from
     virtual bool processStemIsolation(const juce::File& audioFile, 
                                      std::map<StemType, std::unique_ptr<StemData>>& stems) = 0;
     
@@ -97,7 +99,8 @@ public:
     std::vector<StemType> getSupportedStemTypes() const override;
     
 private:
-    void generateMockStem(StemType type, const juce::File& sourceFile, 
+    static float getMockGain(StemType type);
+    void generateMockStem(StemType type, const juce::File& audioFile, juce::int64 sourceLength,
                          std::map<StemType, std::unique_ptr<StemData>>& stems);
 };
 
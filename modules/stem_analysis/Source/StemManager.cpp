@@ -2,7 +2,27 @@
 
 namespace ForensEQ {
 
+// Copy the analysis results (not the audio) of one stem to another
+static void copyAnalysis(const StemData& source, StemData& dest)
+{
+    std::vector<float> frequencies;
+    std::vector<float> magnitudes;
+    source.getFrequencyData(frequencies, magnitudes);
+    dest.setFrequencyData(frequencies, magnitudes);
+    
+    std::vector<float> percentiles;
+    std::vector<std::vector<float>> percentileMagnitudes;
+    source.getFrequencyPercentiles(percentiles, percentileMagnitudes);
+    dest.setFrequencyPercentiles(percentiles, percentileMagnitudes);
+    dest.setSpectrogram(source.getSpectrogram());
+    
+    dest.setLUFS(source.getLUFS());
+    dest.setRMS(source.getRMS());
+    dest.setWidth(source.getWidth());
+}
+
 StemManager::StemManager()
+    : juce::Thread("ForensEQ Reference Loader")
 {
     // Create the best available stem isolator
     stemIsolator = StemIsolatorFactory::createBestAvailableIsolator();
@@ -10,70 +30,77 @@ StemManager::StemManager()
 
 StemManager::~StemManager()
 {
+    // Abandon the load in progress and wait for the loader thread to notice
+    supersedeLoad(LoadStage::Cancelled);
+    signalThreadShouldExit();
+    notify();
+    stopThread(10000);
+    
+    cancelPendingUpdate();
     clearStems();
 }
 
+void StemManager::loadReferenceTrackAsync(const juce::File& audioFile)
+{
+    startLoad(audioFile);
+}
+
 bool StemManager::loadReferenceTrack(const juce::File& audioFile)
 {
-    // Store the reference track file
-    referenceTrackFile = audioFile;
-    
-    // Clear existing stems
-    clearStems();
-    
-    // Create a full mix stem
-    auto fullMixStem = std::make_unique<StemData>(StemType::Full);
+    // The loader thread owns the isolator and analyzer, so the load runs there as well and
+    // this thread just waits for it
+    const int generation = startLoad(audioFile);
+    bool success = false;
     
-    // Load the audio file
-    juce::AudioFormatManager formatManager;
-    formatManager.registerBasicFormats();
-    
-    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
-    
-    if (reader != nullptr)
+    for (;;)
     {
-        // Create an audio buffer with the same specs as the source file
-        juce::AudioBuffer<float> buffer(reader->numChannels, static_cast<int>(reader->lengthInSamples));
-        
-        // Read the entire file into the buffer
-        reader->read(&buffer, 0, buffer.getNumSamples(), 0, true, true);
-        
-        // Set the buffer to the full mix stem
-        fullMixStem->setAudioBuffer(buffer);
-        
-        // Analyze the full mix stem
-        stemAnalyzer.analyzeStem(*fullMixStem);
-        
-        // Add the full mix stem to the map
-        stems[StemType::Full] = std::move(fullMixStem);
-        
-        // Process stem isolation if we have a valid isolator
-        if (stemIsolator != nullptr && stemIsolator->isAvailable())
         {
-            bool isolationSuccess = stemIsolator->processStemIsolation(audioFile, stems);
-            
-            // Analyze each isolated stem
-            for (auto& pair : stems)
+            const juce::ScopedLock sl(jobLock);
+    
+            if (finishedGeneration == generation)
             {
-                if (pair.first != StemType::Full && pair.second != nullptr)
-                {
-                    stemAnalyzer.analyzeStem(*pair.second);
-                }
+                success = finishedSuccess;
+                break;
             }
+        }
             
-            // Notify listeners that stems have changed
-            sendChangeMessage();
+        if (isCancelled(generation))
+            break;
             
-            return isolationSuccess;
-        }
-        
-        // Notify listeners that stems have changed
-        sendChangeMessage();
-        
-        return true;
+        jobFinished.wait(-1);
     }
+        
+    // Publish the results before returning
+    handleUpdateNowIfNeeded();
+    
+    return success;
+}
+    
+void StemManager::cancelLoading()
+{
+    if (!isLoading())
+        return;
     
-    return false;
+    // Results still to come from the cancelled load will be dropped
+    supersedeLoad(LoadStage::Cancelled);
+    triggerAsyncUpdate();
+}
+
+bool StemManager::isLoading() const
+{
+    const LoadStage stage = loadStage.load();
+    return stage != LoadStage::Idle && stage != LoadStage::Finished
+        && stage != LoadStage::Failed && stage != LoadStage::Cancelled;
+}
+
+void StemManager::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void StemManager::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
 }
 
 juce::File StemManager::getReferenceTrackFile() const
@@ -122,6 +149,35 @@ bool StemManager::isStemAvailable(StemType type) const
     return stems.find(type) != stems.end();
 }
 
+void StemManager::requestStemAudio(StemType type)
+{
+    StemData* stem = getStem(type);
+    const int generation = loadGeneration.load();
+    
+    // Nothing to do if the audio is here, or already asked for during this load
+    if (stem == nullptr || stem->hasValidAudio()
+        || (requestedAudioType == type && requestedAudioGeneration == generation))
+        return;
+    
+    requestedAudioType = type;
+    requestedAudioGeneration = generation;
+    
+    {
+        const juce::ScopedLock sl(jobLock);
+        pendingAudioRequest.generation = generation;
+        pendingAudioRequest.type = type;
+        pendingAudioRequest.referenceFile = referenceTrackFile;
+        pendingAudioRequest.sourceFile = stem->getAudioSourceFile();
+        pendingAudioRequest.sourceGain = stem->getAudioSourceGain();
+        hasPendingAudioRequest = true;
+    }
+    
+    if (!isThreadRunning())
+        startThread();
+    
+    notify();
+}
+
 StemIsolator* StemManager::getStemIsolator()
 {
     return stemIsolator.get();
@@ -132,6 +188,11 @@ StemAnalyzer* StemManager::getStemAnalyzer()
     return &stemAnalyzer;
 }
 
+StemAnalysisCache& StemManager::getAnalysisCache()
+{
+    return analysisCache;
+}
+
 float StemManager::compareWithReference(StemType referenceType)
 {
     StemData* activeStem = getStem(activeStemType);
@@ -150,6 +211,420 @@ int StemManager::getNumLoadedStems() const
     return static_cast<int>(stems.size());
 }
 
+void StemManager::run()
+{
+    while (!threadShouldExit())
+    {
+        juce::File audioFile;
+        int generation = 0;
+        AudioRequest audioRequest;
+        
+        {
+            const juce::ScopedLock sl(jobLock);
+            
+            if (hasPendingJob)
+            {
+                audioFile = pendingFile;
+                generation = pendingGeneration;
+                hasPendingJob = false;
+            }
+            else if (hasPendingAudioRequest)
+            {
+                audioRequest = pendingAudioRequest;
+                hasPendingAudioRequest = false;
+            }
+        }
+        
+        if (generation != 0)
+        {
+            const bool success = processReferenceTrack(audioFile, generation);
+            
+            {
+                const juce::ScopedLock sl(jobLock);
+                finishedGeneration = generation;
+                finishedSuccess = success;
+            }
+            
+            jobFinished.signal();
+        }
+        else if (audioRequest.generation != 0)
+        {
+            loadStemAudio(audioRequest);
+        }
+        else
+        {
+            wait(-1);
+        }
+    }
+}
+
+void StemManager::handleAsyncUpdate()
+{
+    std::vector<StageResult> results;
+    
+    {
+        const juce::ScopedLock sl(resultLock);
+        results.swap(stageResults);
+    }
+    
+    const int generation = loadGeneration.load();
+    bool stemsChanged = false;
+    
+    for (auto& result : results)
+    {
+        // Results from superseded or cancelled loads are dropped
+        if (result.generation != generation)
+            continue;
+        
+        for (auto& pair : result.stems)
+        {
+            if (!result.audioOnly)
+            {
+                stems[pair.first] = std::move(pair.second);
+            }
+            else if (StemData* stem = getStem(pair.first))
+            {
+                if (pair.second->hasAudioSource())
+                    stem->setAudioSource(pair.second->getAudioSourceFile(), pair.second->getAudioSourceGain());
+            }
+        }
+        
+        StemData* audioStem = result.audio.getNumSamples() > 0 ? getStem(result.audioType) : nullptr;
+        if (audioStem != nullptr)
+        {
+            // Audio that can be loaded again is released once another stem's audio arrives
+            for (auto& other : stems)
+            {
+                if (other.first != result.audioType && other.second->hasAudioSource())
+                    other.second->setAudioBuffer(juce::AudioBuffer<float>());
+            }
+            
+            audioStem->setAudioBuffer(std::move(result.audio));
+        }
+        
+        stemsChanged = true;
+    }
+    
+    listeners.call([this](Listener& l) { l.referenceLoadProgressChanged(*this, loadStage.load(), loadProgress.load()); });
+    
+    // Notify listeners that stems have changed
+    if (stemsChanged)
+        sendChangeMessage();
+}
+
+int StemManager::startLoad(const juce::File& audioFile)
+{
+    // Store the reference track file
+    referenceTrackFile = audioFile;
+    
+    // Supersede any load in progress and clear existing stems
+    const int generation = supersedeLoad(LoadStage::Decoding);
+    clearStems();
+    
+    {
+        const juce::ScopedLock sl(jobLock);
+        pendingFile = audioFile;
+        pendingGeneration = generation;
+        hasPendingJob = true;
+    }
+    
+    triggerAsyncUpdate();
+    
+    if (!isThreadRunning())
+        startThread();
+    
+    notify();
+    
+    return generation;
+}
+
+bool StemManager::processReferenceTrack(const juce::File& audioFile, int generation)
+{
+    // Stage 1: decode, hashing the audio for the cache key as it streams in
+    setProgress(generation, LoadStage::Decoding, 0.0f);
+    
+    AudioBlockReader reader;
+    juce::String cacheKey;
+    
+    if (!reader.open(audioFile) || !readAudioFile(reader, generation, cacheKey))
+    {
+        if (!isCancelled(generation))
+            publishStageResult(generation, {}, true, false);
+        
+        return false;
+    }
+    
+    // A reference that has been analyzed before is restored from the cache. The cache holds
+    // no audio: the full mix is read from the file and the isolated stems' audio is recomputed,
+    // both only if requestStemAudio() asks for it
+    StemMap cachedStems;
+    if (analysisCache.lookup(cacheKey, cachedStems))
+    {
+        auto fullMix = cachedStems.find(StemType::Full);
+        if (fullMix != cachedStems.end())
+            fullMix->second->setAudioSource(audioFile);
+        
+        if (isCancelled(generation))
+            return false;
+        
+        publishStageResult(generation, std::move(cachedStems), true, true);
+        return true;
+    }
+    
+    if (isCancelled(generation))
+        return false;
+    
+    // Stage 2: full-mix analysis, with spectra binned at the file's own sample rate
+    setProgress(generation, LoadStage::AnalyzingFullMix, 0.0f);
+    stemAnalyzer.setSampleRate(reader.getSampleRate());
+    
+    // The full mix is streamed from the file again rather than kept from the decode stage, so
+    // no stage holds more than a batch of frames. Its audio is read on request
+    auto fullMixStem = std::make_unique<StemData>(StemType::Full);
+    fullMixStem->setAudioSource(audioFile);
+    
+    reader.setPosition(0);
+    stemAnalyzer.analyzeStream(reader, *fullMixStem);
+    
+    if (isCancelled(generation))
+        return false;
+    
+    // The UI takes the full mix; the cache later needs only its analysis
+    auto fullMixAnalysis = std::make_unique<StemData>(StemType::Full);
+    copyAnalysis(*fullMixStem, *fullMixAnalysis);
+    
+    {
+        StemMap stageStems;
+        stageStems[StemType::Full] = std::move(fullMixStem);
+        publishStageResult(generation, std::move(stageStems), false, false);
+    }
+    
+    StemMap isolatedStems;
+    bool success = true;
+    
+    // Process stem isolation if we have a valid isolator
+    if (stemIsolator != nullptr && stemIsolator->isAvailable())
+    {
+        // Stage 3: isolation (cannot be interrupted; cancellation is checked afterwards)
+        setProgress(generation, LoadStage::Isolating, 0.0f);
+        success = stemIsolator->processStemIsolation(audioFile, isolatedStems);
+        
+        if (isCancelled(generation))
+            return false;
+        
+        // Stage 4: analyze each isolated stem
+        setProgress(generation, LoadStage::AnalyzingStems, 0.0f);
+        
+        int numAnalyzed = 0;
+        for (auto& pair : isolatedStems)
+        {
+            // A stem that can't be analyzed would keep the isolator's placeholder data, so the
+            // load fails rather than report or cache it as analyzed
+            if (pair.first != StemType::Full && pair.second != nullptr && !stemAnalyzer.analyzeStem(*pair.second))
+                success = false;
+            
+            if (isCancelled(generation))
+                return false;
+            
+            setProgress(generation, LoadStage::AnalyzingStems,
+                        static_cast<float>(++numAnalyzed) / static_cast<float>(isolatedStems.size()));
+        }
+    }
+    
+    // Only complete results are worth reusing
+    if (success)
+    {
+        isolatedStems[StemType::Full] = std::move(fullMixAnalysis);
+        analysisCache.store(cacheKey, isolatedStems);
+        isolatedStems.erase(StemType::Full);
+    }
+    
+    publishStageResult(generation, std::move(isolatedStems), true, success);
+    
+    return success;
+}
+
+void StemManager::loadStemAudio(const AudioRequest& request)
+{
+    StemMap isolatedStems;
+    juce::File sourceFile = request.sourceFile;
+    float sourceGain = request.sourceGain;
+    juce::AudioBuffer<float> audio;
+    
+    // Stems restored from the cache don't know where their audio comes from until the
+    // isolator runs again. The other stems' audio sources are handed over as well, so asking
+    // for them later needs no isolation
+    if (sourceFile == juce::File())
+    {
+        if (stemIsolator == nullptr || !stemIsolator->isAvailable()
+            || !stemIsolator->processStemIsolation(request.referenceFile, isolatedStems))
+            return;
+        
+        auto isolated = isolatedStems.find(request.type);
+        if (isolated == isolatedStems.end() || isolated->second == nullptr)
+            return;
+        
+        sourceFile = isolated->second->getAudioSourceFile();
+        sourceGain = isolated->second->getAudioSourceGain();
+        
+        if (isolated->second->hasValidAudio())
+            audio = isolated->second->getAudioBuffer();
+        
+        for (auto& pair : isolatedStems)
+            pair.second->setAudioBuffer(juce::AudioBuffer<float>());
+    }
+    
+    if (audio.getNumSamples() == 0 && sourceFile != juce::File()
+        && !readStemAudio(sourceFile, sourceGain, request.generation, audio))
+        audio.setSize(0, 0);
+    
+    if (isCancelled(request.generation))
+        return;
+    
+    {
+        const juce::ScopedLock sl(resultLock);
+        
+        StageResult result;
+        result.generation = request.generation;
+        result.stems = std::move(isolatedStems);
+        result.audioOnly = true;
+        result.audioType = request.type;
+        result.audio = std::move(audio);
+        stageResults.push_back(std::move(result));
+    }
+    
+    triggerAsyncUpdate();
+}
+
+bool StemManager::readStemAudio(const juce::File& file, float gain, int generation, juce::AudioBuffer<float>& audio)
+{
+    AudioBlockReader reader;
+    if (!reader.open(file))
+        return false;
+    
+    // Audio beyond the memory budget is never loaded whole
+    const juce::int64 totalLength = reader.getTotalLength();
+    const juce::int64 bytesPerSample = static_cast<juce::int64>(sizeof(float)) * juce::jmax(1, reader.getNumChannels());
+    
+    if (totalLength <= 0 || totalLength * bytesPerSample > maxStoredAudioBytes)
+        return false;
+    
+    audio.setSize(reader.getNumChannels(), static_cast<int>(totalLength));
+    
+    for (int numRead = reader.readNextBlock(); numRead > 0; numRead = reader.readNextBlock())
+    {
+        // Stop early for a new load or a newer request
+        if (isCancelled(generation) || isAudioRequestSuperseded())
+            return false;
+        
+        const int destStart = static_cast<int>(reader.getPosition() - numRead);
+        
+        for (int channel = 0; channel < audio.getNumChannels(); ++channel)
+            audio.copyFrom(channel, destStart, reader.getBlock().getReadPointer(channel), numRead, gain);
+    }
+    
+    return true;
+}
+
+bool StemManager::isAudioRequestSuperseded()
+{
+    const juce::ScopedLock sl(jobLock);
+    return hasPendingJob || hasPendingAudioRequest;
+}
+
+bool StemManager::readAudioFile(AudioBlockReader& reader, int generation, juce::String& cacheKey)
+{
+    // The audio is only hashed here; nothing is kept
+    StemAnalysisCache::KeyBuilder keyBuilder(reader.getSampleRate(), reader.getNumChannels(),
+                                             getAnalysisSettingsDescription());
+    
+    for (int numRead = reader.readNextBlock(); numRead > 0; numRead = reader.readNextBlock())
+    {
+        // Check between blocks so a cancelled load stops early
+        if (isCancelled(generation))
+            return false;
+        
+        keyBuilder.addBlock(reader.getBlock(), 0, numRead);
+        
+        setProgress(generation, LoadStage::Decoding, reader.getProgress());
+    }
+    
+    cacheKey = keyBuilder.getKey();
+    return true;
+}
+
+bool StemManager::isCancelled(int generation) const
+{
+    return generation != loadGeneration.load();
+}
+
+int StemManager::supersedeLoad(LoadStage stage)
+{
+    const juce::ScopedLock sl(progressLock);
+    
+    const int generation = ++loadGeneration;
+    loadStage.store(stage);
+    loadProgress.store(0.0f);
+    
+    return generation;
+}
+
+void StemManager::setProgress(int generation, LoadStage stage, float progress)
+{
+    {
+        // Checked under the lock so a superseded load can never overwrite the new state
+        const juce::ScopedLock sl(progressLock);
+        
+        if (isCancelled(generation))
+            return;
+        
+        loadStage.store(stage);
+        loadProgress.store(progress);
+    }
+    
+    // Progress updates coalesce into the next message-thread callback
+    triggerAsyncUpdate();
+}
+
+void StemManager::publishStageResult(int generation, StemMap stageStems, bool finished, bool success)
+{
+    {
+        const juce::ScopedLock sl(resultLock);
+        
+        StageResult result;
+        result.generation = generation;
+        result.stems = std::move(stageStems);
+        stageResults.push_back(std::move(result));
+    }
+    
+    if (finished)
+        setProgress(generation, success ? LoadStage::Finished : LoadStage::Failed, 1.0f);
+    else
+        triggerAsyncUpdate();
+}
+
+juce::String StemManager::getAnalysisSettingsDescription() const
+{
+    juce::String settings;
+    
+    if (stemIsolator != nullptr && stemIsolator->isAvailable())
+        settings << stemIsolator->getName();
+    
+    settings << "|fft=" << stemAnalyzer.getFFTSize()
+             << "|window=" << static_cast<int>(stemAnalyzer.getWindowType())
+             << "|bands=" << stemAnalyzer.getBandLayout().toString()
+             << "|mode=" << static_cast<int>(stemAnalyzer.getSpectrumMode());
+    
+    for (float percentile : stemAnalyzer.getPercentiles())
+        settings << "|p" << percentile;
+    
+    if (stemAnalyzer.isSpectrogramEnabled())
+        settings << "|spectrogram=" << stemAnalyzer.getSpectrogramLayout().toString()
+                 << "/" << static_cast<int>(stemAnalyzer.getSpectrogramPrecision());
+    
+    return settings;
+}
+
 void StemManager::clearStems()
 {
     stems.clear();
@@ -4,20 +4,72 @@
 #include "StemData.h"
 #include "StemIsolator.h"
 #include "StemAnalyzer.h"
+#include "StemAnalysisCache.h"
 
 namespace ForensEQ {
 
 /**
  * Class for managing stem isolation and analysis
+ *
+ * Reference tracks are loaded on a background thread in stages (decode, full-mix
+ * analysis, isolation, per-stem analysis). The stems produced by each stage are handed
+ * over on the message thread when the stage completes, followed by a change message, so
+ * the stem map is only ever modified on the message thread. Loading a new file cancels
+ * the load in progress.
+ *
+ * Stems don't necessarily hold their audio: it is loaded on the loader thread when
+ * requestStemAudio() asks for it, so references restored from the cache need no isolation
+ * until a stem's audio is actually wanted.
  */
-class StemManager : public juce::ChangeBroadcaster {
+class StemManager : public juce::ChangeBroadcaster,
+                    private juce::Thread,
+                    private juce::AsyncUpdater {
 public:
     StemManager();
-    ~StemManager();
+    ~StemManager() override;
     
-    // Load and process a reference track
+    // Stages of a reference load
+    enum class LoadStage {
+        Idle,
+        Decoding,
+        AnalyzingFullMix,
+        Isolating,
+        AnalyzingStems,
+        Finished,
+        Failed,
+        Cancelled
+    };
+    
+    // Receives progress of reference loads, always on the message thread
+    class Listener {
+    public:
+        virtual ~Listener() = default;
+    
+        // Called when the stage changes and as the current stage makes progress (0.0 to 1.0)
+        virtual void referenceLoadProgressChanged(StemManager& manager, LoadStage stage, float progress) = 0;
+    };
+    
+    // Start loading and processing a reference track in the background, cancelling
+    // any load in progress. Returns immediately (message thread)
+    void loadReferenceTrackAsync(const juce::File& audioFile);
+    
+    // Load and process a reference track on the loader thread, blocking until done (message thread)
     bool loadReferenceTrack(const juce::File& audioFile);
     
+    // Cancel the load in progress, if any. Stems from completed stages are kept
+    void cancelLoading();
+    
+    // Check if a reference load is in progress
+    bool isLoading() const;
+    
+    // Get the stage and progress of the current (or last) reference load
+    LoadStage getLoadStage() const { return loadStage.load(); }
+    float getLoadProgress() const { return loadProgress.load(); }
+    
+    // Add/remove a progress listener
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
+    
     // Get the current reference track file
     juce::File getReferenceTrackFile() const;
     
@@ -36,12 +88,19 @@ public:
     // Check if a specific stem type is available
     bool isStemAvailable(StemType type) const;
     
+    // Ask for a stem's audio to be loaded in the background (message thread). It is set on the
+    // stem and followed by a change message; only the most recently requested stem keeps its audio
+    void requestStemAudio(StemType type);
+    
     // Get the stem isolator being used
     StemIsolator* getStemIsolator();
     
     // Get the stem analyzer
     StemAnalyzer* getStemAnalyzer();
     
+    // Get the cache of isolated and analyzed reference stems
+    StemAnalysisCache& getAnalysisCache();
+    
     // Compare the active stem with a reference stem
     float compareWithReference(StemType referenceType);
     
@@ -52,11 +111,91 @@ public:
     void clearStems();
 
 private:
+    using StemMap = std::map<StemType, std::unique_ptr<StemData>>;
+    
+    // Stems produced by a completed stage, waiting to be handed to the message thread. With
+    // audioOnly set, the stems only carry audio sources for the existing stems, and audio holds
+    // the requested stem's audio
+    struct StageResult {
+        int generation = 0;
+        StemMap stems;
+        bool audioOnly = false;
+        StemType audioType = StemType::Full;
+        juce::AudioBuffer<float> audio;
+    };
+    
+    // A stem whose audio the loader thread should load
+    struct AudioRequest {
+        int generation = 0;
+        StemType type = StemType::Full;
+        juce::File referenceFile;
+        juce::File sourceFile;
+        float sourceGain = 1.0f;
+    };
+    
     juce::File referenceTrackFile;
-    std::map<StemType, std::unique_ptr<StemData>> stems;
+    StemMap stems;
     StemType activeStemType = StemType::Full;
+    
+    // The stem whose audio was last requested, and the load it was requested for (message thread)
+    StemType requestedAudioType = StemType::Full;
+    int requestedAudioGeneration = 0;
     std::unique_ptr<StemIsolator> stemIsolator;
     StemAnalyzer stemAnalyzer;
+    StemAnalysisCache analysisCache;
+    
+    // Every load gets a new generation; work and results from older generations are discarded
+    std::atomic<int> loadGeneration { 0 };
+    std::atomic<LoadStage> loadStage { LoadStage::Idle };
+    std::atomic<float> loadProgress { 0.0f };
+    juce::CriticalSection progressLock;
+    
+    // The next file for the loader thread, guarded by jobLock
+    juce::File pendingFile;
+    int pendingGeneration = 0;
+    bool hasPendingJob = false;
+    
+    // The next stem audio for the loader thread, also guarded by jobLock. Loads take priority
+    AudioRequest pendingAudioRequest;
+    bool hasPendingAudioRequest = false;
+    
+    // The last load the loader thread finished, also guarded by jobLock. jobFinished is
+    // signalled after each one, for loadReferenceTrack() to wait on
+    int finishedGeneration = 0;
+    bool finishedSuccess = false;
+    juce::WaitableEvent jobFinished;
+    juce::CriticalSection jobLock;
+    
+    // Completed stages, guarded by resultLock
+    std::vector<StageResult> stageResults;
+    juce::CriticalSection resultLock;
+    
+    juce::ListenerList<Listener> listeners;
+    
+    // The most decoded audio a requested stem may keep in memory. Analysis always streams, so
+    // this is the only budget for stem audio
+    static constexpr juce::int64 maxStoredAudioBytes = 512 * 1024 * 1024;
+    
+    // Thread implementation
+    void run() override;
+    
+    // AsyncUpdater implementation: publishes stage results and progress
+    void handleAsyncUpdate() override;
+    
+    // Helper methods
+    int startLoad(const juce::File& audioFile);
+    bool processReferenceTrack(const juce::File& audioFile, int generation);
+    void loadStemAudio(const AudioRequest& request);
+    bool readStemAudio(const juce::File& file, float gain, int generation, juce::AudioBuffer<float>& audio);
+    bool isAudioRequestSuperseded();
+    bool readAudioFile(AudioBlockReader& reader, int generation, juce::String& cacheKey);
+    bool isCancelled(int generation) const;
+    int supersedeLoad(LoadStage stage);
+    void setProgress(int generation, LoadStage stage, float progress);
+    void publishStageResult(int generation, StemMap stageStems, bool finished, bool success);
+    
+    // Describe the isolator and analyzer settings that affect cached results
+    juce::String getAnalysisSettingsDescription() const;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StemManager)
 };
@@ -30,6 +30,21 @@ void StemToEQBridge::getSelectedStemEQData(std::vector<float>& frequencies, std:
     stemAnalysis.getSelectedStemFrequencyData(frequencies, magnitudes);
 }
 
+bool StemToEQBridge::getSelectedStemEQDataForRange(double startSeconds, double endSeconds,
+                                                   std::vector<float>& frequencies, std::vector<float>& magnitudes)
+{
+    StemData* stem = stemAnalysis.getStemManager().getStem(stemAnalysis.getSelectedStemType());
+    auto spectrogram = stem != nullptr ? stem->getSpectrogram() : nullptr;
+    
+    if (spectrogram == nullptr)
+        return false;
+    
+    frequencies = spectrogram->getBandFrequencies();
+    spectrogram->getAverageForTime(startSeconds, endSeconds, magnitudes);
+    
+    return true;
+}
+
 juce::String StemToEQBridge::getSelectedStemName() const
 {
     // Get the selected stem type
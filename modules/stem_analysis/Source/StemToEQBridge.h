@@ -16,6 +16,11 @@ public:
     // Get the frequency data for the currently selected stem
     void getSelectedStemEQData(std::vector<float>& frequencies, std::vector<float>& magnitudes);
     
+    // Get the average spectrum of the selected stem over a time range (e.g. one chorus), read
+    // from its spectrogram without new FFTs. Returns false if the stem has no spectrogram
+    bool getSelectedStemEQDataForRange(double startSeconds, double endSeconds,
+                                       std::vector<float>& frequencies, std::vector<float>& magnitudes);
+    
     // Get the stem type as a string
     juce::String getSelectedStemName() const;
     
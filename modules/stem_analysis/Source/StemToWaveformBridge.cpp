@@ -37,9 +37,27 @@ const juce::AudioBuffer<float>* StemToWaveformBridge::getSelectedStemAudio() con
         return &stem->getAudioBuffer();
     }
     
+    // Stems only hold their audio once it is asked for
+    stemAnalysis.getStemManager().requestStemAudio(type);
+    
     return nullptr;
 }
 
+bool StemToWaveformBridge::getSelectedStemSpectrogram(double startSeconds, double endSeconds, int numColumns,
+                                                      std::vector<float>& frequencies, std::vector<float>& levels) const
+{
+    StemData* stem = stemAnalysis.getStemManager().getStem(stemAnalysis.getSelectedStemType());
+    auto spectrogram = stem != nullptr ? stem->getSpectrogram() : nullptr;
+    
+    if (spectrogram == nullptr)
+        return false;
+    
+    frequencies = spectrogram->getBandFrequencies();
+    spectrogram->getColumns(startSeconds, endSeconds, numColumns, levels);
+    
+    return true;
+}
+
 juce::String StemToWaveformBridge::getSelectedStemName() const
 {
     // Get the selected stem type
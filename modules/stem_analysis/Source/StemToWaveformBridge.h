@@ -16,9 +16,15 @@ public:
     // ChangeListener implementation
     void changeListenerCallback(juce::ChangeBroadcaster* source) override;
     
-    // Get the audio buffer for the currently selected stem
+    // Get the audio buffer for the currently selected stem. Returns nullptr while the audio is
+    // still being loaded; listeners are notified when it arrives
     const juce::AudioBuffer<float>* getSelectedStemAudio() const;
     
+    // Get the selected stem's band levels (dB) over a time range, split into numColumns equal
+    // columns and stored column after column. Returns false if the stem has no spectrogram
+    bool getSelectedStemSpectrogram(double startSeconds, double endSeconds, int numColumns,
+                                    std::vector<float>& frequencies, std::vector<float>& levels) const;
+    
     // Get the stem type as a string
     juce::String getSelectedStemName() const;
     
@@ -10,24 +10,20 @@ WaveformDisplay::WaveformDisplay()
 
 WaveformDisplay::~WaveformDisplay()
 {
-    // Remove change listener if we have a thumbnail
-    if (audioThumbnail != nullptr)
-        audioThumbnail->removeChangeListener(this);
 }
 
 void WaveformDisplay::paint(juce::Graphics& g)
 {
-    // Fill background
-    g.fillAll(backgroundColor);
-    
     // Get bounds for drawing
     auto bounds = getLocalBounds().reduced(2);
     
-    // Draw the waveform if we have a thumbnail
-    if (audioThumbnail != nullptr && audioThumbnail->getTotalLength() > 0.0)
+    // Draw the waveform if we have peaks
+    if (peaks != nullptr && peaks->getLengthInSamples() > 0)
     {
-        // Draw the waveform
-        drawWaveform(g, bounds);
+        // Background and waveform come from a cached image; only the overlays are drawn
+        // each time, and usually only inside the small area that changed
+        const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        g.drawImage(getWaveformImage(scale), getLocalBounds().toFloat());
         
         // Draw the selection if active
         if (selectionEnd > selectionStart)
@@ -46,39 +42,51 @@ void WaveformDisplay::paint(juce::Graphics& g)
     }
     else
     {
+        // Fill background
+        g.fillAll(backgroundColor);
+    
         // Draw placeholder text if no waveform is available
         g.setColour(textColor);
         g.setFont(16.0f);
-        g.drawText("No waveform available", bounds, juce::Justification::centred);
+        g.drawText(samplesAvailable ? "Loading waveform..." : "No waveform available",
+                   bounds, juce::Justification::centred);
     }
 }
 
 void WaveformDisplay::resized()
 {
-    // Nothing specific needed here
+    // Images of the old size are no use any more
+    waveformImages.clear();
 }
 
-void WaveformDisplay::changeListenerCallback(juce::ChangeBroadcaster* source)
+void WaveformDisplay::setPeaks(std::shared_ptr<const WaveformPeakPyramid> newPeaks, bool canReadSamples)
 {
-    // Repaint when the thumbnail changes
-    if (source == audioThumbnail)
-        repaint();
+    // Images of other tracks stay cached, so switching back to them is instant
+    peaks = std::move(newPeaks);
+    samplesAvailable = canReadSamples;
+    
+    // Samples of the previous peaks must be asked for again
+    requestedStart = -1;
+    requestedLength = 0;
+    
+    // Update display
+    repaint();
 }
 
-void WaveformDisplay::setAudioThumbnail(juce::AudioThumbnail* thumbnail)
+void WaveformDisplay::setSamples(const std::shared_ptr<const WaveformPeakPyramid>& forPeaks, juce::int64 firstSample,
+                                 juce::AudioBuffer<float>&& samples)
 {
-    // Remove listener from old thumbnail
-    if (audioThumbnail != nullptr)
-        audioThumbnail->removeChangeListener(this);
-    
-    // Set new thumbnail
-    audioThumbnail = thumbnail;
+    if (forPeaks == nullptr || forPeaks != peaks)
+        return;
     
-    // Add listener to new thumbnail
-    if (audioThumbnail != nullptr)
-        audioThumbnail->addChangeListener(this);
+    sampleBuffer = std::move(samples);
+    sampleBufferStart = firstSample;
+    samplePeaks = forPeaks;
     
-    // Update display
+    // Images drawn from the finest level while these were on their way are redrawn
+    waveformImages.erase(std::remove_if(waveformImages.begin(), waveformImages.end(),
+                                        [](const WaveformImage& image) { return image.waitingForSamples; }),
+                         waveformImages.end());
     repaint();
 }
 
@@ -91,26 +99,38 @@ void WaveformDisplay::setTimeRange(double startTimeSeconds, double endTimeSecond
 
 void WaveformDisplay::setPlaybackPosition(double positionSeconds)
 {
+    if (positionSeconds == playbackPosition)
+        return;
+    
+    // Repaint only where the cursor was and where it is now
+    repaint(getPlaybackPositionArea(playbackPosition));
     playbackPosition = positionSeconds;
-    repaint();
+    repaint(getPlaybackPositionArea(playbackPosition));
 }
 
 void WaveformDisplay::setSelectionRange(double startTimeSeconds, double endTimeSeconds)
 {
+    if (startTimeSeconds == selectionStart && endTimeSeconds == selectionEnd)
+        return;
+    
+    // Repaint only the old and new selection
+    repaint(getSelectionArea(selectionStart, selectionEnd));
     selectionStart = startTimeSeconds;
     selectionEnd = endTimeSeconds;
-    repaint();
+    repaint(getSelectionArea(selectionStart, selectionEnd));
 }
 
 void WaveformDisplay::setWaveformColor(juce::Colour color)
 {
     waveformColor = color;
+    waveformImages.clear();
     repaint();
 }
 
 void WaveformDisplay::setBackgroundColor(juce::Colour color)
 {
     backgroundColor = color;
+    waveformImages.clear();
     repaint();
 }
 
@@ -144,38 +164,252 @@ void WaveformDisplay::setVerticalZoom(float zoomFactor)
     repaint();
 }
 
+const juce::Image& WaveformDisplay::getWaveformImage(float scale)
+{
+    const WaveformImageKey key { peaks, startTime, endTime, getWidth(), getHeight(), scale,
+                                 verticalZoom, showStereoChannels };
+    
+    auto it = std::find_if(waveformImages.begin(), waveformImages.end(),
+                           [&key](const WaveformImage& image) { return image.key == key; });
+    
+    if (it != waveformImages.end())
+    {
+        // Mark as most recently used
+        std::rotate(it, it + 1, waveformImages.end());
+        return waveformImages.back().image;
+    }
+    
+    // Render at the display's physical resolution so the image stays sharp
+    WaveformImage entry { key, juce::Image(juce::Image::RGB,
+                                           juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+                                           juce::jmax(1, juce::roundToInt(getHeight() * scale)), false) };
+    
+    {
+        juce::Graphics imageGraphics(entry.image);
+        imageGraphics.addTransform(juce::AffineTransform::scale(scale));
+        imageGraphics.fillAll(backgroundColor);
+        
+        renderedWithoutSamples = false;
+        drawWaveform(imageGraphics, getLocalBounds().reduced(2));
+        entry.waitingForSamples = renderedWithoutSamples;
+    }
+    
+    // Evict the least recently used image
+    if (static_cast<int>(waveformImages.size()) >= maxWaveformImages)
+        waveformImages.erase(waveformImages.begin());
+    
+    waveformImages.push_back(std::move(entry));
+    return waveformImages.back().image;
+}
+
+juce::Rectangle<int> WaveformDisplay::getPlaybackPositionArea(double position) const
+{
+    if (position < startTime || position > endTime)
+        return {};
+    
+    // The line and the triangle at its top
+    auto bounds = getLocalBounds().reduced(2);
+    const int x = timeToPixel(position, bounds);
+    return { x - 5, bounds.getY(), 11, bounds.getHeight() };
+}
+
+juce::Rectangle<int> WaveformDisplay::getSelectionArea(double start, double end) const
+{
+    if (end <= start || end < startTime || start > endTime)
+        return {};
+    
+    // The shaded range and both borders
+    auto bounds = getLocalBounds().reduced(2);
+    const int startPixel = timeToPixel(juce::jmax(start, startTime), bounds);
+    const int endPixel = timeToPixel(juce::jmin(end, endTime), bounds);
+    return { startPixel - 1, bounds.getY(), endPixel - startPixel + 3, bounds.getHeight() };
+}
+
 void WaveformDisplay::drawWaveform(juce::Graphics& g, juce::Rectangle<int> bounds)
 {
-    if (audioThumbnail == nullptr)
+    if (peaks == nullptr)
         return;
     
-    g.setColour(waveformColor);
-    
-    if (showStereoChannels && audioThumbnail->getNumChannels() > 1)
+    if (showStereoChannels && peaks->getNumChannels() > 1)
     {
         // Draw each channel separately
         auto channelHeight = bounds.getHeight() / 2;
         
         // Draw left channel
-        auto leftBounds = bounds.removeFromTop(channelHeight);
-        audioThumbnail->drawChannel(g, leftBounds,
-                                  startTime, endTime,
-                                  0, // channel 0 (left)
-                                  verticalZoom);
+        drawChannel(g, bounds.removeFromTop(channelHeight), 0);
         
         // Draw right channel
-        auto rightBounds = bounds;
-        audioThumbnail->drawChannel(g, rightBounds,
-                                   startTime, endTime,
-                                   1, // channel 1 (right)
-                                   verticalZoom);
+        drawChannel(g, bounds, 1);
     }
     else
     {
         // Draw all channels together
-        audioThumbnail->drawChannels(g, bounds,
-                                   startTime, endTime,
-                                   verticalZoom);
+        drawChannel(g, bounds, -1);
+    }
+}
+
+void WaveformDisplay::drawChannel(juce::Graphics& g, juce::Rectangle<int> bounds, int channel)
+{
+    const int numColumns = bounds.getWidth();
+    if (numColumns <= 0)
+        return;
+    
+    getColumnPeaks(channel, numColumns, columnPeaks);
+    
+    const float top = static_cast<float>(bounds.getY());
+    const float bottom = static_cast<float>(bounds.getBottom());
+    const float centreY = 0.5f * (top + bottom);
+    const float halfHeight = 0.5f * bounds.getHeight() * verticalZoom;
+    
+    auto valueToY = [=](float value) { return juce::jlimit(top, bottom, centreY - value * halfHeight); };
+    
+    // One rectangle per column for the peaks and one for the RMS, each layer filled in one call
+    juce::RectangleList<float> peakRectangles;
+    juce::RectangleList<float> rmsRectangles;
+    peakRectangles.ensureStorageAllocated(numColumns);
+    rmsRectangles.ensureStorageAllocated(numColumns);
+    
+    for (int column = 0; column < numColumns; ++column)
+    {
+        const auto& peak = columnPeaks[static_cast<size_t>(column)];
+        const float x = static_cast<float>(bounds.getX() + column);
+    
+        const float peakTop = valueToY(peak.maximum);
+        peakRectangles.addWithoutMerging({ x, peakTop, 1.0f, juce::jmax(1.0f, valueToY(peak.minimum) - peakTop) });
+    
+        const float rmsTop = valueToY(peak.rms);
+        const float rmsBottom = valueToY(-peak.rms);
+        if (rmsBottom > rmsTop)
+            rmsRectangles.addWithoutMerging({ x, rmsTop, 1.0f, rmsBottom - rmsTop });
+    }
+    
+    g.setColour(waveformColor);
+    g.fillRectList(peakRectangles);
+    
+    g.setColour(waveformColor.brighter(0.4f));
+    g.fillRectList(rmsRectangles);
+}
+
+void WaveformDisplay::getColumnPeaks(int channel, int numColumns, std::vector<WaveformPeakPyramid::Peak>& result)
+{
+    const double sampleRate = peaks->getSampleRate();
+    const double startSample = startTime * sampleRate;
+    const double endSample = endTime * sampleRate;
+    
+    // -1 combines all channels
+    const int firstChannel = channel < 0 ? 0 : channel;
+    const int endChannel = channel < 0 ? peaks->getNumChannels() : channel + 1;
+    
+    // Closer than the pyramid's finest level, show the visible samples themselves. They are
+    // read off the message thread, so the finest level stands in until they arrive
+    bool useSamples = false;
+    
+    if (samplesAvailable && (endSample - startSample) / numColumns < WaveformPeakPyramid::baseBucketSize)
+    {
+        const juce::int64 firstSample = juce::jmax(static_cast<juce::int64>(0), static_cast<juce::int64>(std::floor(startSample)));
+        const juce::int64 lastSample = juce::jmin(peaks->getLengthInSamples(), static_cast<juce::int64>(std::ceil(endSample)) + 1);
+        
+        useSamples = hasSamples(firstSample, lastSample);
+        
+        if (!useSamples)
+        {
+            requestSamples(firstSample, lastSample);
+            renderedWithoutSamples = true;
+        }
+    }
+    
+    std::vector<float> sumSquares(static_cast<size_t>(numColumns), 0.0f);
+    
+    for (int ch = firstChannel; ch < endChannel; ++ch)
+    {
+        auto& target = ch == firstChannel ? result : channelPeaks;
+    
+        if (useSamples)
+            getSamplePeaks(ch, startSample, endSample, numColumns, target);
+        else
+            peaks->getPeaks(ch, startSample, endSample, numColumns, target);
+    
+        for (int column = 0; column < numColumns; ++column)
+        {
+            const auto& peak = target[static_cast<size_t>(column)];
+            sumSquares[static_cast<size_t>(column)] += peak.rms * peak.rms;
+    
+            if (ch != firstChannel)
+            {
+                auto& combined = result[static_cast<size_t>(column)];
+                combined.minimum = juce::jmin(combined.minimum, peak.minimum);
+                combined.maximum = juce::jmax(combined.maximum, peak.maximum);
+            }
+        }
+    }
+    
+    // Combined RMS is the RMS over all channels
+    const float numChannels = static_cast<float>(endChannel - firstChannel);
+    
+    for (int column = 0; column < numColumns; ++column)
+        result[static_cast<size_t>(column)].rms = std::sqrt(sumSquares[static_cast<size_t>(column)] / numChannels);
+}
+
+bool WaveformDisplay::hasSamples(juce::int64 firstSample, juce::int64 lastSample) const
+{
+    return samplePeaks == peaks && sampleBufferStart <= firstSample
+        && sampleBufferStart + sampleBuffer.getNumSamples() >= lastSample;
+}
+
+void WaveformDisplay::requestSamples(juce::int64 firstSample, juce::int64 lastSample)
+{
+    // Fewer than baseBucketSize samples per column, so at most that many per pixel are asked for
+    const int numSamples = static_cast<int>(juce::jmax(static_cast<juce::int64>(0), lastSample - firstSample));
+    
+    // Stereo channels are drawn one at a time; ask only once for the same range
+    if (numSamples == 0 || onSamplesNeeded == nullptr
+        || (firstSample == requestedStart && numSamples == requestedLength))
+        return;
+    
+    requestedStart = firstSample;
+    requestedLength = numSamples;
+    onSamplesNeeded(firstSample, numSamples);
+}
+
+void WaveformDisplay::getSamplePeaks(int channel, double startSample, double endSample, int numColumns,
+                                     std::vector<WaveformPeakPyramid::Peak>& result) const
+{
+    result.assign(static_cast<size_t>(numColumns), WaveformPeakPyramid::Peak());
+    
+    const double samplesPerColumn = (endSample - startSample) / numColumns;
+    const juce::int64 bufferEnd = sampleBufferStart + sampleBuffer.getNumSamples();
+    const float* data = sampleBuffer.getReadPointer(channel);
+    
+    for (int column = 0; column < numColumns; ++column)
+    {
+        const double columnStart = startSample + column * samplesPerColumn;
+    
+        // The samples whose positions fall in this column; with fewer samples than columns,
+        // columns between two samples show the one before them
+        juce::int64 first = static_cast<juce::int64>(std::ceil(columnStart));
+        juce::int64 end = static_cast<juce::int64>(std::ceil(columnStart + samplesPerColumn));
+    
+        if (end <= first)
+        {
+            first = static_cast<juce::int64>(std::floor(columnStart));
+            end = first + 1;
+        }
+    
+        first = juce::jmax(first, sampleBufferStart);
+        end = juce::jmin(end, bufferEnd);
+    
+        if (end <= first)
+            continue;
+    
+        const float* samples = data + (first - sampleBufferStart);
+        const int count = static_cast<int>(end - first);
+        const auto range = juce::FloatVectorOperations::findMinAndMax(samples, count);
+    
+        double sum = 0.0;
+        for (int i = 0; i < count; ++i)
+            sum += static_cast<double>(samples[i]) * samples[i];
+    
+        result[static_cast<size_t>(column)] = { range.getStart(), range.getEnd(), static_cast<float>(std::sqrt(sum / count)) };
     }
 }
 
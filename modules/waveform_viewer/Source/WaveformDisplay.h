@@ -1,15 +1,24 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "WaveformPeakPyramid.h"
 
 namespace ForensEQ {
 
 /**
  * WaveformDisplay - A component that renders a detailed waveform visualization
  * with customizable appearance and rendering options.
+ *
+ * Each pixel column shows the min/max and RMS of its time range, taken from a peak
+ * pyramid level matched to the zoom, so drawing costs O(pixels) for any file length.
+ * Zoomed in closer than the pyramid's finest level, the visible samples are shown instead,
+ * down to single samples. They are asked for through onSamplesNeeded and read off the
+ * message thread; until they arrive, the finest level is drawn.
+ *
+ * The background and waveform are rendered once per track and zoom into a cached image.
+ * Moving the cursor or the selection repaints only the areas they leave and enter.
  */
-class WaveformDisplay : public juce::Component,
-                       public juce::ChangeListener
+class WaveformDisplay : public juce::Component
 {
 public:
     WaveformDisplay();
@@ -18,11 +27,19 @@ public:
     void paint(juce::Graphics& g) override;
     void resized() override;
     
-    // ChangeListener implementation for thumbnail updates
-    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
+    // Set the peaks to display. With samplesAvailable, zooms closer than the peaks' finest
+    // level ask onSamplesNeeded for the samples. Null peaks with samplesAvailable show the
+    // waveform as loading
+    void setPeaks(std::shared_ptr<const WaveformPeakPyramid> peaks, bool samplesAvailable = false);
     
-    // Set the audio thumbnail to display
-    void setAudioThumbnail(juce::AudioThumbnail* thumbnail);
+    // Called (message thread) with a range of samples of the displayed file to read; the
+    // samples should be read elsewhere and handed back with setSamples()
+    std::function<void(juce::int64 firstSample, int numSamples)> onSamplesNeeded;
+    
+    // Hand over samples asked for by onSamplesNeeded, read from the file the given peaks
+    // were built from. Samples for other peaks are ignored
+    void setSamples(const std::shared_ptr<const WaveformPeakPyramid>& forPeaks, juce::int64 firstSample,
+                    juce::AudioBuffer<float>&& samples);
     
     // Set the visible time range
     void setTimeRange(double startTimeSeconds, double endTimeSeconds);
@@ -55,8 +72,52 @@ public:
     void setVerticalZoom(float zoomFactor);
 
 private:
-    // The audio thumbnail to display
-    juce::AudioThumbnail* audioThumbnail = nullptr;
+    // The peaks to display, and whether samples can be asked for at sample-level zoom
+    std::shared_ptr<const WaveformPeakPyramid> peaks;
+    bool samplesAvailable = false;
+    
+    // The latest samples handed over, the peaks they belong to, and the range last asked for
+    juce::AudioBuffer<float> sampleBuffer;
+    juce::int64 sampleBufferStart = 0;
+    std::shared_ptr<const WaveformPeakPyramid> samplePeaks;
+    juce::int64 requestedStart = -1;
+    int requestedLength = 0;
+    
+    // Scratch space reused between paints
+    std::vector<WaveformPeakPyramid::Peak> columnPeaks;
+    std::vector<WaveformPeakPyramid::Peak> channelPeaks;
+    
+    // Everything a rendered waveform image depends on, apart from the colours
+    struct WaveformImageKey {
+        std::shared_ptr<const WaveformPeakPyramid> peaks;
+        double startTime;
+        double endTime;
+        int width;
+        int height;
+        float scale;
+        float verticalZoom;
+        bool showStereoChannels;
+    
+        bool operator==(const WaveformImageKey& other) const
+        {
+            return peaks == other.peaks && startTime == other.startTime && endTime == other.endTime
+                && width == other.width && height == other.height && scale == other.scale
+                && verticalZoom == other.verticalZoom && showStereoChannels == other.showStereoChannels;
+        }
+    };
+    
+    struct WaveformImage {
+        WaveformImageKey key;
+        juce::Image image;
+        bool waitingForSamples = false; // Drawn from the finest level until samples arrive
+    };
+    
+    // Set while rendering when samples were needed but not there yet
+    bool renderedWithoutSamples = false;
+    
+    // Rendered waveforms, least recently used first
+    std::vector<WaveformImage> waveformImages;
+    static constexpr int maxWaveformImages = 4;
     
     // Time range
     double startTime = 0.0;
@@ -82,7 +143,16 @@ private:
     juce::Colour textColor = juce::Colour(220, 220, 220);         // Light gray
     
     // Helper methods
+    const juce::Image& getWaveformImage(float scale);
+    juce::Rectangle<int> getPlaybackPositionArea(double position) const;
+    juce::Rectangle<int> getSelectionArea(double start, double end) const;
     void drawWaveform(juce::Graphics& g, juce::Rectangle<int> bounds);
+    void drawChannel(juce::Graphics& g, juce::Rectangle<int> bounds, int channel);
+    void getColumnPeaks(int channel, int numColumns, std::vector<WaveformPeakPyramid::Peak>& result);
+    bool hasSamples(juce::int64 firstSample, juce::int64 lastSample) const;
+    void requestSamples(juce::int64 firstSample, juce::int64 lastSample);
+    void getSamplePeaks(int channel, double startSample, double endSample, int numColumns,
+                        std::vector<WaveformPeakPyramid::Peak>& result) const;
     void drawPlaybackPosition(juce::Graphics& g, juce::Rectangle<int> bounds);
     void drawSelection(juce::Graphics& g, juce::Rectangle<int> bounds);
     void drawTimeMarkers(juce::Graphics& g, juce::Rectangle<int> bounds);
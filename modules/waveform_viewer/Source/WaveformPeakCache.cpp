@@ -0,0 +1,210 @@
+#include "WaveformPeakCache.h"
+
+namespace ForensEQ {
+
+// Identifies a peak file, followed by the format version
+static constexpr int peakFileMagic = 0x4b505146; // "FQPK"
+
+WaveformPeakCache::WaveformPeakCache(int maxMemoryEntries)
+    : maxMemoryEntries(juce::jmax(0, maxMemoryEntries))
+{
+    cacheDirectory = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                        .getChildFile("ForensEQ")
+                        .getChildFile("AnalysisCache")
+                        .getChildFile("WaveformPeaks");
+}
+
+WaveformPeakCache::~WaveformPeakCache()
+{
+}
+
+juce::int64 WaveformPeakCache::createKey(const juce::File& audioFile)
+{
+    const juce::int64 fileSize = audioFile.getSize();
+
+    juce::MemoryOutputStream keyData;
+    keyData.writeInt(formatVersion);
+    keyData << audioFile.getFullPathName();
+    keyData.writeInt64(fileSize);
+    keyData.writeInt64(audioFile.getLastModificationTime().toMilliseconds());
+
+    // The first and last blocks catch files rewritten in place with the same size and time,
+    // without reading the whole file
+    juce::FileInputStream stream(audioFile);
+
+    if (stream.openedOk())
+    {
+        juce::HeapBlock<char> block(contentHashBlockSize);
+
+        const int headBytes = stream.read(block.getData(), contentHashBlockSize);
+        keyData << juce::MD5(block.getData(), static_cast<size_t>(juce::jmax(0, headBytes))).toHexString();
+
+        if (fileSize > contentHashBlockSize && stream.setPosition(fileSize - contentHashBlockSize))
+        {
+            const int tailBytes = stream.read(block.getData(), contentHashBlockSize);
+            keyData << juce::MD5(block.getData(), static_cast<size_t>(juce::jmax(0, tailBytes))).toHexString();
+        }
+    }
+
+    // Fold the digest into 64 bits
+    const juce::MD5 digest(keyData.getData(), keyData.getDataSize());
+    const juce::MemoryBlock digestBytes = digest.getRawChecksumData();
+
+    juce::int64 key = 0;
+    std::memcpy(&key, digestBytes.getData(), sizeof(key));
+    return key;
+}
+
+std::shared_ptr<const WaveformPeakPyramid> WaveformPeakCache::lookup(juce::int64 key)
+{
+    juce::File file;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        // Memory tier
+        auto it = memoryEntries.find(key);
+        if (it != memoryEntries.end())
+        {
+            auto peaks = it->second;
+
+            // Mark as most recently used
+            recentKeys.removeFirstMatchingValue(key);
+            recentKeys.add(key);
+            return peaks;
+        }
+
+        file = getFileForKey(key);
+    }
+
+    // Disk tier, read without holding the lock; only the memory tier update takes it
+    if (file == juce::File() || !file.existsAsFile())
+        return nullptr;
+
+    juce::FileInputStream stream(file);
+    if (!stream.openedOk() || stream.readInt() != peakFileMagic || stream.readInt() != formatVersion)
+        return nullptr;
+
+    std::shared_ptr<const WaveformPeakPyramid> peaks = WaveformPeakPyramid::readFromStream(stream);
+
+    if (peaks != nullptr)
+    {
+        const juce::ScopedLock sl(lock);
+        addToMemory(key, peaks);
+    }
+
+    return peaks;
+}
+
+void WaveformPeakCache::store(juce::int64 key, std::shared_ptr<const WaveformPeakPyramid> peaks)
+{
+    if (peaks == nullptr)
+        return;
+
+    juce::File file;
+
+    {
+        // Only the memory tier is updated under the lock; the file is written after releasing it
+        const juce::ScopedLock sl(lock);
+        addToMemory(key, peaks);
+        file = getFileForKey(key);
+    }
+
+    if (file == juce::File() || !file.getParentDirectory().createDirectory())
+        return;
+
+    // Written via a temporary file, so readers never see a partial entry
+    juce::TemporaryFile temporaryFile(file);
+
+    {
+        juce::FileOutputStream stream(temporaryFile.getFile());
+        if (!stream.openedOk())
+            return;
+
+        stream.writeInt(peakFileMagic);
+        stream.writeInt(formatVersion);
+        peaks->writeToStream(stream);
+        stream.flush();
+
+        if (stream.getStatus().failed())
+            return;
+    }
+
+    temporaryFile.overwriteTargetFileWithTemporary();
+}
+
+void WaveformPeakCache::setCacheDirectory(const juce::File& directory)
+{
+    const juce::ScopedLock sl(lock);
+    cacheDirectory = directory;
+}
+
+juce::File WaveformPeakCache::getCacheDirectory() const
+{
+    const juce::ScopedLock sl(lock);
+    return cacheDirectory;
+}
+
+bool WaveformPeakCache::isStoredOnDisk(const juce::File& audioFile) const
+{
+    const juce::int64 key = createKey(audioFile);
+    juce::File file;
+
+    {
+        const juce::ScopedLock sl(lock);
+        file = getFileForKey(key);
+    }
+
+    return file != juce::File() && file.existsAsFile();
+}
+
+void WaveformPeakCache::setMaxMemoryEntries(int maxEntries)
+{
+    const juce::ScopedLock sl(lock);
+    maxMemoryEntries = juce::jmax(0, maxEntries);
+
+    while (recentKeys.size() > maxMemoryEntries)
+    {
+        memoryEntries.erase(recentKeys[0]);
+        recentKeys.remove(0);
+    }
+}
+
+void WaveformPeakCache::clear(bool includeDisk)
+{
+    const juce::ScopedLock sl(lock);
+
+    memoryEntries.clear();
+    recentKeys.clear();
+
+    if (includeDisk && cacheDirectory.isDirectory())
+    {
+        for (const auto& file : cacheDirectory.findChildFiles(juce::File::findFiles, false, "*.peaks"))
+            file.deleteFile();
+    }
+}
+
+void WaveformPeakCache::addToMemory(juce::int64 key, std::shared_ptr<const WaveformPeakPyramid> peaks)
+{
+    memoryEntries[key] = std::move(peaks);
+
+    recentKeys.removeFirstMatchingValue(key);
+    recentKeys.add(key);
+
+    // Evict the least recently used entries
+    while (recentKeys.size() > maxMemoryEntries)
+    {
+        memoryEntries.erase(recentKeys[0]);
+        recentKeys.remove(0);
+    }
+}
+
+juce::File WaveformPeakCache::getFileForKey(juce::int64 key) const
+{
+    if (cacheDirectory == juce::File())
+        return {};
+
+    return cacheDirectory.getChildFile(juce::String::toHexString(key) + ".peaks");
+}
+
+} // namespace ForensEQ
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "WaveformPeakPyramid.h"
+
+namespace ForensEQ {
+
+/**
+ * Class for keeping waveform peaks between sessions
+ *
+ * Recently used peak pyramids are held in memory, and every pyramid is also written to a
+ * directory of compact binary files, one per audio file, so a reference that has been
+ * scanned once shows its waveform straight away in every later session. Entries are keyed
+ * by the file's path, size, modification time and a hash of its first and last blocks;
+ * editing or replacing the file gives it a new key, so a stale waveform is never shown.
+ *
+ * All methods are thread-safe. Peak files are read and written without holding the cache
+ * lock, so a memory hit never waits for disk I/O on another thread.
+ */
+class WaveformPeakCache {
+public:
+    WaveformPeakCache(int maxMemoryEntries = 16);
+    ~WaveformPeakCache();
+
+    // Build the cache key for an audio file (reads at most two blocks of it)
+    static juce::int64 createKey(const juce::File& audioFile);
+
+    // Look up peaks in memory, then on disk. Returns nullptr on a miss
+    std::shared_ptr<const WaveformPeakPyramid> lookup(juce::int64 key);
+
+    // Store peaks in memory and on disk
+    void store(juce::int64 key, std::shared_ptr<const WaveformPeakPyramid> peaks);
+
+    // Set/get the directory for the on-disk tier, e.g. next to the project (an invalid File
+    // disables it)
+    void setCacheDirectory(const juce::File& directory);
+    juce::File getCacheDirectory() const;
+
+    // Whether peaks for this file are stored on disk
+    bool isStoredOnDisk(const juce::File& audioFile) const;
+
+    // Set the number of pyramids kept in memory; 0 keeps them on disk only, for callers
+    // that hold the pyramids themselves
+    void setMaxMemoryEntries(int maxEntries);
+
+    // Remove all entries from memory, and optionally from disk
+    void clear(bool includeDisk = false);
+
+    // Bump whenever the file format changes
+    static constexpr int formatVersion = 2;
+
+private:
+    // Memory tier, with keys ordered from least to most recently used
+    std::map<juce::int64, std::shared_ptr<const WaveformPeakPyramid>> memoryEntries;
+    juce::Array<juce::int64> recentKeys;
+    int maxMemoryEntries;
+
+    juce::File cacheDirectory;
+    juce::CriticalSection lock;
+
+    // Bytes hashed from each end of the file
+    static constexpr int contentHashBlockSize = 65536;
+
+    // Helper methods
+    void addToMemory(juce::int64 key, std::shared_ptr<const WaveformPeakPyramid> peaks);
+    juce::File getFileForKey(juce::int64 key) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformPeakCache)
+};
+
+} // namespace ForensEQ
@@ -0,0 +1,279 @@
+#include "WaveformPeakPyramid.h"
+
+namespace ForensEQ {
+
+// Samples read at a time by createFromReader()
+static constexpr int peakReadBlockSize = 65536;
+
+WaveformPeakPyramid::WaveformPeakPyramid(int numChannels, double sampleRate)
+    : numChannels(juce::jmax(1, numChannels)),
+      sampleRate(sampleRate > 0.0 ? sampleRate : 44100.0)
+{
+    levels.resize(1);
+    levels[0].resize(static_cast<size_t>(this->numChannels));
+    partialBuckets.resize(static_cast<size_t>(this->numChannels));
+}
+
+WaveformPeakPyramid::~WaveformPeakPyramid()
+{
+}
+
+std::unique_ptr<WaveformPeakPyramid> WaveformPeakPyramid::createFromReader(juce::AudioFormatReader& reader,
+                                                                           const std::function<bool()>& shouldCancel)
+{
+    // The reader only fills the first two channels
+    const int numChannels = juce::jlimit(1, 2, static_cast<int>(reader.numChannels));
+    auto pyramid = std::make_unique<WaveformPeakPyramid>(numChannels, reader.sampleRate);
+
+    juce::AudioBuffer<float> block(numChannels, peakReadBlockSize);
+
+    for (juce::int64 position = 0; position < reader.lengthInSamples; position += peakReadBlockSize)
+    {
+        if (shouldCancel != nullptr && shouldCancel())
+            return nullptr;
+
+        const int numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(peakReadBlockSize),
+                                                           reader.lengthInSamples - position));
+
+        if (!reader.read(&block, 0, numSamples, position, true, true))
+            return nullptr;
+
+        pyramid->addSamples(block, numSamples);
+    }
+
+    pyramid->finish();
+    return pyramid;
+}
+
+void WaveformPeakPyramid::addSamples(const juce::AudioBuffer<float>& block, int numSamples)
+{
+    jassert(block.getNumChannels() >= numChannels);
+
+    int offset = 0;
+
+    while (offset < numSamples)
+    {
+        // Process up to the end of the current bucket
+        const int count = juce::jmin(numSamples - offset, baseBucketSize - partialLength);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const float* data = block.getReadPointer(channel, offset);
+            auto& partial = partialBuckets[static_cast<size_t>(channel)];
+
+            const auto range = juce::FloatVectorOperations::findMinAndMax(data, count);
+            partial.minimum = partialLength == 0 ? range.getStart() : juce::jmin(partial.minimum, range.getStart());
+            partial.maximum = partialLength == 0 ? range.getEnd() : juce::jmax(partial.maximum, range.getEnd());
+
+            for (int i = 0; i < count; ++i)
+                partial.sumSquares += static_cast<double>(data[i]) * data[i];
+        }
+
+        partialLength += count;
+        lengthInSamples += count;
+        offset += count;
+
+        if (partialLength == baseBucketSize)
+            flushPartialBucket();
+    }
+}
+
+void WaveformPeakPyramid::finish()
+{
+    if (partialLength > 0)
+        flushPartialBucket();
+
+    buildUpperLevels();
+}
+
+void WaveformPeakPyramid::getPeaks(int channel, double startSample, double endSample, int numColumns,
+                                   std::vector<Peak>& peaks) const
+{
+    peaks.assign(static_cast<size_t>(juce::jmax(0, numColumns)), Peak());
+
+    if (numColumns <= 0 || channel < 0 || channel >= numChannels || endSample <= startSample)
+        return;
+
+    // Coarsest level whose buckets are no longer than a column
+    const double samplesPerColumn = (endSample - startSample) / numColumns;
+    int level = 0;
+
+    while (level + 1 < getNumLevels() && static_cast<double>(baseBucketSize << (level + 1)) <= samplesPerColumn)
+        ++level;
+
+    const auto& buckets = levels[static_cast<size_t>(level)][static_cast<size_t>(channel)];
+    const int numBuckets = static_cast<int>(buckets.size());
+    const double bucketSize = static_cast<double>(baseBucketSize << level);
+
+    if (numBuckets == 0)
+        return;
+
+    for (int column = 0; column < numColumns; ++column)
+    {
+        const double columnStart = startSample + column * samplesPerColumn;
+        const double columnEnd = columnStart + samplesPerColumn;
+
+        // Columns outside the audio stay silent
+        if (columnEnd <= 0.0 || columnStart >= static_cast<double>(lengthInSamples))
+            continue;
+
+        // Every bucket the column touches; at most three, as buckets are at most a column long
+        const int firstBucket = juce::jlimit(0, numBuckets - 1, static_cast<int>(std::floor(columnStart / bucketSize)));
+        const int endBucket = juce::jlimit(firstBucket + 1, numBuckets, static_cast<int>(std::ceil(columnEnd / bucketSize)));
+
+        Peak peak = toPeak(buckets[static_cast<size_t>(firstBucket)]);
+        float sumSquares = peak.rms * peak.rms;
+
+        for (int bucket = firstBucket + 1; bucket < endBucket; ++bucket)
+        {
+            const Peak next = toPeak(buckets[static_cast<size_t>(bucket)]);
+            peak.minimum = juce::jmin(peak.minimum, next.minimum);
+            peak.maximum = juce::jmax(peak.maximum, next.maximum);
+            sumSquares += next.rms * next.rms;
+        }
+
+        peak.rms = std::sqrt(sumSquares / static_cast<float>(endBucket - firstBucket));
+        peaks[static_cast<size_t>(column)] = peak;
+    }
+}
+
+WaveformPeakPyramid::Peak WaveformPeakPyramid::getBucket(int level, int channel, int bucket) const
+{
+    if (level < 0 || level >= getNumLevels() || channel < 0 || channel >= numChannels)
+        return {};
+
+    const auto& buckets = levels[static_cast<size_t>(level)][static_cast<size_t>(channel)];
+
+    if (bucket < 0 || bucket >= static_cast<int>(buckets.size()))
+        return {};
+
+    return toPeak(buckets[static_cast<size_t>(bucket)]);
+}
+
+size_t WaveformPeakPyramid::getMemorySize() const
+{
+    size_t numBuckets = 0;
+
+    for (const auto& level : levels)
+        for (const auto& buckets : level)
+            numBuckets += buckets.capacity();
+
+    return numBuckets * sizeof(Bucket);
+}
+
+void WaveformPeakPyramid::writeToStream(juce::OutputStream& stream) const
+{
+    stream.writeInt(numChannels);
+    stream.writeDouble(sampleRate);
+    stream.writeInt64(lengthInSamples);
+    stream.writeInt(baseBucketSize);
+
+    for (const auto& buckets : levels[0])
+    {
+        stream.writeInt(static_cast<int>(buckets.size()));
+        stream.write(buckets.data(), sizeof(Bucket) * buckets.size());
+    }
+}
+
+std::unique_ptr<WaveformPeakPyramid> WaveformPeakPyramid::readFromStream(juce::InputStream& stream)
+{
+    const int numChannels = stream.readInt();
+    const double sampleRate = stream.readDouble();
+    const juce::int64 lengthInSamples = stream.readInt64();
+    const int bucketSize = stream.readInt();
+
+    if (numChannels < 1 || numChannels > 2 || sampleRate <= 0.0 || lengthInSamples < 0 || bucketSize != baseBucketSize)
+        return nullptr;
+
+    const juce::int64 expectedBuckets = (lengthInSamples + baseBucketSize - 1) / baseBucketSize;
+    auto pyramid = std::make_unique<WaveformPeakPyramid>(numChannels, sampleRate);
+    pyramid->lengthInSamples = lengthInSamples;
+
+    for (auto& buckets : pyramid->levels[0])
+    {
+        // Counts are checked against the length, so corrupt data can't cause a huge allocation
+        const int numBuckets = stream.readInt();
+        if (numBuckets != expectedBuckets)
+            return nullptr;
+
+        buckets.resize(static_cast<size_t>(numBuckets));
+
+        const int numBytes = static_cast<int>(sizeof(Bucket)) * numBuckets;
+        if (stream.read(buckets.data(), numBytes) != numBytes)
+            return nullptr;
+    }
+
+    pyramid->buildUpperLevels();
+    return pyramid;
+}
+
+void WaveformPeakPyramid::flushPartialBucket()
+{
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto& partial = partialBuckets[static_cast<size_t>(channel)];
+        const float rms = static_cast<float>(std::sqrt(partial.sumSquares / partialLength));
+
+        levels[0][static_cast<size_t>(channel)].push_back(quantize(partial.minimum, partial.maximum, rms));
+        partial = PartialBucket();
+    }
+
+    partialLength = 0;
+}
+
+void WaveformPeakPyramid::buildUpperLevels()
+{
+    levels.resize(1);
+
+    // Halve until one bucket is left; an odd last bucket is carried up on its own
+    while (levels.back()[0].size() > 1)
+    {
+        std::vector<std::vector<Bucket>> level(static_cast<size_t>(numChannels));
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const auto& below = levels.back()[static_cast<size_t>(channel)];
+            auto& buckets = level[static_cast<size_t>(channel)];
+            buckets.resize((below.size() + 1) / 2);
+
+            for (size_t i = 0; i < buckets.size(); ++i)
+            {
+                const Bucket& first = below[i * 2];
+
+                if (i * 2 + 1 == below.size())
+                {
+                    buckets[i] = first;
+                    continue;
+                }
+
+                const Bucket& second = below[i * 2 + 1];
+                const float firstRms = first.rms / 65535.0f;
+                const float secondRms = second.rms / 65535.0f;
+
+                buckets[i].minimum = juce::jmin(first.minimum, second.minimum);
+                buckets[i].maximum = juce::jmax(first.maximum, second.maximum);
+                buckets[i].rms = static_cast<juce::uint16>(juce::roundToInt(std::sqrt(0.5f * (firstRms * firstRms + secondRms * secondRms))
+                                                                            * 65535.0f));
+            }
+        }
+
+        levels.push_back(std::move(level));
+    }
+}
+
+WaveformPeakPyramid::Bucket WaveformPeakPyramid::quantize(float minimum, float maximum, float rms)
+{
+    // Round outwards so quantized peaks never look smaller than the audio
+    Bucket bucket;
+    bucket.minimum = static_cast<juce::int16>(juce::jlimit(-32767, 32767, static_cast<int>(std::floor(minimum * 32767.0f))));
+    bucket.maximum = static_cast<juce::int16>(juce::jlimit(-32767, 32767, static_cast<int>(std::ceil(maximum * 32767.0f))));
+    bucket.rms = static_cast<juce::uint16>(juce::jlimit(0, 65535, juce::roundToInt(rms * 65535.0f)));
+    return bucket;
+}
+
+WaveformPeakPyramid::Peak WaveformPeakPyramid::toPeak(const Bucket& bucket)
+{
+    return { bucket.minimum / 32767.0f, bucket.maximum / 32767.0f, bucket.rms / 65535.0f };
+}
+
+} // namespace ForensEQ
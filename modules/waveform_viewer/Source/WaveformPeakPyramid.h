@@ -0,0 +1,97 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ForensEQ {
+
+/**
+ * Class for holding the min/max/RMS peaks of an audio file at every zoom level
+ *
+ * Level 0 keeps one bucket per baseBucketSize samples and channel; each level above
+ * merges pairs of buckets from the level below, so level k covers baseBucketSize * 2^k
+ * samples per bucket. Drawing picks the coarsest level that still has at least one bucket
+ * per pixel column, so any time range costs O(pixels) however long the file is. Closer
+ * zooms than level 0 read the samples themselves (see WaveformDisplay).
+ *
+ * Peaks are stored as 16-bit values: about 15 MB for an hour of stereo audio.
+ */
+class WaveformPeakPyramid {
+public:
+    WaveformPeakPyramid(int numChannels, double sampleRate);
+    ~WaveformPeakPyramid();
+
+    // Peak values of one bucket or pixel column
+    struct Peak {
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+        float rms = 0.0f;
+    };
+
+    // Build a pyramid by reading a whole file in blocks. Returns nullptr if reading fails or
+    // shouldCancel() returns true
+    static std::unique_ptr<WaveformPeakPyramid> createFromReader(juce::AudioFormatReader& reader,
+                                                                 const std::function<bool()>& shouldCancel);
+
+    // Add the next numSamples samples of every channel, then call finish() after the last block
+    void addSamples(const juce::AudioBuffer<float>& block, int numSamples);
+    void finish();
+
+    // Get one peak per column for the sample range [startSample, endSample) of a channel, from
+    // the coarsest level with at least one bucket per column
+    void getPeaks(int channel, double startSample, double endSample, int numColumns, std::vector<Peak>& peaks) const;
+
+    // Get the peaks of a single bucket
+    Peak getBucket(int level, int channel, int bucket) const;
+
+    int getNumChannels() const { return numChannels; }
+    double getSampleRate() const { return sampleRate; }
+    juce::int64 getLengthInSamples() const { return lengthInSamples; }
+    double getLengthInSeconds() const { return lengthInSamples / sampleRate; }
+    int getNumLevels() const { return static_cast<int>(levels.size()); }
+
+    // Bytes held by the buckets of every level
+    size_t getMemorySize() const;
+
+    // Write the base level to a stream, or read a pyramid written that way (nullptr if the
+    // data is invalid). Upper levels are rebuilt on reading
+    void writeToStream(juce::OutputStream& stream) const;
+    static std::unique_ptr<WaveformPeakPyramid> readFromStream(juce::InputStream& stream);
+
+    // Samples per bucket on level 0
+    static constexpr int baseBucketSize = 256;
+
+private:
+    // Quantized bucket: min/max scaled to +-32767, RMS scaled to 0..65535
+    struct Bucket {
+        juce::int16 minimum = 0;
+        juce::int16 maximum = 0;
+        juce::uint16 rms = 0;
+    };
+
+    int numChannels;
+    double sampleRate;
+    juce::int64 lengthInSamples = 0;
+
+    // levels[level][channel][bucket]
+    std::vector<std::vector<std::vector<Bucket>>> levels;
+
+    // The bucket being filled on level 0, per channel
+    struct PartialBucket {
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+        double sumSquares = 0.0;
+    };
+
+    std::vector<PartialBucket> partialBuckets;
+    int partialLength = 0;
+
+    // Helper methods
+    void flushPartialBucket();
+    void buildUpperLevels();
+    static Bucket quantize(float minimum, float maximum, float rms);
+    static Peak toPeak(const Bucket& bucket);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformPeakPyramid)
+};
+
+} // namespace ForensEQ
@@ -4,31 +4,38 @@
 namespace ForensEQ {
 
 WaveformViewerComponent::WaveformViewerComponent()
-    : thumbnailCache(5)  // Cache size in number of thumbnails
+    : juce::Thread("ForensEQ Waveform Loader")
 {
     // Register basic audio formats
     formatManager.registerBasicFormats();
     
-    // Initialize reference tracks
-    for (auto& track : referenceTracks)
-    {
-        track = ReferenceTrack(thumbnailCache, formatManager);
-    }
+    // The first slot, so the current track always exists
+    referenceTracks.resize(1);
+    
+    // Peaks in memory are owned by the tracks under the resource limits, so the cache
+    // keeps them on disk only
+    peakCache.setMaxMemoryEntries(0);
     
     // Create and set up the waveform display component
     waveformDisplay = std::make_unique<WaveformDisplay>();
+    waveformDisplay->onSamplesNeeded = [this](juce::int64 firstSample, int numSamples) { requestSamples(firstSample, numSamples); };
     addAndMakeVisible(waveformDisplay.get());
     
     // Set component properties
     setOpaque(true);
     
-    // Start timer for animation updates
-    startTimerHz(30); // 30 fps for smooth animations
+    // The timer only runs while playback positions arrive, see setPlaybackPosition()
 }
 
 WaveformViewerComponent::~WaveformViewerComponent()
 {
     stopTimer();
+    
+    // A scan in progress sees threadShouldExit() and stops at its next block
+    signalThreadShouldExit();
+    notify();
+    stopThread(10000);
+    cancelPendingUpdate();
 }
 
 void WaveformViewerComponent::paint(juce::Graphics& g)
@@ -64,9 +71,31 @@ void WaveformViewerComponent::resized()
 
 void WaveformViewerComponent::timerCallback()
 {
-    // Update animation or playback position if needed
-    // For now, just trigger a repaint to ensure UI is responsive
-    repaint();
+    // Pass on the latest playback position; the display repaints just the cursor
+    if (pendingPosition != currentPosition)
+    {
+        currentPosition = pendingPosition;
+        idleTicks = 0;
+    
+        if (waveformDisplay != nullptr)
+            waveformDisplay->setPlaybackPosition(currentPosition);
+    }
+    else if (++idleTicks >= idleTicksBeforeStop)
+    {
+        // Nothing is moving, so an idle window costs nothing
+        stopTimer();
+    }
+}
+
+void WaveformViewerComponent::setPlaybackPosition(double positionSeconds)
+{
+    pendingPosition = positionSeconds;
+    
+    if (!isTimerRunning())
+    {
+        idleTicks = 0;
+        startTimerHz(positionUpdateRate);
+    }
 }
 
 bool WaveformViewerComponent::isInterestedInFileDrag(const juce::StringArray& files)
@@ -83,40 +112,58 @@ bool WaveformViewerComponent::isInterestedInFileDrag(const juce::StringArray& fi
 
 void WaveformViewerComponent::filesDropped(const juce::StringArray& files, int x, int y)
 {
-    // Find the first valid audio file
+    int firstTrackIndex = -1;
+    
     for (const auto& file : files)
     {
         juce::File audioFile(file);
         if (formatManager.findFormatForFileExtension(audioFile.getFileExtension()))
         {
-            // Load the file as the current reference track
-            loadReferenceTrack(audioFile, currentTrackIndex);
-            break;
+            // The first file replaces the current reference track, the rest are added to the library
+            if (firstTrackIndex < 0)
+            {
+                if (loadReferenceTrack(audioFile, currentTrackIndex))
+                    firstTrackIndex = currentTrackIndex;
+            }
+            else
+            {
+                addReferenceTrack(audioFile);
+            }
         }
     }
+    
+    // Show the first dropped file
+    switchToReferenceTrack(firstTrackIndex);
 }
 
 bool WaveformViewerComponent::loadReferenceTrack(const juce::File& file, int trackIndex)
 {
     // Validate track index
-    if (trackIndex < 0 || trackIndex >= maxReferenceTracks)
+    if (trackIndex < 0)
         return false;
     
-    // Get a reader for this file
+    // Read the file's details; the reader isn't kept, as samples are read on the loader thread
     std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
     
     if (reader != nullptr)
     {
+        // Create the slot if needed
+        if (trackIndex >= static_cast<int>(referenceTracks.size()))
+            referenceTracks.resize(static_cast<size_t>(trackIndex) + 1);
+    
         // Update the reference track
         auto& track = referenceTracks[trackIndex];
         track.file = file;
-        track.reader = std::move(reader);
         track.name = file.getFileNameWithoutExtension();
-        track.lengthInSeconds = track.reader->lengthInSamples / track.reader->sampleRate;
+        track.sampleRate = reader->sampleRate;
+        track.numChannels = static_cast<int>(reader->numChannels);
+        track.lengthInSeconds = reader->lengthInSamples / reader->sampleRate;
         
-        // Clear the thumbnail and set its new source
-        track.thumbnail.clear();
-        track.thumbnail.setSource(new juce::FileInputSource(file));
+        // The peaks are requested from the loader thread by showTrack(); a file scanned in
+        // an earlier session comes from the peak cache instead of being read again
+        track.peaks = nullptr;
+        track.peaksRequested = false;
+        track.generation = ++lastGeneration;
         
         // Mark as loaded
         track.loaded = true;
@@ -126,17 +173,12 @@ bool WaveformViewerComponent::loadReferenceTrack(const juce::File& file, int tra
         
         // Reset selection and position
         currentPosition = 0.0;
+        pendingPosition = 0.0;
         selectionStart = 0.0;
         selectionEnd = 0.0;
         
         // Update the waveform display
-        if (waveformDisplay != nullptr)
-        {
-            waveformDisplay->setAudioThumbnail(&track.thumbnail);
-            waveformDisplay->setTimeRange(0.0, track.lengthInSeconds);
-            waveformDisplay->setPlaybackPosition(currentPosition);
-            waveformDisplay->setSelectionRange(selectionStart, selectionEnd);
-        }
+        showTrack(trackIndex);
         
         // Trigger a repaint
         repaint();
@@ -147,6 +189,15 @@ bool WaveformViewerComponent::loadReferenceTrack(const juce::File& file, int tra
     return false;
 }
 
+int WaveformViewerComponent::addReferenceTrack(const juce::File& file)
+{
+    // Fill the empty first slot before adding more
+    const int trackIndex = referenceTracks.size() == 1 && !referenceTracks[0].loaded
+                               ? 0 : static_cast<int>(referenceTracks.size());
+    
+    return loadReferenceTrack(file, trackIndex) ? trackIndex : -1;
+}
+
 int WaveformViewerComponent::getNumReferenceTracks() const
 {
     int count = 0;
@@ -162,10 +213,10 @@ int WaveformViewerComponent::getNumReferenceTracks() const
 void WaveformViewerComponent::switchToReferenceTrack(int trackIndex)
 {
     // Validate track index and check if it's loaded
-    if (trackIndex >= 0 && trackIndex < maxReferenceTracks && referenceTracks[trackIndex].loaded)
+    if (isValidTrack(trackIndex))
     {
         currentTrackIndex = trackIndex;
-        repaint();
+        showTrack(trackIndex);
     }
 }
 
@@ -184,6 +235,7 @@ void WaveformViewerComponent::mouseDown(const juce::MouseEvent& e)
         
         // Set the current position based on click position
         currentPosition = pixelToTime(e.x, bounds);
+        pendingPosition = currentPosition;
         
         // Start selection
         selectionStart = currentPosition;
@@ -196,8 +248,6 @@ void WaveformViewerComponent::mouseDown(const juce::MouseEvent& e)
             waveformDisplay->setPlaybackPosition(currentPosition);
             waveformDisplay->setSelectionRange(selectionStart, selectionEnd);
         }
-        
-        repaint();
     }
     else
     {
@@ -235,8 +285,6 @@ void WaveformViewerComponent::mouseDrag(const juce::MouseEvent& e)
         {
             waveformDisplay->setSelectionRange(selectionStart, selectionEnd);
         }
-        
-        repaint();
     }
 }
 
@@ -256,19 +304,6 @@ void WaveformViewerComponent::mouseUp(const juce::MouseEvent& e)
             waveformDisplay->setSelectionRange(selectionStart, selectionEnd);
         }
     }
-    
-    repaint();
-}
-
-void WaveformViewerComponent::drawWaveform(juce::Graphics& g, const ReferenceTrack& track, juce::Rectangle<int> bounds)
-{
-    g.setColour(waveformColor);
-    
-    // Draw the thumbnail
-    track.thumbnail.drawChannels(g, bounds,
-                               0.0, // start time
-                               track.lengthInSeconds, // end time
-                               1.0f); // vertical zoom
 }
 
 void WaveformViewerComponent::drawPlaybackPosition(juce::Graphics& g, juce::Rectangle<int> bounds)
@@ -361,4 +396,254 @@ int WaveformViewerComponent::timeToPixel(double time, juce::Rectangle<int> bound
     return bounds.getX();
 }
 
+void WaveformViewerComponent::setResourceLimits(size_t newPeakMemoryBudget)
+{
+    peakMemoryBudget = newPeakMemoryBudget;
+    
+    enforceResourceLimits();
+}
+
+void WaveformViewerComponent::showTrack(int trackIndex)
+{
+    auto& track = referenceTracks[trackIndex];
+    track.lastUsed = ++useClock;
+    
+    // Get back the peaks from the cache if they were evicted
+    if (track.peaks == nullptr && !track.peaksRequested)
+    {
+        track.peaksRequested = true;
+        requestPeaks(trackIndex, track.file, track.generation);
+    }
+    
+    enforceResourceLimits();
+    
+    if (waveformDisplay != nullptr)
+    {
+        waveformDisplay->setPeaks(track.peaks, track.file.existsAsFile());
+        waveformDisplay->setTimeRange(0.0, track.lengthInSeconds);
+        waveformDisplay->setPlaybackPosition(currentPosition);
+        waveformDisplay->setSelectionRange(selectionStart, selectionEnd);
+    }
+}
+
+bool WaveformViewerComponent::isValidTrack(int trackIndex) const
+{
+    return trackIndex >= 0 && trackIndex < static_cast<int>(referenceTracks.size())
+        && referenceTracks[static_cast<size_t>(trackIndex)].loaded;
+}
+
+void WaveformViewerComponent::enforceResourceLimits()
+{
+    size_t peakMemory = 0;
+    std::vector<int> candidates;
+    
+    for (int i = 0; i < static_cast<int>(referenceTracks.size()); ++i)
+    {
+        const auto& track = referenceTracks[static_cast<size_t>(i)];
+    
+        if (track.peaks != nullptr)
+            peakMemory += track.peaks->getMemorySize();
+    
+        // The track shown keeps its resources, as the display uses them
+        if (i != currentTrackIndex && track.peaks != nullptr)
+            candidates.push_back(i);
+    }
+    
+    // Least recently shown first
+    std::sort(candidates.begin(), candidates.end(), [this](int a, int b)
+    {
+        return referenceTracks[static_cast<size_t>(a)].lastUsed < referenceTracks[static_cast<size_t>(b)].lastUsed;
+    });
+    
+    for (int index : candidates)
+    {
+        if (peakMemory <= peakMemoryBudget)
+            break;
+    
+        auto& track = referenceTracks[static_cast<size_t>(index)];
+        peakMemory -= track.peaks->getMemorySize();
+        track.peaks.reset();
+    }
+}
+
+void WaveformViewerComponent::requestPeaks(int trackIndex, const juce::File& file, int generation)
+{
+    {
+        const juce::ScopedLock sl(jobLock);
+    
+        // A newer load replaces any request still waiting for the same slot
+        pendingRequests.erase(std::remove_if(pendingRequests.begin(), pendingRequests.end(),
+                                             [trackIndex](const PeakRequest& request) { return request.trackIndex == trackIndex; }),
+                              pendingRequests.end());
+    
+        pendingRequests.push_back({ trackIndex, file, generation });
+        slotGenerations[trackIndex] = generation;
+    }
+    
+    if (!isThreadRunning())
+        startThread();
+    
+    notify();
+}
+
+std::shared_ptr<const WaveformPeakPyramid> WaveformViewerComponent::loadPeaks(const PeakRequest& request)
+{
+    const juce::int64 key = WaveformPeakCache::createKey(request.file);
+    
+    if (auto cachedPeaks = peakCache.lookup(key))
+        return cachedPeaks;
+    
+    // Not scanned before: read the whole file, giving up if the slot gets another file
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(request.file));
+    if (reader == nullptr)
+        return nullptr;
+    
+    std::shared_ptr<const WaveformPeakPyramid> peaks = WaveformPeakPyramid::createFromReader(
+        *reader, [this, &request] { return threadShouldExit() || isStale(request); });
+    
+    peakCache.store(key, peaks);
+    return peaks;
+}
+
+bool WaveformViewerComponent::isStale(const PeakRequest& request) const
+{
+    const juce::ScopedLock sl(jobLock);
+    
+    auto it = slotGenerations.find(request.trackIndex);
+    return it == slotGenerations.end() || it->second != request.generation;
+}
+
+void WaveformViewerComponent::requestSamples(juce::int64 firstSample, int numSamples)
+{
+    const auto& track = referenceTracks[static_cast<size_t>(currentTrackIndex)];
+    
+    {
+        // Only the latest range is worth reading, so it replaces any request still waiting
+        const juce::ScopedLock sl(jobLock);
+        pendingSampleRequest = { currentTrackIndex, track.file, track.generation, track.peaks, firstSample, numSamples };
+        hasSampleRequest = true;
+    }
+    
+    if (!isThreadRunning())
+        startThread();
+    
+    notify();
+}
+
+void WaveformViewerComponent::readSamples(const SampleRequest& request)
+{
+    // The loader thread keeps the reader of the last file it read samples from
+    if (sampleReader == nullptr || sampleReaderFile != request.file)
+    {
+        sampleReader.reset(formatManager.createReaderFor(request.file));
+        sampleReaderFile = request.file;
+    }
+    
+    if (sampleReader == nullptr)
+        return;
+    
+    SampleResult result { request, juce::AudioBuffer<float>(static_cast<int>(sampleReader->numChannels), request.numSamples) };
+    
+    if (!sampleReader->read(&result.samples, 0, request.numSamples, request.firstSample, true, true))
+        return;
+    
+    {
+        const juce::ScopedLock sl(resultLock);
+        sampleResults.push_back(std::move(result));
+    }
+    
+    triggerAsyncUpdate();
+}
+
+void WaveformViewerComponent::run()
+{
+    while (!threadShouldExit())
+    {
+        PeakRequest request;
+        SampleRequest sampleRequest;
+        bool hasRequest = false;
+        bool hasSamples = false;
+    
+        {
+            const juce::ScopedLock sl(jobLock);
+    
+            // The display is waiting for samples, so they come before any peaks
+            if (hasSampleRequest)
+            {
+                sampleRequest = std::move(pendingSampleRequest);
+                hasSampleRequest = false;
+                hasSamples = true;
+            }
+            else if (!pendingRequests.empty())
+            {
+                request = pendingRequests.front();
+                pendingRequests.erase(pendingRequests.begin());
+                hasRequest = true;
+            }
+        }
+    
+        if (hasSamples)
+        {
+            readSamples(sampleRequest);
+            continue;
+        }
+    
+        if (!hasRequest)
+        {
+            wait(-1);
+            continue;
+        }
+    
+        auto peaks = loadPeaks(request);
+    
+        {
+            // Failures are delivered too, so the track can ask again when shown next
+            const juce::ScopedLock sl(resultLock);
+            peakResults.push_back({ request.trackIndex, request.generation, std::move(peaks) });
+        }
+    
+        triggerAsyncUpdate();
+    }
+}
+
+void WaveformViewerComponent::handleAsyncUpdate()
+{
+    std::vector<PeakResult> results;
+    std::vector<SampleResult> deliveredSamples;
+    
+    {
+        const juce::ScopedLock sl(resultLock);
+        results.swap(peakResults);
+        deliveredSamples.swap(sampleResults);
+    }
+    
+    for (auto& result : results)
+    {
+        auto& track = referenceTracks[static_cast<size_t>(result.trackIndex)];
+    
+        // Peaks for a file that has since been replaced are dropped
+        if (track.generation != result.generation)
+            continue;
+    
+        track.peaks = std::move(result.peaks);
+        track.peaksRequested = false;
+    
+        if (result.trackIndex == currentTrackIndex && waveformDisplay != nullptr)
+            waveformDisplay->setPeaks(track.peaks, track.file.existsAsFile());
+    }
+    
+    for (auto& result : deliveredSamples)
+    {
+        const auto& request = result.request;
+    
+        // Samples are only of use while their track is still shown with the same peaks
+        if (request.trackIndex == currentTrackIndex && waveformDisplay != nullptr
+            && referenceTracks[static_cast<size_t>(request.trackIndex)].generation == request.generation)
+            waveformDisplay->setSamples(request.peaks, request.firstSample, std::move(result.samples));
+    }
+    
+    // Tracks no longer shown may now be over the memory budget
+    enforceResourceLimits();
+}
+
 } // namespace ForensEQ
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "WaveformPeakCache.h"
+#include "WaveformPeakPyramid.h"
 
 namespace ForensEQ {
 
@@ -10,10 +12,19 @@ class WaveformDisplay;
 /**
  * WaveformViewerComponent - A component that displays waveforms of reference audio tracks
  * and allows for interaction with them.
+ *
+ * Peaks are loaded from the peak cache or built by scanning the file on a loader thread,
+ * so loading a track never blocks the message thread.
+ *
+ * Any number of reference tracks can be loaded. Open readers and peaks in memory are
+ * limited by resource limits: the least recently shown tracks give them up first, and
+ * get them back from the file and the on-disk peak cache when shown again.
  */
 class WaveformViewerComponent : public juce::Component,
                                public juce::FileDragAndDropTarget,
-                               public juce::Timer
+                               public juce::Timer,
+                               private juce::Thread,
+                               private juce::AsyncUpdater
 {
 public:
     WaveformViewerComponent();
@@ -27,9 +38,12 @@ public:
     bool isInterestedInFileDrag(const juce::StringArray& files) override;
     void filesDropped(const juce::StringArray& files, int x, int y) override;
 
-    // Load a reference track from file
+    // Load a reference track from file into a slot; slots past the last one are created
     bool loadReferenceTrack(const juce::File& file, int trackIndex = 0);
     
+    // Load a reference track into a new slot. Returns its index, or -1 if it can't be read
+    int addReferenceTrack(const juce::File& file);
+    
     // Get the number of loaded reference tracks
     int getNumReferenceTracks() const;
     
@@ -39,39 +53,105 @@ public:
     // Get the currently active reference track index
     int getCurrentReferenceTrackIndex() const;
     
+    // Set the playback position, e.g. from the host transport (message thread only). Safe to
+    // call often: the display is updated at most positionUpdateRate times a second, and the
+    // timer stops once the position stops changing
+    void setPlaybackPosition(double positionSeconds);
+    
+    // Get the waveform cache, e.g. to keep its files next to the project
+    WaveformPeakCache& getPeakCache() { return peakCache; }
+    
+    // Set the memory for peaks of tracks not shown. The track shown is never evicted
+    void setResourceLimits(size_t peakMemoryBudget);
+    
     // Mouse interaction
     void mouseDown(const juce::MouseEvent& e) override;
     void mouseDrag(const juce::MouseEvent& e) override;
     void mouseUp(const juce::MouseEvent& e) override;
 
 private:
-    // Maximum number of reference tracks
-    static constexpr int maxReferenceTracks = 3;
-    
     // Reference track data
     struct ReferenceTrack
     {
         juce::File file;
-        std::unique_ptr<juce::AudioFormatReader> reader;
-        juce::AudioThumbnail thumbnail;
+        std::shared_ptr<const WaveformPeakPyramid> peaks; // Null until delivered, or while evicted
         juce::String name;
         double lengthInSeconds = 0.0;
+        double sampleRate = 0.0;
+        int numChannels = 0;
         bool loaded = false;
-        
-        ReferenceTrack(juce::AudioThumbnailCache& cache, juce::AudioFormatManager& formatManager)
-            : thumbnail(512, formatManager, cache) {}
+        bool peaksRequested = false;
+        int generation = 0; // Identifies the load that filled this slot
+        juce::int64 lastUsed = 0;
     };
     
-    // Audio format manager and cache
+    // Audio format manager and peak cache (in memory and on disk)
     juce::AudioFormatManager formatManager;
-    juce::AudioThumbnailCache thumbnailCache;
+    WaveformPeakCache peakCache;
     
-    // Reference tracks
-    std::array<ReferenceTrack, maxReferenceTracks> referenceTracks;
+    // A file whose peaks the loader thread should load or build
+    struct PeakRequest {
+        int trackIndex = 0;
+        juce::File file;
+        int generation = 0;
+    };
+    
+    // Peaks delivered by the loader thread
+    struct PeakResult {
+        int trackIndex = 0;
+        int generation = 0;
+        std::shared_ptr<const WaveformPeakPyramid> peaks;
+    };
+    
+    // Waiting requests and the latest generation of each slot, guarded by jobLock
+    std::vector<PeakRequest> pendingRequests;
+    std::map<int, int> slotGenerations;
+    juce::CriticalSection jobLock;
+    
+    // Samples the display asked for at sample-level zoom. Only the latest request is kept
+    struct SampleRequest {
+        int trackIndex = 0;
+        juce::File file;
+        int generation = 0;
+        std::shared_ptr<const WaveformPeakPyramid> peaks; // The peaks shown when asked
+        juce::int64 firstSample = 0;
+        int numSamples = 0;
+    };
+    
+    struct SampleResult {
+        SampleRequest request;
+        juce::AudioBuffer<float> samples;
+    };
+    
+    // The waiting sample request, also guarded by jobLock
+    SampleRequest pendingSampleRequest;
+    bool hasSampleRequest = false;
+    
+    // Delivered peaks and samples, guarded by resultLock
+    std::vector<PeakResult> peakResults;
+    std::vector<SampleResult> sampleResults;
+    juce::CriticalSection resultLock;
+    
+    // Reader for sample requests, used only by the loader thread
+    std::unique_ptr<juce::AudioFormatReader> sampleReader;
+    juce::File sampleReaderFile;
+    
+    int lastGeneration = 0;
+    
+    // Reference tracks; there is always at least one slot
+    std::vector<ReferenceTrack> referenceTracks;
     int currentTrackIndex = 0;
     
+    // Resource limits, and a clock for least recently used order
+    size_t peakMemoryBudget = 256 * 1024 * 1024;
+    juce::int64 useClock = 0;
+    
     // Selection and playback
     double currentPosition = 0.0;
+    double pendingPosition = 0.0; // Latest position from setPlaybackPosition()
+    int idleTicks = 0;
+    static constexpr int positionUpdateRate = 30;
+    static constexpr int idleTicksBeforeStop = 30;
     double selectionStart = 0.0;
     double selectionEnd = 0.0;
     bool isSelecting = false;
@@ -86,6 +166,25 @@ private:
     // Helper methods
     double pixelToTime(int x, juce::Rectangle<int> bounds) const;
     int timeToPixel(double time, juce::Rectangle<int> bounds) const;
+    void showTrack(int trackIndex);
+    bool isValidTrack(int trackIndex) const;
+    void enforceResourceLimits();
+    
+    // Peak loading
+    void requestPeaks(int trackIndex, const juce::File& file, int generation);
+    std::shared_ptr<const WaveformPeakPyramid> loadPeaks(const PeakRequest& request);
+    bool isStale(const PeakRequest& request) const;
+    
+    // Sample reading for the display, on the loader thread
+    void requestSamples(juce::int64 firstSample, int numSamples);
+    void readSamples(const SampleRequest& request);
+    
+    // Thread implementation: reads the latest samples asked for, then loads or builds peaks
+    // for each request in turn
+    void run() override;
+    
+    // AsyncUpdater implementation: hands delivered peaks to their tracks and samples to the display
+    void handleAsyncUpdate() override;
     
     // Additional methods for integration with other components
     juce::String getTrackName(int trackIndex) const;
@@ -21,7 +21,7 @@ WaveformDisplay* WaveformViewerComponent::getWaveformDisplay()
 // Add a method to get track information
 juce::String WaveformViewerComponent::getTrackName(int trackIndex) const
 {
-    if (trackIndex >= 0 && trackIndex < maxReferenceTracks && referenceTracks[trackIndex].loaded)
+    if (isValidTrack(trackIndex))
     {
         return referenceTracks[trackIndex].name;
     }
@@ -31,7 +31,7 @@ juce::String WaveformViewerComponent::getTrackName(int trackIndex) const
 // Add a method to get track duration
 double WaveformViewerComponent::getTrackDuration(int trackIndex) const
 {
-    if (trackIndex >= 0 && trackIndex < maxReferenceTracks && referenceTracks[trackIndex].loaded)
+    if (isValidTrack(trackIndex))
     {
         return referenceTracks[trackIndex].lengthInSeconds;
     }
@@ -41,10 +41,9 @@ double WaveformViewerComponent::getTrackDuration(int trackIndex) const
 // Add a method to get track sample rate
 double WaveformViewerComponent::getTrackSampleRate(int trackIndex) const
 {
-    if (trackIndex >= 0 && trackIndex < maxReferenceTracks && 
-        referenceTracks[trackIndex].loaded && referenceTracks[trackIndex].reader != nullptr)
+    if (isValidTrack(trackIndex))
     {
-        return referenceTracks[trackIndex].reader->sampleRate;
+        return referenceTracks[trackIndex].sampleRate;
     }
     return 0.0;
 }
@@ -52,10 +51,9 @@ double WaveformViewerComponent::getTrackSampleRate(int trackIndex) const
 // Add a method to get track channel count
 int WaveformViewerComponent::getTrackNumChannels(int trackIndex) const
 {
-    if (trackIndex >= 0 && trackIndex < maxReferenceTracks && 
-        referenceTracks[trackIndex].loaded && referenceTracks[trackIndex].reader != nullptr)
+    if (isValidTrack(trackIndex))
     {
-        return referenceTracks[trackIndex].reader->numChannels;
+        return referenceTracks[trackIndex].numChannels;
     }
     return 0;
 }
@@ -0,0 +1,141 @@
+#include "AnalysisTap.h"
+
+AnalysisTap::AnalysisTap()
+    : juce::Thread("ForensEQ Analysis")
+{
+}
+
+AnalysisTap::~AnalysisTap()
+{
+    release();
+}
+
+void AnalysisTap::prepare(double newSampleRate, int maximumBlockSize)
+{
+    // The analysis thread must not touch the buffers while they are reallocated
+    stopThread(1000);
+
+    // Hold at least half a second of audio, and never less than several host blocks,
+    // so the analysis thread can be descheduled for a while without losing samples
+    int capacity = juce::jmax(maximumBlockSize * 8, static_cast<int>(newSampleRate * 0.5)) + 1;
+
+    fifo.setTotalSize(capacity);
+    ringBuffer.setSize(numTapChannels, capacity, false, true, false);
+    drainBuffer.setSize(numTapChannels, drainBlockSize, false, true, false);
+
+    for (int channel = 0; channel < numTapChannels; ++channel)
+        ringChannels[static_cast<size_t>(channel)] = ringBuffer.getWritePointer(channel);
+
+    sampleRate.store(newSampleRate);
+    droppedSamples.store(0);
+    streamStartPending = true;
+
+    startThread();
+}
+
+void AnalysisTap::release()
+{
+    stopThread(1000);
+
+    fifo.reset();
+    ringChannels.fill(nullptr);
+    ringBuffer.setSize(0, 0);
+    drainBuffer.setSize(0, 0);
+}
+
+void AnalysisTap::push(const juce::AudioBuffer<float>& buffer) noexcept
+{
+    const int numSamples = buffer.getNumSamples();
+    const int numSourceChannels = buffer.getNumChannels();
+
+    if (numSamples == 0 || numSourceChannels == 0 || ringBuffer.getNumSamples() == 0)
+        return;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    for (int channel = 0; channel < numTapChannels; ++channel)
+    {
+        // Mono input feeds both tap channels
+        const float* source = buffer.getReadPointer(juce::jmin(channel, numSourceChannels - 1));
+        float* ring = ringChannels[static_cast<size_t>(channel)];
+
+        if (size1 > 0)
+            juce::FloatVectorOperations::copy(ring + start1, source, size1);
+
+        if (size2 > 0)
+            juce::FloatVectorOperations::copy(ring + start2, source + size1, size2);
+    }
+
+    const int numWritten = size1 + size2;
+    fifo.finishedWrite(numWritten);
+
+    if (numWritten < numSamples)
+        droppedSamples.fetch_add(numSamples - numWritten, std::memory_order_relaxed);
+}
+
+void AnalysisTap::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void AnalysisTap::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
+}
+
+void AnalysisTap::run()
+{
+    if (streamStartPending)
+    {
+        streamStartPending = false;
+        listeners.call([this](Listener& l) { l.analysisStreamStarted(sampleRate.load()); });
+    }
+
+    while (!threadShouldExit())
+    {
+        // Poll rather than being signalled, so the audio thread never has to make a system call
+        if (fifo.getNumReady() < minDrainSamples)
+        {
+            wait(5);
+            continue;
+        }
+
+        drainToListeners();
+    }
+}
+
+void AnalysisTap::drainToListeners()
+{
+    int numReady = fifo.getNumReady();
+
+    while (numReady > 0 && !threadShouldExit())
+    {
+        const int numToRead = juce::jmin(numReady, drainBlockSize);
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(numToRead, start1, size1, start2, size2);
+
+        // Present the listeners with a block of exactly the samples read
+        drainBuffer.setSize(numTapChannels, size1 + size2, false, false, true);
+
+        for (int channel = 0; channel < numTapChannels; ++channel)
+        {
+            const float* ring = ringChannels[static_cast<size_t>(channel)];
+            float* dest = drainBuffer.getWritePointer(channel);
+
+            if (size1 > 0)
+                juce::FloatVectorOperations::copy(dest, ring + start1, size1);
+
+            if (size2 > 0)
+                juce::FloatVectorOperations::copy(dest + size1, ring + start2, size2);
+        }
+
+        fifo.finishedRead(size1 + size2);
+
+        const double currentSampleRate = sampleRate.load();
+        listeners.call([this, currentSampleRate](Listener& l) { l.analysisBlockReady(drainBuffer, currentSampleRate); });
+
+        numReady -= size1 + size2;
+    }
+}
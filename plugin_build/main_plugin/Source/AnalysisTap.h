@@ -0,0 +1,88 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * AnalysisTap - Real-time safe bridge between the audio thread and the analysis modules
+ *
+ * The audio thread pushes every processed block into a preallocated single-producer/
+ * single-consumer FIFO without allocating, locking or waiting. A low-priority background
+ * thread drains the FIFO and hands the audio to the registered listeners (EQ visualizer
+ * spectrum, loudness meters, width meter), so all analysis work happens off the audio thread.
+ */
+class AnalysisTap : private juce::Thread
+{
+public:
+    AnalysisTap();
+    ~AnalysisTap() override;
+
+    // Consumer interface, called on the background analysis thread
+    class Listener {
+    public:
+        virtual ~Listener() = default;
+
+        // Called when the stream has been (re)started, e.g. after prepareToPlay.
+        // Listeners added mid-stream are not called; they see the rate with each block
+        virtual void analysisStreamStarted(double sampleRate) = 0;
+
+        // Called with the next block of tapped audio, in order and without gaps
+        // unless samples were dropped because the consumer fell behind
+        virtual void analysisBlockReady(const juce::AudioBuffer<float>& block, double sampleRate) = 0;
+    };
+
+    // Allocate the FIFO and start the analysis thread (message thread, from prepareToPlay)
+    void prepare(double sampleRate, int maximumBlockSize);
+
+    // Stop the analysis thread and free the FIFO (message thread, from releaseResources)
+    void release();
+
+    // Push a block from the audio thread. Wait-free and allocation-free; if the
+    // consumer has fallen behind, the samples that do not fit are dropped
+    void push(const juce::AudioBuffer<float>& buffer) noexcept;
+
+    // Add/remove a consumer (never call these from the audio thread)
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
+
+    // Number of channels delivered to listeners (mono input is duplicated to stereo)
+    static constexpr int numTapChannels = 2;
+
+    // Get the sample rate of the current stream
+    double getSampleRate() const { return sampleRate.load(); }
+
+    // Get the total number of samples dropped since the last prepare()
+    juce::int64 getNumDroppedSamples() const { return droppedSamples.load(); }
+
+private:
+    // Thread implementation
+    void run() override;
+
+    // Drain everything currently in the FIFO and forward it to the listeners
+    void drainToListeners();
+
+    // Lock-free SPSC index management and the preallocated sample storage
+    juce::AbstractFifo fifo { 1 };
+    juce::AudioBuffer<float> ringBuffer;
+
+    // The ring buffer's channels, taken once in prepare(). Both threads copy through these
+    // rather than through AudioBuffer methods, which read and write its non-atomic isClear flag
+    std::array<float*, numTapChannels> ringChannels {};
+
+    // Scratch buffer the analysis thread reads into before calling listeners
+    juce::AudioBuffer<float> drainBuffer;
+
+    // Listener list, guarded by a lock that is only ever taken off the audio thread
+    juce::ListenerList<Listener, juce::Array<Listener*, juce::CriticalSection>> listeners;
+
+    std::atomic<double> sampleRate { 44100.0 };
+    std::atomic<juce::int64> droppedSamples { 0 };
+    bool streamStartPending = false;
+
+    // Minimum amount of audio to collect before waking the listeners
+    static constexpr int minDrainSamples = 256;
+
+    // Size of the blocks handed to the listeners
+    static constexpr int drainBlockSize = 2048;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisTap)
+};
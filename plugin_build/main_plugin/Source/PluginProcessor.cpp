@@ -11,10 +11,13 @@ ForensEQAudioProcessor::ForensEQAudioProcessor()
                      .withOutput("Output", juce::AudioChannelSet::stereo(), true)),
       parameters(*this, nullptr, "ForensEQ", createParameterLayout())
 {
+    analysisTap.addListener(this);
 }
 
 ForensEQAudioProcessor::~ForensEQAudioProcessor()
 {
+    analysisTap.removeListener(this);
+    analysisTap.release();
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout ForensEQAudioProcessor::createParameterLayout()
@@ -119,8 +122,8 @@ void ForensEQAudioProcessor::changeProgramName(int index, const juce::String& ne
 
 void ForensEQAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    // Initialize analysis buffer
-    analysisBuffer.setSize(2, samplesPerBlock);
+    // Allocate the analysis FIFO up front so processBlock never allocates
+    analysisTap.prepare(sampleRate, samplesPerBlock);
     
     // Prepare all module processors
     // This would call into the respective module preparation methods
@@ -129,6 +132,7 @@ void ForensEQAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBloc
 void ForensEQAudioProcessor::releaseResources()
 {
     // Release resources for all module processors
+    analysisTap.release();
 }
 
 bool ForensEQAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
@@ -150,8 +154,8 @@ void ForensEQAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce
     
     juce::ScopedNoDenormals noDenormals;
     
-    // Copy input for analysis
-    analysisBuffer.makeCopyOf(buffer);
+    // Hand the input to the analysis thread (wait-free, no allocation)
+    analysisTap.push(buffer);
     
     // Process through all module processors
     // This would call into the respective module processing methods
@@ -159,6 +163,30 @@ void ForensEQAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce
     // For now, just pass through audio
 }
 
+void ForensEQAudioProcessor::analysisStreamStarted(double sampleRate)
+{
+    currentAnalysisSampleRate = sampleRate;
+    liveSpectrum.prepare(sampleRate);
+    liveLoudness.prepare(sampleRate, AnalysisTap::numTapChannels);
+    liveTruePeak.prepare(sampleRate, AnalysisTap::numTapChannels);
+}
+
+void ForensEQAudioProcessor::analysisBlockReady(const juce::AudioBuffer<float>& block, double sampleRate)
+{
+    // Follow rate changes that arrive without a stream restart
+    if (sampleRate != currentAnalysisSampleRate)
+    {
+        currentAnalysisSampleRate = sampleRate;
+        liveSpectrum.prepare(sampleRate);
+        liveLoudness.prepare(sampleRate, AnalysisTap::numTapChannels);
+        liveTruePeak.prepare(sampleRate, AnalysisTap::numTapChannels);
+    }
+    
+    liveSpectrum.pushSamples(block);
+    liveLoudness.processBlock(block);
+    liveTruePeak.processBlock(block);
+}
+
 bool ForensEQAudioProcessor::hasEditor() const
 {
     return true;
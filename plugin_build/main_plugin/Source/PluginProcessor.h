@@ -1,13 +1,18 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "AnalysisTap.h"
+#include "LiveSpectrumAnalyzer.h"
+#include "StreamingLoudnessMeter.h"
+#include "TruePeakDetector.h"
 
 /**
  * ForensEQAudioProcessor - Main audio processor for the ForensEQ plugin
  * 
  * Handles audio processing and parameter management for all integrated modules
  */
-class ForensEQAudioProcessor : public juce::AudioProcessor
+class ForensEQAudioProcessor : public juce::AudioProcessor,
+                               private AnalysisTap::Listener
 {
 public:
     ForensEQAudioProcessor();
@@ -37,9 +42,31 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
 
+    // Get the real-time safe audio tap that feeds the analysis modules
+    AnalysisTap& getAnalysisTap() { return analysisTap; }
+
+    // Get the live spectrum of the processed audio (for EQVisualizerComponent::setLiveSpectrumSource)
+    ForensEQ::LiveSpectrumAnalyzer& getLiveSpectrumAnalyzer() { return liveSpectrum; }
+
+    // Get the live BS.1770-4 loudness meter (momentary/short-term readings are safe from any thread)
+    const ForensEQ::StreamingLoudnessMeter& getLiveLoudnessMeter() const { return liveLoudness; }
+
+    // Get the live true-peak detector (getTruePeak() is safe from any thread)
+    const ForensEQ::TruePeakDetector& getLiveTruePeakDetector() const { return liveTruePeak; }
+
 private:
-    // Audio analysis data
-    juce::AudioBuffer<float> analysisBuffer;
+    // AnalysisTap::Listener methods (analysis thread)
+    void analysisStreamStarted(double sampleRate) override;
+    void analysisBlockReady(const juce::AudioBuffer<float>& block, double sampleRate) override;
+
+    // Analysis engines fed by the tap; declared first so they outlive the tap's thread
+    ForensEQ::LiveSpectrumAnalyzer liveSpectrum;
+    ForensEQ::StreamingLoudnessMeter liveLoudness;
+    ForensEQ::TruePeakDetector liveTruePeak;
+    double currentAnalysisSampleRate = 0.0; // only touched on the analysis thread
+    
+    // Lock-free tap from the audio thread to the background analysis thread
+    AnalysisTap analysisTap;
     
     // Parameters
     juce::AudioProcessorValueTreeState parameters;